@@ -0,0 +1,314 @@
+#include "corpus.h"
+#include "kikcode_render.h"
+#include "kikcodes.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
+using namespace std;
+using namespace cv;
+
+static const char *bucket_names[CORPUS_BUCKET_COUNT] = {
+    "clean",
+    "perspective",
+    "motion_blur",
+    "defocus_blur",
+    "noise",
+    "jpeg",
+    "glare",
+    "inverted",
+    "occlusion",
+    "padded_stride"
+};
+
+/**
+ * splitmix64, whose sequence is the same everywhere, unlike the distributions of <random>
+ */
+typedef struct {
+    uint64_t state;
+} CorpusRandom;
+
+static uint64_t nextRandom(CorpusRandom &random)
+{
+    uint64_t z = (random.state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+
+    return z ^ (z >> 31);
+}
+
+/**
+ * @returns A value in [low, high)
+ */
+static double uniform(CorpusRandom &random, double low, double high)
+{
+    return low + (high - low) * ((nextRandom(random) >> 11) * (1.0 / 9007199254740992.0));
+}
+
+/**
+ * @returns An integer in [low, high]
+ */
+static int uniformInt(CorpusRandom &random, int low, int high)
+{
+    return low + (int)(nextRandom(random) % (uint64_t)(high - low + 1));
+}
+
+/**
+ * @returns A standard normal value, by Box-Muller
+ */
+static double gaussian(CorpusRandom &random)
+{
+    double u = uniform(random, 1e-12, 1);
+    double v = uniform(random, 0, 1);
+
+    return sqrt(-2 * log(u)) * cos(2 * M_PI * v);
+}
+
+const char *corpusBucketName(int bucket)
+{
+    return bucket >= 0 && bucket < CORPUS_BUCKET_COUNT ? bucket_names[bucket] : "unknown";
+}
+
+int corpusBucket(const char *name)
+{
+    for (int bucket = 0; bucket < CORPUS_BUCKET_COUNT; ++bucket) {
+        if (strcmp(bucket_names[bucket], name) == 0) {
+            return bucket;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * Moves each corner of the frame by up to a sixth of its shorter edge, as a code held at an angle
+ * to the camera would be.
+ */
+static void tilt(CorpusRandom &random, Mat &frame, uint8_t background)
+{
+    double reach = MIN(frame.cols, frame.rows) / 6.0;
+
+    Point2f corners[4] = {
+        Point2f(0, 0),
+        Point2f((float)frame.cols, 0),
+        Point2f((float)frame.cols, (float)frame.rows),
+        Point2f(0, (float)frame.rows)
+    };
+    Point2f moved[4];
+
+    for (int i = 0; i < 4; ++i) {
+        moved[i] = corners[i] + Point2f((float)uniform(random, -reach, reach), (float)uniform(random, -reach, reach));
+    }
+
+    Mat tilted;
+    warpPerspective(frame, tilted, getPerspectiveTransform(corners, moved), frame.size(), INTER_LINEAR, BORDER_CONSTANT, Scalar(background));
+    tilted.copyTo(frame);
+}
+
+/**
+ * Smears the frame along a line of 5 to 11 pixels at a random angle.
+ */
+static void motionBlur(CorpusRandom &random, Mat &frame)
+{
+    int length = 2 * uniformInt(random, 2, 5) + 1;
+    double angle = uniform(random, 0, M_PI);
+    double half = (length - 1) / 2.0;
+
+    Mat kernel = Mat::zeros(length, length, CV_32F);
+    Point2d direction(cos(angle) * half, sin(angle) * half);
+    Point2d middle(half, half);
+
+    line(kernel, middle - direction, middle + direction, Scalar(1), 1, LINE_AA);
+    kernel /= sum(kernel)[0];
+
+    filter2D(frame, frame, -1, kernel, Point(-1, -1), 0, BORDER_REPLICATE);
+}
+
+/**
+ * Averages the frame over a disc of radius 1.5 to 3.5 pixels, as an out of focus lens would.
+ */
+static void defocusBlur(CorpusRandom &random, Mat &frame)
+{
+    double radius = uniform(random, 1.5, 3.5);
+    int half = (int)ceil(radius);
+
+    Mat kernel = Mat::zeros(2 * half + 1, 2 * half + 1, CV_32F);
+
+    for (int y = -half; y <= half; ++y) {
+        for (int x = -half; x <= half; ++x) {
+            // the area of the pixel within the disc, roughly
+            kernel.at<float>(y + half, x + half) = (float)MAX(0.0, MIN(1.0, radius - sqrt((double)(x * x + y * y)) + 0.5));
+        }
+    }
+
+    kernel /= sum(kernel)[0];
+
+    filter2D(frame, frame, -1, kernel, Point(-1, -1), 0, BORDER_REPLICATE);
+}
+
+static void addNoise(CorpusRandom &random, Mat &frame, double sigma)
+{
+    for (int y = 0; y < frame.rows; ++y) {
+        uint8_t *row = frame.ptr<uint8_t>(y);
+
+        for (int x = 0; x < frame.cols; ++x) {
+            row[x] = saturate_cast<uint8_t>(row[x] + sigma * gaussian(random));
+        }
+    }
+}
+
+static void compressJpeg(CorpusRandom &random, Mat &frame)
+{
+    vector<uint8_t> encoded;
+    vector<int> parameters = {IMWRITE_JPEG_QUALITY, uniformInt(random, 10, 40)};
+
+    imencode(".jpg", frame, encoded, parameters);
+    imdecode(encoded, IMREAD_GRAYSCALE).copyTo(frame);
+}
+
+/**
+ * Brightens a soft spot over part of the code, as a reflection off a screen or glossy print would.
+ */
+static void addGlare(CorpusRandom &random, Mat &frame, Point2d center, double size)
+{
+    double angle = uniform(random, 0, 2 * M_PI);
+    double distance = uniform(random, 0, 0.4) * size;
+    Point2d spot = center + Point2d(cos(angle) * distance, sin(angle) * distance);
+
+    double sigma = uniform(random, 0.15, 0.35) * size;
+    double amplitude = uniform(random, 90, 200);
+
+    for (int y = 0; y < frame.rows; ++y) {
+        uint8_t *row = frame.ptr<uint8_t>(y);
+        double dy = y + 0.5 - spot.y;
+
+        for (int x = 0; x < frame.cols; ++x) {
+            double dx = x + 0.5 - spot.x;
+            row[x] = saturate_cast<uint8_t>(row[x] + amplitude * exp(-(dx * dx + dy * dy) / (2 * sigma * sigma)));
+        }
+    }
+}
+
+/**
+ * Covers part of the data rings with a flat patch, clear of the centre circle.
+ */
+static void occlude(CorpusRandom &random, Mat &frame, Point2d center, double size)
+{
+    double width = uniform(random, 0.15, 0.3) * size;
+    double height = uniform(random, 0.15, 0.3) * size;
+    double angle = uniform(random, 0, 2 * M_PI);
+    double distance = uniform(random, 0.33, 0.45) * size;
+
+    Point2d patch = center + Point2d(cos(angle) * distance, sin(angle) * distance);
+    Rect area((int)(patch.x - width / 2), (int)(patch.y - height / 2), (int)width, (int)height);
+
+    frame(area & Rect(0, 0, frame.cols, frame.rows)).setTo(Scalar(uniformInt(random, 0, 255)));
+}
+
+void generateCorpusFrame(uint64_t seed, int bucket, uint32_t index, CorpusFrame *out_frame)
+{
+    // every frame has a sequence of its own, so that one bucket or frame can be regenerated alone
+    CorpusRandom random = { seed };
+    random.state = nextRandom(random) ^ ((uint64_t)bucket << 32 | index);
+    nextRandom(random);
+
+    for (int i = 0; i < CORPUS_KEY_BYTE_COUNT; ++i) {
+        out_frame->key[i] = (unsigned char)nextRandom(random);
+    }
+
+    unsigned char data[KIK_CODE_TOTAL_BYTE_COUNT];
+    kikCodeEncodeRemote(data, out_frame->key, 0);
+
+    const int width = CORPUS_FRAME_WIDTH;
+    const int height = CORPUS_FRAME_HEIGHT;
+
+    // codes are light on dark, as the app draws them, unless inverted
+    uint8_t foreground = (uint8_t)uniformInt(random, 200, 255);
+    uint8_t background = (uint8_t)uniformInt(random, 0, 48);
+
+    // every other inverted code is dim and soft, on a background around the fixed threshold, where
+    // which modules count as dark depends most on the blackish threshold reading the unsharpened
+    // frame
+    bool dim = bucket == CORPUS_BUCKET_INVERTED && index % 2 == 1;
+
+    if (dim) {
+        foreground = (uint8_t)uniformInt(random, 30, 70);
+        background = (uint8_t)uniformInt(random, 150, 190);
+    }
+    else if (bucket == CORPUS_BUCKET_INVERTED) {
+        foreground = (uint8_t)uniformInt(random, 10, 60);
+        background = (uint8_t)uniformInt(random, 180, 240);
+    }
+
+    double size = MIN(width, height) * uniform(random, 0.45, 0.8);
+    Point2d center(uniform(random, size / 2, width - size / 2), uniform(random, size / 2, height - size / 2));
+    double rotation = uniform(random, 0, 2 * M_PI);
+
+    Mat frame(height, width, CV_8UC1);
+    kikCodeRender(data, frame.data, width, height, (unsigned int)frame.step, center.x, center.y, size, rotation, foreground, background);
+
+    switch (bucket) {
+        case CORPUS_BUCKET_PERSPECTIVE:
+            tilt(random, frame, background);
+            break;
+
+        case CORPUS_BUCKET_MOTION_BLUR:
+            motionBlur(random, frame);
+            break;
+
+        case CORPUS_BUCKET_DEFOCUS_BLUR:
+            defocusBlur(random, frame);
+            break;
+
+        case CORPUS_BUCKET_NOISE:
+            addNoise(random, frame, uniform(random, 6, 20));
+            break;
+
+        case CORPUS_BUCKET_JPEG:
+            compressJpeg(random, frame);
+            break;
+
+        case CORPUS_BUCKET_GLARE:
+            addGlare(random, frame, center, size);
+            break;
+
+        case CORPUS_BUCKET_INVERTED:
+            if (dim) {
+                defocusBlur(random, frame);
+            }
+            break;
+
+        case CORPUS_BUCKET_OCCLUSION:
+            occlude(random, frame, center, size);
+            break;
+
+        default:
+            break;
+    }
+
+    // padded planes are aligned to 64 bytes and then some, with junk in the padding that a scan
+    // which ignores the stride would read
+    unsigned int row_stride = width;
+
+    if (bucket == CORPUS_BUCKET_PADDED_STRIDE) {
+        row_stride = (width + 63) / 64 * 64 + 64 * uniformInt(random, 1, 3);
+    }
+
+    out_frame->row_stride = row_stride;
+    out_frame->pixels.resize((size_t)row_stride * height);
+
+    for (int y = 0; y < height; ++y) {
+        uint8_t *row = &out_frame->pixels[(size_t)y * row_stride];
+
+        memcpy(row, frame.ptr<uint8_t>(y), width);
+
+        for (unsigned int x = width; x < row_stride; ++x) {
+            row[x] = (uint8_t)nextRandom(random);
+        }
+    }
+
+    out_frame->frame = Mat(height, width, CV_8UC1, out_frame->pixels.data(), row_stride);
+}
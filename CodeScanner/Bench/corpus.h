@@ -0,0 +1,54 @@
+#ifndef __CORPUS_H__
+#define __CORPUS_H__
+
+#include <stdint.h>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+// kinds of damage a corpus frame is given, one per frame
+#define CORPUS_BUCKET_CLEAN         0
+#define CORPUS_BUCKET_PERSPECTIVE   1
+#define CORPUS_BUCKET_MOTION_BLUR   2
+#define CORPUS_BUCKET_DEFOCUS_BLUR  3
+#define CORPUS_BUCKET_NOISE         4
+#define CORPUS_BUCKET_JPEG          5
+#define CORPUS_BUCKET_GLARE         6
+#define CORPUS_BUCKET_INVERTED      7
+#define CORPUS_BUCKET_OCCLUSION     8
+#define CORPUS_BUCKET_PADDED_STRIDE 9
+#define CORPUS_BUCKET_COUNT         10
+
+#define CORPUS_FRAME_WIDTH  480
+#define CORPUS_FRAME_HEIGHT 360
+
+// the payload of the remote code in each frame
+#define CORPUS_KEY_BYTE_COUNT 20
+
+typedef struct {
+    // the frame's rows are row_stride bytes apart in pixels, frame is a view onto them
+    std::vector<uint8_t> pixels;
+    cv::Mat frame;
+    unsigned int row_stride;
+
+    unsigned char key[CORPUS_KEY_BYTE_COUNT];
+} CorpusFrame;
+
+/**
+ * @returns The name bucket is reported and stored under
+ */
+const char *corpusBucketName(int bucket);
+
+/**
+ * @returns The bucket called name, -1 if there is none
+ */
+int corpusBucket(const char *name);
+
+/**
+ * Generates frame index of a bucket: a remote code with a random payload, drawn at a random size,
+ * position and rotation, then damaged the way the bucket calls for. The same seed, bucket and
+ * index always give the same frame on the same OpenCV, independently of any other frame.
+ */
+void generateCorpusFrame(uint64_t seed, int bucket, uint32_t index, CorpusFrame *out_frame);
+
+#endif // __CORPUS_H__
@@ -0,0 +1,222 @@
+/**
+ * Scans a set of greyscale frames at each device quality and reports how long each stage of the
+ * scan took and how many frames decoded, as JSON on stdout.
+ *
+ * usage: kikscan_bench [--repeat n] [--warmup n] [--quality q]... frame...
+ *
+ * Frames are read with OpenCV, so PGM, PNG and JPEG all work, and are converted to greyscale.
+ * Every frame is scanned repeat times at each quality, after warmup untimed passes over all of
+ * them. Qualities default to LOW, MEDIUM, HIGH and BEST.
+ */
+
+#include "kikcode_scan.h"
+#include "kikcodes.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+
+using namespace std;
+using namespace cv;
+
+#define BENCH_STAGE_COUNT 7
+
+static const char *stage_names[BENCH_STAGE_COUNT] = {
+    "quality_gate",
+    "sharpen",
+    "threshold",
+    "blobs",
+    "ellipses",
+    "candidates",
+    "total"
+};
+
+typedef struct {
+    unsigned int device_quality;
+    unsigned int scans;
+    unsigned int decoded;
+    vector<double> stages[BENCH_STAGE_COUNT];
+} QualityRun;
+
+static void usage()
+{
+    fprintf(stderr, "usage: kikscan_bench [--repeat n] [--warmup n] [--quality q]... frame...\n");
+}
+
+/**
+ * @returns The pth percentile of sorted by nearest rank
+ */
+static double percentile(const vector<double> &sorted, double p)
+{
+    if (sorted.empty()) {
+        return 0;
+    }
+
+    size_t rank = (size_t)ceil(p / 100.0 * sorted.size());
+
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+/**
+ * Scans frame once, adding how long each stage took to run unless run is null.
+ */
+static void scanFrame(const Mat &frame, unsigned int device_quality, QualityRun *run)
+{
+    unsigned char data[KIK_CODE_TOTAL_BYTE_COUNT];
+
+    // the stages of this scan alone, whether or not tracing is enabled
+    TraceTotals stages;
+
+    uint64_t started = kikCodeTraceNow();
+    int status = kikCodeScan(frame.data, frame.cols, frame.rows, device_quality, data, nullptr, nullptr, nullptr, nullptr);
+    uint64_t finished = kikCodeTraceNow();
+
+    if (!run) {
+        return;
+    }
+
+    ++run->scans;
+
+    if (status == KIK_CODE_SCAN_RESULT_SUCCESS) {
+        unsigned int type;
+        unsigned int colour_code;
+        KikCodePayload payload;
+
+        if (kikCodeDecode(data, &type, &payload, &colour_code) == KIK_CODE_RESULT_SUCCESS) {
+            ++run->decoded;
+        }
+    }
+
+    KikCodeScanTiming timing;
+    stages.fillTiming(&timing);
+
+    run->stages[0].push_back(timing.quality_gate);
+    run->stages[1].push_back(timing.sharpen);
+    run->stages[2].push_back(timing.threshold);
+    run->stages[3].push_back(timing.blobs);
+    run->stages[4].push_back(timing.ellipses);
+    run->stages[5].push_back(timing.candidates);
+    run->stages[6].push_back((finished - started) / 1e6);
+}
+
+static void printRun(QualityRun &run, bool last)
+{
+    printf("    {\n");
+    printf("      \"device_quality\": %u,\n", run.device_quality);
+    printf("      \"scans\": %u,\n", run.scans);
+    printf("      \"decoded\": %u,\n", run.decoded);
+    printf("      \"decode_rate\": %.4f,\n", run.scans > 0 ? (double)run.decoded / run.scans : 0.0);
+    printf("      \"stages_ms\": {\n");
+
+    for (int i = 0; i < BENCH_STAGE_COUNT; ++i) {
+        vector<double> &durations = run.stages[i];
+        sort(durations.begin(), durations.end());
+
+        printf("        \"%s\": {\"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f}%s\n",
+               stage_names[i],
+               percentile(durations, 50),
+               percentile(durations, 95),
+               percentile(durations, 99),
+               i + 1 < BENCH_STAGE_COUNT ? "," : "");
+    }
+
+    printf("      }\n");
+    printf("    }%s\n", last ? "" : ",");
+}
+
+int main(int argc, char **argv)
+{
+    unsigned int repeat = 5;
+    unsigned int warmup = 1;
+    vector<unsigned int> qualities;
+    vector<const char *> paths;
+
+    for (int i = 1; i < argc; ++i) {
+        if ((strcmp(argv[i], "--repeat") == 0 || strcmp(argv[i], "--warmup") == 0 || strcmp(argv[i], "--quality") == 0) && i + 1 < argc) {
+            unsigned int value = (unsigned int)strtoul(argv[i + 1], nullptr, 10);
+
+            if (argv[i][2] == 'r') {
+                repeat = max(value, 1u);
+            }
+            else if (argv[i][2] == 'w') {
+                warmup = value;
+            }
+            else {
+                qualities.push_back(value);
+            }
+
+            ++i;
+        }
+        else if (argv[i][0] == '-') {
+            usage();
+            return 1;
+        }
+        else {
+            paths.push_back(argv[i]);
+        }
+    }
+
+    if (paths.empty()) {
+        usage();
+        return 1;
+    }
+
+    if (qualities.empty()) {
+        qualities.push_back(KIK_CODE_SCAN_DEVICE_QUALITY_LOW);
+        qualities.push_back(KIK_CODE_SCAN_DEVICE_QUALITY_MEDIUM);
+        qualities.push_back(KIK_CODE_SCAN_DEVICE_QUALITY_HIGH);
+        qualities.push_back(KIK_CODE_SCAN_DEVICE_QUALITY_BEST);
+    }
+
+    vector<Mat> frames;
+
+    for (size_t i = 0; i < paths.size(); ++i) {
+        Mat frame = imread(paths[i], IMREAD_GRAYSCALE);
+
+        if (frame.empty()) {
+            fprintf(stderr, "kikscan_bench: can't read %s\n", paths[i]);
+            return 1;
+        }
+
+        // kikCodeScan takes tightly packed rows
+        frames.push_back(frame.isContinuous() ? frame : frame.clone());
+    }
+
+    printf("{\n");
+    printf("  \"frames\": %zu,\n", frames.size());
+    printf("  \"repeat\": %u,\n", repeat);
+    printf("  \"runs\": [\n");
+
+    for (size_t q = 0; q < qualities.size(); ++q) {
+        QualityRun run;
+        run.device_quality = qualities[q];
+        run.scans = 0;
+        run.decoded = 0;
+
+        for (unsigned int pass = 0; pass < warmup; ++pass) {
+            for (size_t i = 0; i < frames.size(); ++i) {
+                scanFrame(frames[i], run.device_quality, nullptr);
+            }
+        }
+
+        for (unsigned int pass = 0; pass < repeat; ++pass) {
+            for (size_t i = 0; i < frames.size(); ++i) {
+                scanFrame(frames[i], run.device_quality, &run);
+            }
+        }
+
+        printRun(run, q + 1 == qualities.size());
+    }
+
+    printf("  ]\n");
+    printf("}\n");
+
+    return 0;
+}
@@ -0,0 +1,344 @@
+/**
+ * Runs detectKikCode and KikCode::parse over a seeded corpus of damaged frames (see corpus.h) and
+ * reports, for each kind of damage, how many of its codes decoded to the right payload and how
+ * long detection took, as JSON on stdout.
+ *
+ * usage: kikscan_regress [--seed n] [--frames n] [--quality q] [--baseline path]
+ *                        [--latency-baseline path] [--update-baseline] [--rate-tolerance r]
+ *                        [--latency-tolerance l] [--dump directory]
+ *
+ * With --baseline the decode rates and misread counts are checked against the ones stored there,
+ * and the run fails if any bucket's decode rate dropped by more than rate-tolerance (0.02 by
+ * default) or it misread more codes. It also fails, before running anything, if there's no baseline
+ * there. The corpus is seeded, so these are the same on every machine.
+ *
+ * Latencies are only comparable on the machine they were stored on, so they're kept apart, at
+ * --latency-baseline. If one is there the run also fails if any bucket's median latency grew by
+ * more than latency-tolerance of itself (0.25 by default), and if there's none they aren't checked.
+ *
+ * --update-baseline stores the results at both paths instead.
+ *
+ * --dump writes every frame to the directory as a PGM, named after its bucket and index.
+ */
+
+#include "corpus.h"
+#include "kikcode_encoding.h"
+#include "scanner.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+
+using namespace std;
+using namespace cv;
+
+typedef struct {
+    unsigned int frames;
+    unsigned int decoded;
+
+    // found and parsed, but not to the payload that was drawn
+    unsigned int misread;
+
+    double decode_rate;
+    double p50;
+    double p95;
+} BucketResult;
+
+static void usage()
+{
+    fprintf(stderr, "usage: kikscan_regress [--seed n] [--frames n] [--quality q] [--baseline path] [--latency-baseline path]\n"
+                    "                       [--update-baseline] [--rate-tolerance r] [--latency-tolerance l] [--dump directory]\n");
+}
+
+/**
+ * @returns The pth percentile of sorted by nearest rank
+ */
+static double percentile(const vector<double> &sorted, double p)
+{
+    if (sorted.empty()) {
+        return 0;
+    }
+
+    size_t rank = (size_t)ceil(p / 100.0 * sorted.size());
+
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+/**
+ * @returns True iff code is the remote code with payload key
+ */
+static bool matchesKey(KikCode *code, const unsigned char *key)
+{
+    RemoteKikCode *remote = dynamic_cast<RemoteKikCode *>(code);
+
+    return remote && remote->payload() == string((const char *)key, CORPUS_KEY_BYTE_COUNT);
+}
+
+static void runBucket(uint64_t seed, int bucket, unsigned int frame_count, uint32_t device_quality, const char *dump_directory, BucketResult *out_result)
+{
+    vector<double> latencies;
+    CorpusFrame corpus_frame;
+
+    out_result->frames = frame_count;
+    out_result->decoded = 0;
+    out_result->misread = 0;
+
+    for (unsigned int i = 0; i < frame_count; ++i) {
+        generateCorpusFrame(seed, bucket, i, &corpus_frame);
+
+        if (dump_directory) {
+            char path[1024];
+            snprintf(path, sizeof(path), "%s/%s_%04u.pgm", dump_directory, corpusBucketName(bucket), i);
+            imwrite(path, corpus_frame.frame);
+        }
+
+        uint8_t data[KIK_CODE_TOTAL_BYTE_COUNT];
+        uint32_t x;
+        uint32_t y;
+        uint32_t scale;
+        Mat transform;
+
+        uint64_t started = kikCodeTraceNow();
+        bool found = detectKikCode(corpus_frame.frame, nullptr, device_quality, data, &x, &y, &scale, &transform);
+        KikCode *code = found ? KikCode::parse(data) : nullptr;
+        uint64_t finished = kikCodeTraceNow();
+
+        latencies.push_back((finished - started) / 1e6);
+
+        if (code) {
+            if (matchesKey(code, corpus_frame.key)) {
+                ++out_result->decoded;
+            }
+            else {
+                ++out_result->misread;
+            }
+
+            delete code;
+        }
+    }
+
+    sort(latencies.begin(), latencies.end());
+
+    out_result->decode_rate = frame_count > 0 ? (double)out_result->decoded / frame_count : 0;
+    out_result->p50 = percentile(latencies, 50);
+    out_result->p95 = percentile(latencies, 95);
+}
+
+/**
+ * Reads a baseline stored by writeBaseline, one bucket per line: its name and either its decode
+ * rate and misread count or, for latencies, its median and 95th percentile latency in
+ * milliseconds.
+ *
+ * @returns False if the file can't be read
+ */
+static bool readBaseline(const char *path, bool latencies, BucketResult *out_results, bool *out_present)
+{
+    FILE *file = fopen(path, "r");
+
+    if (!file) {
+        return false;
+    }
+
+    char line[256];
+
+    while (fgets(line, sizeof(line), file)) {
+        char name[64];
+        int bucket;
+
+        if (line[0] == '#' || sscanf(line, "%63s", name) != 1 || (bucket = corpusBucket(name)) < 0) {
+            continue;
+        }
+
+        BucketResult &result = out_results[bucket];
+        const char *values = line + strlen(name);
+
+        if (latencies ? sscanf(values, "%lf %lf", &result.p50, &result.p95) == 2
+                      : sscanf(values, "%lf %u", &result.decode_rate, &result.misread) == 2) {
+            out_present[bucket] = true;
+        }
+    }
+
+    fclose(file);
+
+    return true;
+}
+
+static bool writeBaseline(const char *path, bool latencies, const BucketResult *results, uint64_t seed, unsigned int frame_count, uint32_t device_quality)
+{
+    FILE *file = fopen(path, "w");
+
+    if (!file) {
+        return false;
+    }
+
+    fprintf(file, "# kikscan_regress --seed %llu --frames %u --quality %u\n", (unsigned long long)seed, frame_count, device_quality);
+    fprintf(file, latencies ? "# bucket p50_ms p95_ms\n" : "# bucket decode_rate misread\n");
+
+    for (int bucket = 0; bucket < CORPUS_BUCKET_COUNT; ++bucket) {
+        const BucketResult &result = results[bucket];
+
+        if (latencies) {
+            fprintf(file, "%s %.3f %.3f\n", corpusBucketName(bucket), result.p50, result.p95);
+        }
+        else {
+            fprintf(file, "%s %.4f %u\n", corpusBucketName(bucket), result.decode_rate, result.misread);
+        }
+    }
+
+    fclose(file);
+
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    uint64_t seed = 1;
+    unsigned int frame_count = 50;
+    uint32_t device_quality = SCAN_DEVICE_QUALITY_HIGH;
+    const char *baseline_path = nullptr;
+    const char *latency_baseline_path = nullptr;
+    const char *dump_directory = nullptr;
+    bool update_baseline = false;
+    double rate_tolerance = 0.02;
+    double latency_tolerance = 0.25;
+
+    for (int i = 1; i < argc; ++i) {
+        bool has_value = i + 1 < argc;
+
+        if (strcmp(argv[i], "--seed") == 0 && has_value) {
+            seed = strtoull(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--frames") == 0 && has_value) {
+            frame_count = (unsigned int)strtoul(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--quality") == 0 && has_value) {
+            device_quality = (uint32_t)strtoul(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--baseline") == 0 && has_value) {
+            baseline_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--latency-baseline") == 0 && has_value) {
+            latency_baseline_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--rate-tolerance") == 0 && has_value) {
+            rate_tolerance = strtod(argv[++i], nullptr);
+        }
+        else if (strcmp(argv[i], "--latency-tolerance") == 0 && has_value) {
+            latency_tolerance = strtod(argv[++i], nullptr);
+        }
+        else if (strcmp(argv[i], "--dump") == 0 && has_value) {
+            dump_directory = argv[++i];
+        }
+        else if (strcmp(argv[i], "--update-baseline") == 0) {
+            update_baseline = true;
+        }
+        else {
+            usage();
+            return 1;
+        }
+    }
+
+    if (update_baseline && !baseline_path && !latency_baseline_path) {
+        usage();
+        return 1;
+    }
+
+    BucketResult baseline[CORPUS_BUCKET_COUNT];
+    bool present[CORPUS_BUCKET_COUNT] = {};
+    bool latency_present[CORPUS_BUCKET_COUNT] = {};
+
+    // read before the corpus is run, so that a check with nothing to check against fails at once
+    if (baseline_path && !update_baseline && !readBaseline(baseline_path, false, baseline, present)) {
+        fprintf(stderr, "kikscan_regress: no baseline at %s, store one with\n"
+                        "    kikscan_regress --baseline %s --update-baseline\n", baseline_path, baseline_path);
+        return 1;
+    }
+
+    if (latency_baseline_path && !update_baseline && !readBaseline(latency_baseline_path, true, baseline, latency_present)) {
+        fprintf(stderr, "kikscan_regress: no latency baseline at %s, latencies aren't checked. Store one on this machine with\n"
+                        "    kikscan_regress --latency-baseline %s --update-baseline\n", latency_baseline_path, latency_baseline_path);
+    }
+
+    BucketResult results[CORPUS_BUCKET_COUNT];
+
+    // the first detection pays for setting up OpenCV, which no bucket should be charged for
+    CorpusFrame warmup;
+    generateCorpusFrame(seed, CORPUS_BUCKET_CLEAN, 0, &warmup);
+
+    uint8_t data[KIK_CODE_TOTAL_BYTE_COUNT];
+    uint32_t x;
+    uint32_t y;
+    uint32_t scale;
+    Mat transform;
+    detectKikCode(warmup.frame, nullptr, device_quality, data, &x, &y, &scale, &transform);
+
+    printf("{\n");
+    printf("  \"seed\": %llu,\n", (unsigned long long)seed);
+    printf("  \"frames_per_bucket\": %u,\n", frame_count);
+    printf("  \"device_quality\": %u,\n", device_quality);
+    printf("  \"buckets\": {\n");
+
+    for (int bucket = 0; bucket < CORPUS_BUCKET_COUNT; ++bucket) {
+        BucketResult &result = results[bucket];
+        runBucket(seed, bucket, frame_count, device_quality, dump_directory, &result);
+
+        printf("    \"%s\": {\"frames\": %u, \"decoded\": %u, \"misread\": %u, \"decode_rate\": %.4f, \"p50_ms\": %.3f, \"p95_ms\": %.3f}%s\n",
+               corpusBucketName(bucket), result.frames, result.decoded, result.misread, result.decode_rate, result.p50, result.p95,
+               bucket + 1 < CORPUS_BUCKET_COUNT ? "," : "");
+        fflush(stdout);
+    }
+
+    printf("  }\n");
+    printf("}\n");
+
+    if (update_baseline) {
+        if (baseline_path && !writeBaseline(baseline_path, false, results, seed, frame_count, device_quality)) {
+            fprintf(stderr, "kikscan_regress: can't write %s\n", baseline_path);
+            return 1;
+        }
+
+        if (latency_baseline_path && !writeBaseline(latency_baseline_path, true, results, seed, frame_count, device_quality)) {
+            fprintf(stderr, "kikscan_regress: can't write %s\n", latency_baseline_path);
+            return 1;
+        }
+
+        return 0;
+    }
+
+    int regressions = 0;
+
+    for (int bucket = 0; bucket < CORPUS_BUCKET_COUNT; ++bucket) {
+        const BucketResult &result = results[bucket];
+        const BucketResult &expected = baseline[bucket];
+        const char *name = corpusBucketName(bucket);
+
+        if (baseline_path && !present[bucket]) {
+            fprintf(stderr, "kikscan_regress: %s isn't in the baseline\n", name);
+        }
+
+        if (present[bucket] && result.decode_rate < expected.decode_rate - rate_tolerance) {
+            fprintf(stderr, "kikscan_regress: %s decode rate fell from %.4f to %.4f\n", name, expected.decode_rate, result.decode_rate);
+            ++regressions;
+        }
+
+        if (present[bucket] && result.misread > expected.misread) {
+            fprintf(stderr, "kikscan_regress: %s misread %u codes, up from %u\n", name, result.misread, expected.misread);
+            ++regressions;
+        }
+
+        if (latency_present[bucket] && result.p50 > expected.p50 * (1 + latency_tolerance)) {
+            fprintf(stderr, "kikscan_regress: %s median latency rose from %.3f ms to %.3f ms\n", name, expected.p50, result.p50);
+            ++regressions;
+        }
+    }
+
+    return regressions > 0 ? 1 : 0;
+}
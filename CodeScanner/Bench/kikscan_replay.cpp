@@ -0,0 +1,208 @@
+/**
+ * Replays a frame archive recorded with kikCodeRecordStart through the scanner and reports how
+ * many frames still decode to the code recorded with them and how long their scans took, as JSON
+ * on stdout. Each frame that doesn't is named on stderr by its index, so it can be looked at alone.
+ *
+ * usage: kikscan_replay [--pace] [--repeat n] [--quality q] archive
+ *
+ * The archive is mapped and every plane is scanned in place with kikCodeScanStrided, nothing is
+ * copied. Frames are scanned back to back unless --pace is given, in which case each one is held
+ * until as long after the first as it was when it was recorded, and how late the scans fell behind
+ * that is reported. --quality overrides the device quality each frame was recorded with.
+ */
+
+#include "frame_archive.h"
+#include "kikcode_scan.h"
+#include "kikcodes.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+static void usage()
+{
+    fprintf(stderr, "usage: kikscan_replay [--pace] [--repeat n] [--quality q] archive\n");
+}
+
+/**
+ * @returns The pth percentile of sorted by nearest rank
+ */
+static double percentile(const vector<double> &sorted, double p)
+{
+    if (sorted.empty()) {
+        return 0;
+    }
+
+    size_t rank = (size_t)ceil(p / 100.0 * sorted.size());
+
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+/**
+ * @returns True iff both data decode, to codes of the same type and payload
+ */
+static bool sameCode(const unsigned char *data, const unsigned char *expected)
+{
+    unsigned int type;
+    unsigned int expected_type;
+    unsigned int colour_code;
+    KikCodePayload payload;
+    KikCodePayload expected_payload;
+
+    // only the member of the union for the type is written, the rest has to compare equal
+    memset(&payload, 0, sizeof(payload));
+    memset(&expected_payload, 0, sizeof(expected_payload));
+
+    return kikCodeDecode(data, &type, &payload, &colour_code) == KIK_CODE_RESULT_SUCCESS &&
+           kikCodeDecode(expected, &expected_type, &expected_payload, &colour_code) == KIK_CODE_RESULT_SUCCESS &&
+           type == expected_type &&
+           memcmp(&payload, &expected_payload, sizeof(payload)) == 0;
+}
+
+/**
+ * Sleeps until timestamp nanoseconds on the tracing clock, the steady clock.
+ */
+static void sleepUntil(uint64_t timestamp)
+{
+    this_thread::sleep_until(chrono::steady_clock::time_point(chrono::nanoseconds(timestamp)));
+}
+
+int main(int argc, char **argv)
+{
+    bool pace = false;
+    unsigned int repeat = 1;
+    int quality = -1;
+    const char *path = nullptr;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--pace") == 0) {
+            pace = true;
+        }
+        else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            repeat = max((unsigned int)strtoul(argv[++i], nullptr, 10), 1u);
+        }
+        else if (strcmp(argv[i], "--quality") == 0 && i + 1 < argc) {
+            quality = (int)strtoul(argv[++i], nullptr, 10);
+        }
+        else if (argv[i][0] == '-' || path) {
+            usage();
+            return 1;
+        }
+        else {
+            path = argv[i];
+        }
+    }
+
+    if (!path) {
+        usage();
+        return 1;
+    }
+
+    FrameArchive *archive = frameArchiveMap(path);
+
+    if (!archive) {
+        fprintf(stderr, "kikscan_replay: %s isn't a frame archive\n", path);
+        return 1;
+    }
+
+    size_t frame_count = frameArchiveFrameCount(archive);
+
+    unsigned int scans = 0;
+    unsigned int found = 0;
+    unsigned int labelled = 0;
+    unsigned int matched = 0;
+    vector<double> latencies;
+    vector<double> lateness;
+
+    uint64_t replay_started = kikCodeTraceNow();
+
+    for (unsigned int pass = 0; pass < repeat; ++pass) {
+        uint64_t pass_started = kikCodeTraceNow();
+        uint64_t first_timestamp = frame_count > 0 ? frameArchiveFrameAt(archive, 0)->timestamp : 0;
+
+        for (size_t i = 0; i < frame_count; ++i) {
+            const FrameArchiveFrame *frame = frameArchiveFrameAt(archive, i);
+            unsigned int device_quality = quality >= 0 ? (unsigned int)quality : frame->device_quality;
+
+            if (pace) {
+                uint64_t due = pass_started + (frame->timestamp - first_timestamp);
+                uint64_t now = kikCodeTraceNow();
+
+                if (now < due) {
+                    sleepUntil(due);
+                }
+
+                lateness.push_back(now > due ? (now - due) / 1e6 : 0);
+            }
+
+            unsigned char data[KIK_CODE_TOTAL_BYTE_COUNT];
+
+            uint64_t started = kikCodeTraceNow();
+            int status = kikCodeScanStrided(frameArchivePlane(frame), frame->width, frame->height, frame->row_stride, device_quality,
+                                            data, nullptr, nullptr, nullptr, nullptr);
+            uint64_t finished = kikCodeTraceNow();
+
+            latencies.push_back((finished - started) / 1e6);
+            ++scans;
+
+            bool scanned = status == KIK_CODE_SCAN_RESULT_SUCCESS;
+
+            if (scanned) {
+                ++found;
+            }
+
+            if (!(frame->flags & FRAME_ARCHIVE_FLAG_PAYLOAD)) {
+                continue;
+            }
+
+            ++labelled;
+
+            if (scanned && sameCode(data, frame->payload)) {
+                ++matched;
+            }
+            else if (pass == 0) {
+                fprintf(stderr, "kikscan_replay: frame %zu %s\n", i, scanned ? "read a different code" : "read nothing");
+            }
+        }
+    }
+
+    double elapsed = (kikCodeTraceNow() - replay_started) / 1e6;
+
+    sort(latencies.begin(), latencies.end());
+    sort(lateness.begin(), lateness.end());
+
+    printf("{\n");
+    printf("  \"frames\": %zu,\n", frame_count);
+    printf("  \"repeat\": %u,\n", repeat);
+    printf("  \"paced\": %s,\n", pace ? "true" : "false");
+    printf("  \"scans\": %u,\n", scans);
+    printf("  \"found\": %u,\n", found);
+    printf("  \"labelled\": %u,\n", labelled);
+    printf("  \"matched\": %u,\n", matched);
+    printf("  \"match_rate\": %.4f,\n", labelled > 0 ? (double)matched / labelled : 0.0);
+    printf("  \"elapsed_ms\": %.3f,\n", elapsed);
+    printf("  \"frames_per_second\": %.2f,\n", elapsed > 0 ? scans / (elapsed / 1000) : 0.0);
+    printf("  \"scan_ms\": {\"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f}", percentile(latencies, 50), percentile(latencies, 95), percentile(latencies, 99));
+
+    if (pace) {
+        printf(",\n  \"late_ms\": {\"p50\": %.4f, \"p95\": %.4f, \"max\": %.4f}\n", percentile(lateness, 50), percentile(lateness, 95),
+               lateness.empty() ? 0.0 : lateness.back());
+    }
+    else {
+        printf("\n");
+    }
+
+    printf("}\n");
+
+    frameArchiveUnmap(archive);
+
+    return 0;
+}
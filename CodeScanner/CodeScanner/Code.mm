@@ -16,43 +16,54 @@
 #define PAYLOAD_BYTE_COUNT  20
 #define ECC_BYTE_COUNT      13
 
+#define MAX_SCAN_RESULTS    8
+
+#define ACCUMULATED_FRAME_COUNT  8
+#define ACCUMULATION_MAX_MISSES  3
+
 #define ZERO_BYTES { 0 }
 
-@implementation KikCodes
+@interface KikCodes ()
+
++ (int)deviceQualityForScanQuality:(KikCodesScanQuality)quality;
 
-// zxing's Reed-Solomon tables and Counted refcounts are not thread-safe; serialize every entry point.
+@end
+
+@implementation KikCodes
 
 + (nonnull NSData *)encode:(nonnull NSData *)data {
-    @synchronized (self) {
-        unsigned char outData[MAIN_BYTE_COUNT] = ZERO_BYTES;
+    unsigned char outData[MAIN_BYTE_COUNT] = ZERO_BYTES;
 
-        uint8_t bytes[PAYLOAD_BYTE_COUNT] = ZERO_BYTES;
-        memcpy(bytes, data.bytes, data.length);
+    uint8_t bytes[PAYLOAD_BYTE_COUNT] = ZERO_BYTES;
+    memcpy(bytes, data.bytes, data.length);
 
-        kikCodeEncodeRemote(outData, (unsigned char *)bytes, 0);
+    kikCodeEncodeRemote(outData, (unsigned char *)bytes, 0);
 //    kikCodeEncodeGroup(outData, (unsigned char *)data.bytes, 0);
 
-        return [[NSData alloc] initWithBytes:outData length:MAIN_BYTE_COUNT];
-    }
+    return [[NSData alloc] initWithBytes:outData length:MAIN_BYTE_COUNT];
 }
 
 + (nonnull NSData *)decode:(nonnull NSData *)data {
-    @synchronized (self) {
-        KikCodePayload payload;
-        unsigned int type;
-        unsigned int color;
-        kikCodeDecode((unsigned char *)data.bytes, &type, &payload, &color);
+    return [self decode:data confidence:nil];
+}
+
++ (nonnull NSData *)decode:(nonnull NSData *)data confidence:(nullable NSData *)confidence {
+    const unsigned char *confidenceBytes = confidence.length >= MAIN_BYTE_COUNT ? (const unsigned char *)confidence.bytes : NULL;
 
-        // Trim any tail zero bytes at the tail
+    KikCodePayload payload;
+    unsigned int type;
+    unsigned int color;
+    kikCodeDecodeWithConfidence((unsigned char *)data.bytes, confidenceBytes, &type, &payload, &color);
 
-        uint8_t *bytes = payload.group.invite_code;
-        int length = sizeof(payload.group.invite_code);
-        while (length > 0 && bytes[length - 1] == 0x0) {
-            length--;
-        }
+    // Trim any tail zero bytes at the tail
 
-        return [[NSData alloc] initWithBytes:bytes length:length];
+    uint8_t *bytes = payload.group.invite_code;
+    int length = sizeof(payload.group.invite_code);
+    while (length > 0 && bytes[length - 1] == 0x0) {
+        length--;
     }
+
+    return [[NSData alloc] initWithBytes:bytes length:length];
 }
 
 + (nullable NSData *)scan:(nonnull NSData *)data width:(NSInteger)width height:(NSInteger)height {
@@ -60,17 +71,94 @@
 }
 
 + (nullable NSData *)scan:(nonnull NSData *)data width:(NSInteger)width height:(NSInteger)height quality:(KikCodesScanQuality)quality {
-    @synchronized (self) {
-        uint8_t outData[MAIN_BYTE_COUNT] = ZERO_BYTES;
+    uint8_t outData[MAIN_BYTE_COUNT] = ZERO_BYTES;
+
+    unsigned int qualityValue = [self deviceQualityForScanQuality:quality];
+
+    int result = kikCodeScan((unsigned char *)data.bytes, (unsigned int)width, (unsigned int)height, qualityValue, outData, nil, nil, nil, nil);
+    if (result == 0) {
+        return [[NSData alloc] initWithBytes:outData length:MAIN_BYTE_COUNT];
+    }
+    return nil;
+}
+
++ (nullable NSData *)scan:(nonnull NSData *)data width:(NSInteger)width height:(NSInteger)height rowStride:(NSInteger)rowStride quality:(KikCodesScanQuality)quality {
+    if (width <= 0 || height <= 0 || rowStride < width || data.length < (NSUInteger)(rowStride * (height - 1) + width)) {
+        return nil;
+    }
+
+    uint8_t outData[MAIN_BYTE_COUNT] = ZERO_BYTES;
+
+    unsigned int qualityValue = [self deviceQualityForScanQuality:quality];
+
+    int result = kikCodeScanStrided((unsigned char *)data.bytes, (unsigned int)width, (unsigned int)height, (unsigned int)rowStride, qualityValue, outData, nil, nil, nil, nil);
+    if (result == 0) {
+        return [[NSData alloc] initWithBytes:outData length:MAIN_BYTE_COUNT];
+    }
+    return nil;
+}
+
++ (nullable NSData *)scan:(nonnull NSData *)data width:(NSInteger)width height:(NSInteger)height rowStride:(NSInteger)rowStride quality:(KikCodesScanQuality)quality confidence:(NSData * _Nullable * _Nullable)confidence {
+    if (width <= 0 || height <= 0 || rowStride < width || data.length < (NSUInteger)(rowStride * (height - 1) + width)) {
+        return nil;
+    }
 
-        unsigned int qualityValue = [self deviceQualityForScanQuality:quality];
+    KikCodeScanResult result;
+    unsigned int count = 0;
 
-        int result = kikCodeScan((unsigned char *)data.bytes, (unsigned int)width, (unsigned int)height, qualityValue, outData, nil, nil, nil, nil);
-        if (result == 0) {
-            return [[NSData alloc] initWithBytes:outData length:MAIN_BYTE_COUNT];
-        }
+    unsigned int qualityValue = [self deviceQualityForScanQuality:quality];
+
+    kikCodeScanAll((unsigned char *)data.bytes, (unsigned int)width, (unsigned int)height, (unsigned int)rowStride, qualityValue, &result, 1, &count);
+    if (count == 0) {
         return nil;
     }
+
+    if (confidence) {
+        *confidence = [[NSData alloc] initWithBytes:result.confidence length:MAIN_BYTE_COUNT];
+    }
+    return [[NSData alloc] initWithBytes:result.data length:MAIN_BYTE_COUNT];
+}
+
++ (nonnull NSArray<NSData *> *)scanAll:(nonnull NSData *)data width:(NSInteger)width height:(NSInteger)height rowStride:(NSInteger)rowStride quality:(KikCodesScanQuality)quality {
+    if (width <= 0 || height <= 0 || rowStride < width || data.length < (NSUInteger)(rowStride * (height - 1) + width)) {
+        return @[];
+    }
+
+    KikCodeScanResult results[MAX_SCAN_RESULTS];
+    unsigned int count = 0;
+
+    unsigned int qualityValue = [self deviceQualityForScanQuality:quality];
+
+    kikCodeScanAll((unsigned char *)data.bytes, (unsigned int)width, (unsigned int)height, (unsigned int)rowStride, qualityValue, results, MAX_SCAN_RESULTS, &count);
+
+    NSMutableArray<NSData *> *scanned = [NSMutableArray arrayWithCapacity:count];
+    for (unsigned int i = 0; i < count; i++) {
+        [scanned addObject:[[NSData alloc] initWithBytes:results[i].data length:MAIN_BYTE_COUNT]];
+    }
+    return scanned;
+}
+
++ (void)setTracingEnabled:(BOOL)enabled {
+    kikCodeTraceSetEnabled(enabled ? 1 : 0);
+}
+
++ (NSData *)takeTrace {
+    char *trace = kikCodeTraceExportChrome();
+    if (trace == NULL) {
+        return [NSData data];
+    }
+
+    NSData *data = [[NSData alloc] initWithBytes:trace length:strlen(trace)];
+    kikCodeTraceFree(trace);
+    return data;
+}
+
++ (BOOL)startRecordingToPath:(NSString *)path {
+    return kikCodeRecordStart(path.fileSystemRepresentation) == KIK_CODE_SCAN_RESULT_SUCCESS;
+}
+
++ (void)stopRecording {
+    kikCodeRecordStop();
 }
 
 + (int)deviceQualityForScanQuality:(KikCodesScanQuality)quality {
@@ -89,3 +177,132 @@
 }
 
 @end
+
+@interface KikCodesFrameScanner () {
+    KikCodeScanContext *_context;
+}
+
+@end
+
+@implementation KikCodesFrameScanner
+
+- (void)dealloc {
+    if (_context != NULL) {
+        kikCodeScannerDestroy(_context);
+    }
+}
+
+- (nullable NSData *)scan:(NSData *)data width:(NSInteger)width height:(NSInteger)height rowStride:(NSInteger)rowStride quality:(KikCodesScanQuality)quality confidence:(NSData * _Nullable * _Nullable)confidence {
+    if (width <= 0 || height <= 0 || rowStride < width || data.length < (NSUInteger)(rowStride * (height - 1) + width)) {
+        return nil;
+    }
+
+    KikCodeScanResult result;
+    unsigned int count = 0;
+
+    unsigned int qualityValue = [KikCodes deviceQualityForScanQuality:quality];
+
+    // the context holds the evidence of the frames before this one, so it's created with the
+    // first frame and kept for as long as the scanner is
+    if (_context == NULL) {
+        _context = kikCodeScannerCreate((unsigned int)width, (unsigned int)height, qualityValue);
+        kikCodeScannerSetAccumulation(_context, 1, ACCUMULATED_FRAME_COUNT, ACCUMULATION_MAX_MISSES);
+        kikCodeScannerSetValidation(_context, 1);
+    }
+
+    kikCodeScannerScanAll(_context, (unsigned char *)data.bytes, (unsigned int)width, (unsigned int)height, (unsigned int)rowStride, qualityValue, &result, 1, &count);
+    if (count == 0) {
+        return nil;
+    }
+
+    if (confidence) {
+        *confidence = [[NSData alloc] initWithBytes:result.confidence length:MAIN_BYTE_COUNT];
+    }
+    return [[NSData alloc] initWithBytes:result.data length:MAIN_BYTE_COUNT];
+}
+
+@end
+
+/**
+ * What the scanner's callback is given instead of the KikCodesScanner itself. It's retained for as
+ * long as the async scanner can call back, but only holds the KikCodesScanner weakly, so that the
+ * KikCodesScanner can still be deallocated while it's running.
+ */
+@interface KikCodesScannerTarget : NSObject
+
+@property (atomic, weak) KikCodesScanner *scanner;
+
+@end
+
+@implementation KikCodesScannerTarget
+@end
+
+@interface KikCodesScanner () {
+    KikCodeScanContext *_context;
+    KikCodeAsyncScanner *_scanner;
+    CFTypeRef _target;
+    unsigned int _deviceQuality;
+}
+
+@property (nonatomic, copy) void (^handler)(NSData * _Nullable data, NSData * _Nullable confidence);
+
+@end
+
+static void scannerCallback(void *userData, int status, const KikCodeScanResult *results, unsigned int resultCount, const KikCodeScanTiming *timing) {
+    KikCodesScannerTarget *target = (__bridge KikCodesScannerTarget *)userData;
+
+    // held until the callback returns, so if the handler drops the last other reference the
+    // scanner is deallocated then, on the worker thread
+    KikCodesScanner *scanner = target.scanner;
+
+    if (!scanner) {
+        return;
+    }
+
+    if (status != KIK_CODE_SCAN_RESULT_SUCCESS || resultCount == 0) {
+        scanner.handler(nil, nil);
+        return;
+    }
+
+    scanner.handler([[NSData alloc] initWithBytes:results[0].data length:MAIN_BYTE_COUNT],
+                    [[NSData alloc] initWithBytes:results[0].confidence length:MAIN_BYTE_COUNT]);
+}
+
+@implementation KikCodesScanner
+
+- (instancetype)initWithWidth:(NSInteger)width height:(NSInteger)height quality:(KikCodesScanQuality)quality handler:(void (^)(NSData * _Nullable, NSData * _Nullable))handler {
+    self = [super init];
+    if (self) {
+        _handler = [handler copy];
+        _deviceQuality = [KikCodes deviceQualityForScanQuality:quality];
+
+        _context = kikCodeScannerCreate((unsigned int)MAX(width, 1), (unsigned int)MAX(height, 1), _deviceQuality);
+        kikCodeScannerSetAccumulation(_context, 1, ACCUMULATED_FRAME_COUNT, ACCUMULATION_MAX_MISSES);
+        kikCodeScannerSetValidation(_context, 1);
+
+        KikCodesScannerTarget *target = [[KikCodesScannerTarget alloc] init];
+        target.scanner = self;
+        _target = CFBridgingRetain(target);
+
+        _scanner = kikCodeAsyncScannerCreate(_context, 1, scannerCallback, (void *)_target);
+    }
+    return self;
+}
+
+- (void)dealloc {
+    // stops the worker first, it's the only other user of the context and the target. This can
+    // run on the worker itself, from the callback, which the async scanner allows for
+    kikCodeAsyncScannerDestroy(_scanner);
+    kikCodeScannerDestroy(_context);
+    CFRelease(_target);
+}
+
+- (void)submit:(NSData *)data width:(NSInteger)width height:(NSInteger)height rowStride:(NSInteger)rowStride {
+    if (width <= 0 || height <= 0 || rowStride < width || data.length < (NSUInteger)(rowStride * (height - 1) + width)) {
+        return;
+    }
+
+    kikCodeAsyncScannerSubmit(_scanner, (const unsigned char *)data.bytes, (unsigned int)width, (unsigned int)height, (unsigned int)rowStride, _deviceQuality);
+}
+
+@end
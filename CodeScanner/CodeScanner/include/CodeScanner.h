@@ -22,9 +22,69 @@ typedef NS_ENUM(NSInteger, KikCodesScanQuality) {
 + (NSData *)encode:(NSData *)data;
 + (NSData *)decode:(NSData *)data;
 
+/// Decodes scanned data, retrying the least confidently read bytes as erasures if the code has
+/// too much damage to be corrected otherwise. `confidence` is what the scan reported.
++ (NSData *)decode:(NSData *)data confidence:(nullable NSData *)confidence;
+
 + (nullable NSData *)scan:(NSData *)data width:(NSInteger)width height:(NSInteger)height;
 + (nullable NSData *)scan:(NSData *)data width:(NSInteger)width height:(NSInteger)height quality:(KikCodesScanQuality)quality;
 
+/// Scans a luminance plane in place, without unpadding it first. `data` must hold at least
+/// `rowStride * (height - 1) + width` bytes.
++ (nullable NSData *)scan:(NSData *)data width:(NSInteger)width height:(NSInteger)height rowStride:(NSInteger)rowStride quality:(KikCodesScanQuality)quality;
+
+/// Like `scan:width:height:rowStride:quality:`, also returning how confidently each byte was read,
+/// for `decode:confidence:`. Each call only sees its own frame, see `KikCodesFrameScanner` for
+/// consecutive camera frames.
++ (nullable NSData *)scan:(NSData *)data width:(NSInteger)width height:(NSInteger)height rowStride:(NSInteger)rowStride quality:(KikCodesScanQuality)quality confidence:(NSData * _Nullable * _Nullable)confidence;
+
+/// Scans a luminance plane for every code in view, returning the raw data of each one. Candidates
+/// overlapping a code that was already found are skipped. Returns an empty array if nothing is found.
++ (NSArray<NSData *> *)scanAll:(NSData *)data width:(NSInteger)width height:(NSInteger)height rowStride:(NSInteger)rowStride quality:(KikCodesScanQuality)quality;
+
+/// Starts or stops recording how long each stage of every scan takes. Off by default, and close to
+/// free while off.
++ (void)setTracingEnabled:(BOOL)enabled;
+
+/// Returns the stages recorded since the last call as a Chrome trace, to be opened in Perfetto or
+/// chrome://tracing.
++ (NSData *)takeTrace;
+
+/// Starts recording every frame scanned, as it was passed in and with the code found in it, to a
+/// frame archive at `path` that `kikscan_replay` scans again. Returns NO if the file can't be created.
++ (BOOL)startRecordingToPath:(NSString *)path;
+
+/// Stops recording and closes the archive.
++ (void)stopRecording;
+
+@end
+
+/// Scans consecutive frames of one camera on the calling thread. A code that's too damaged to read
+/// in any single frame is decoded from its samples averaged over the last few frames. Each scanner
+/// keeps the evidence of its own frames, so use one per camera, from one thread at a time.
+@interface KikCodesFrameScanner : NSObject
+
+/// Like `+[KikCodes scan:width:height:rowStride:quality:confidence:]`, with the frames scanned
+/// before this one.
+- (nullable NSData *)scan:(NSData *)data width:(NSInteger)width height:(NSInteger)height rowStride:(NSInteger)rowStride quality:(KikCodesScanQuality)quality confidence:(NSData * _Nullable * _Nullable)confidence;
+
+@end
+
+/// Scans consecutive camera frames on a thread of its own. `submit:` copies the frame and returns
+/// straight away, so capture never waits on a scan. Frames that arrive while one is being scanned
+/// replace each other, and only the newest is scanned next. Like `KikCodesFrameScanner`, codes are
+/// averaged over several frames.
+@interface KikCodesScanner : NSObject
+
+/// `handler` is called on the scanner's thread once for every frame scanned, with the code's raw
+/// data and confidence, or nil if nothing was found.
+- (instancetype)initWithWidth:(NSInteger)width height:(NSInteger)height quality:(KikCodesScanQuality)quality handler:(void (^)(NSData * _Nullable data, NSData * _Nullable confidence))handler;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+/// Queues a copy of a luminance plane. `data` must hold at least `rowStride * (height - 1) + width` bytes.
+- (void)submit:(NSData *)data width:(NSInteger)width height:(NSInteger)height rowStride:(NSInteger)rowStride;
+
 @end
 
 NS_ASSUME_NONNULL_END
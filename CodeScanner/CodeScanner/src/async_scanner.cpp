@@ -0,0 +1,161 @@
+#include "async_scanner.h"
+#include "frame_recorder.h"
+#include "trace.h"
+
+#include <string.h>
+
+using namespace std;
+using namespace cv;
+
+/**
+ * @returns Microseconds on the tracing clock
+ */
+static uint64_t getTimestamp()
+{
+    return kikCodeTraceNow() / 1000;
+}
+
+AsyncScanner::AsyncScanner(KikCodeScanner &scanner, unsigned int max_results, KikCodeScanCallback callback, void *user_data)
+: scanner_(scanner)
+, max_results_(max_results > 0 ? max_results : 1)
+, callback_(callback)
+, user_data_(user_data)
+, results_(max_results_)
+, pending_(-1)
+, scanning_(-1)
+, next_frame_id_(1)
+, dropped_(0)
+, stopping_(false)
+{
+    thread_ = thread(&AsyncScanner::workerLoop, this);
+}
+
+AsyncScanner::~AsyncScanner()
+{
+    stop();
+    thread_.join();
+}
+
+void AsyncScanner::stop()
+{
+    {
+        lock_guard<mutex> lock(mutex_);
+        stopping_ = true;
+    }
+
+    frame_available_.notify_all();
+}
+
+bool AsyncScanner::onWorkerThread() const
+{
+    return this_thread::get_id() == thread_.get_id();
+}
+
+unsigned int AsyncScanner::submit(const uint8_t *plane, unsigned int width, unsigned int height, unsigned int row_stride, unsigned int device_quality)
+{
+    if (row_stride < width) {
+        return 0;
+    }
+
+    lock_guard<mutex> submit_lock(submit_mutex_);
+
+    // neither the frame waiting nor the one being scanned, of three slots one is always left
+    int free_slot = 0;
+    unsigned int frame_id;
+
+    {
+        lock_guard<mutex> lock(mutex_);
+
+        while (free_slot == pending_ || free_slot == scanning_) {
+            ++free_slot;
+        }
+
+        frame_id = next_frame_id_++;
+    }
+
+    // the copy is made outside the lock so that the worker can take the waiting frame meanwhile
+    Slot &slot = slots_[free_slot];
+
+    if (slot.pixels.size() < (size_t)width * height) {
+        slot.pixels.resize((size_t)width * height);
+    }
+
+    for (unsigned int y = 0; y < height; ++y) {
+        memcpy(&slot.pixels[(size_t)y * width], plane + (size_t)y * row_stride, width);
+    }
+
+    slot.width = width;
+    slot.height = height;
+    slot.device_quality = device_quality;
+    slot.frame_id = frame_id;
+    slot.submitted = getTimestamp();
+
+    {
+        lock_guard<mutex> lock(mutex_);
+
+        if (pending_ >= 0) {
+            ++dropped_;
+        }
+
+        pending_ = free_slot;
+    }
+
+    frame_available_.notify_one();
+
+    return frame_id;
+}
+
+void AsyncScanner::workerLoop()
+{
+    while (true) {
+        unsigned int dropped;
+
+        {
+            unique_lock<mutex> lock(mutex_);
+            frame_available_.wait(lock, [this] { return stopping_ || pending_ >= 0; });
+
+            if (stopping_) {
+                return;
+            }
+
+            scanning_ = pending_;
+            pending_ = -1;
+
+            dropped = dropped_;
+            dropped_ = 0;
+        }
+
+        Slot &slot = slots_[scanning_];
+
+        // recorded with the time it was submitted, so that replay keeps the camera's pacing, and
+        // before the scan is timed
+        FrameRecorder recorder(slot.pixels.data(), slot.width, slot.height, slot.width, slot.device_quality, slot.submitted * 1000);
+
+        uint64_t started = getTimestamp();
+
+        // the stages of the scan, timed whether or not tracing is enabled
+        TraceTotals stages;
+
+        const Mat frame(slot.height, slot.width, CV_8UC1, slot.pixels.data());
+        size_t count = scanner_.scan(frame, slot.device_quality, results_.data(), max_results_);
+        recorder.setResults(results_.data(), count);
+
+        KikCodeScanTiming timing;
+        timing.frame_id = slot.frame_id;
+        timing.dropped_frames = dropped;
+        timing.queued = (started - slot.submitted) / 1000.0;
+        stages.fillTiming(&timing);
+        timing.total = (getTimestamp() - started) / 1000.0;
+        timing.exhaustive = scanner_.lastScanExhaustive() ? 1 : 0;
+        timing.working_width = scanner_.lastWorkingSize().width;
+        timing.working_height = scanner_.lastWorkingSize().height;
+        timing.next_working_edge = MAX(scanner_.nextWorkingSize().width, scanner_.nextWorkingSize().height);
+
+        callback_(user_data_, scanner_.resultCode(count), results_.data(), (unsigned int)count, &timing);
+
+        {
+            lock_guard<mutex> lock(mutex_);
+            scanning_ = -1;
+        }
+    }
+}
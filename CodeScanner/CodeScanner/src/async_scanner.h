@@ -0,0 +1,89 @@
+#ifndef __ASYNC_SCANNER_H__
+#define __ASYNC_SCANNER_H__
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "kikcode_scan.h"
+#include "scanner.h"
+
+// frames held at once: the one being scanned, the newest one waiting, and the one being copied in
+#define ASYNC_SLOT_COUNT 3
+
+/**
+ * Scans frames on a thread of its own, newest frame first.
+ *
+ * submit() copies a frame into a free slot of a small ring and returns without waiting for any
+ * scan. The worker always takes the newest frame waiting, so a frame that is still waiting when a
+ * newer one arrives is dropped rather than queued behind it, and a slow scan costs later frames
+ * nothing but their place in line. Each scanned frame is reported to the callback, on the worker
+ * thread, with its results and how long each stage took.
+ *
+ * The scanner is borrowed and must not be used by anything else until the AsyncScanner is
+ * destroyed. submit() may be called from any number of threads.
+ */
+class AsyncScanner {
+public:
+    AsyncScanner(KikCodeScanner &scanner, unsigned int max_results, KikCodeScanCallback callback, void *user_data);
+
+    /**
+     * Stops the worker. A frame still waiting is dropped, one being scanned is finished and
+     * reported first.
+     */
+    ~AsyncScanner();
+
+    /**
+     * Stops the worker without waiting for it, once the frame being scanned is reported no other
+     * frame is scanned or reported. Unlike the destructor it can be called from the callback.
+     */
+    void stop();
+
+    /**
+     * @returns True iff called on the worker thread, from within the callback
+     */
+    bool onWorkerThread() const;
+
+    /**
+     * Queues a copy of a greyscale plane whose rows are row_stride bytes apart.
+     *
+     * @returns The frame's id, which the callback reports it with, 0 if row_stride is less than width
+     */
+    unsigned int submit(const uint8_t *plane, unsigned int width, unsigned int height, unsigned int row_stride, unsigned int device_quality);
+
+private:
+    typedef struct {
+        std::vector<uint8_t> pixels;
+        unsigned int width;
+        unsigned int height;
+        unsigned int device_quality;
+        unsigned int frame_id;
+        uint64_t submitted;
+    } Slot;
+
+    KikCodeScanner &scanner_;
+    unsigned int max_results_;
+    KikCodeScanCallback callback_;
+    void *user_data_;
+
+    std::vector<KikCodeScanResult> results_;
+    Slot slots_[ASYNC_SLOT_COUNT];
+
+    // only one frame is copied in at a time, so there is always a free slot to copy into
+    std::mutex submit_mutex_;
+
+    std::mutex mutex_;
+    std::condition_variable frame_available_;
+    int pending_;
+    int scanning_;
+    unsigned int next_frame_id_;
+    unsigned int dropped_;
+    bool stopping_;
+
+    std::thread thread_;
+
+    void workerLoop();
+};
+
+#endif // __ASYNC_SCANNER_H__
@@ -0,0 +1,289 @@
+#include "bitplane.h"
+
+#include <algorithm>
+#include <string.h>
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define BITPLANE_NEON 1
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#define BITPLANE_AVX2 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define BITPLANE_SSE2 1
+#endif
+
+using namespace std;
+
+// rows are padded to this many words so that whole rows can be combined 256 bits at a time
+#define BITPLANE_ROW_ALIGNMENT  4
+
+// each byte of bits expanded to eight bytes of 0 or 255, lowest bit first
+typedef struct {
+    uint64_t masks[256];
+} ByteExpansion;
+
+static constexpr ByteExpansion makeByteExpansion()
+{
+    ByteExpansion expansion = {};
+
+    for (int value = 0; value < 256; ++value) {
+        for (int bit = 0; bit < 8; ++bit) {
+            if ((value >> bit) & 0x1) {
+                expansion.masks[value] |= (uint64_t)0xFF << (8 * bit);
+            }
+        }
+    }
+
+    return expansion;
+}
+
+static constexpr ByteExpansion byte_expansion = makeByteExpansion();
+
+/**
+ * Packs the 64 bytes at src into a word, a bit for every non-zero byte.
+ */
+static inline uint64_t packWord(const uint8_t *src)
+{
+#if BITPLANE_NEON
+    static const uint8_t weights[16] = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+    const uint8x16_t bit_weights = vld1q_u8(weights);
+
+    uint64_t word = 0;
+
+    for (int i = 0; i < 4; ++i) {
+        uint8x16_t bytes = vld1q_u8(src + 16 * i);
+        uint8x16_t bits = vandq_u8(vtstq_u8(bytes, bytes), bit_weights);
+
+        word |= (uint64_t)vaddv_u8(vget_low_u8(bits)) << (16 * i);
+        word |= (uint64_t)vaddv_u8(vget_high_u8(bits)) << (16 * i + 8);
+    }
+
+    return word;
+#elif BITPLANE_AVX2
+    const __m256i zero = _mm256_setzero_si256();
+
+    uint32_t low = ~(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)src), zero));
+    uint32_t high = ~(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(src + 32)), zero));
+
+    return low | ((uint64_t)high << 32);
+#elif BITPLANE_SSE2
+    const __m128i zero = _mm_setzero_si128();
+
+    uint64_t word = 0;
+
+    for (int i = 0; i < 4; ++i) {
+        uint32_t bits = ~_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(src + 16 * i)), zero)) & 0xFFFF;
+        word |= (uint64_t)bits << (16 * i);
+    }
+
+    return word;
+#else
+    uint64_t word = 0;
+
+    for (int i = 0; i < 64; ++i) {
+        word |= (uint64_t)(src[i] != 0) << i;
+    }
+
+    return word;
+#endif
+}
+
+Bitplane::Bitplane()
+: width_(0)
+, height_(0)
+, words_per_row_(0)
+{
+}
+
+void Bitplane::create(int width, int height)
+{
+    width_ = width;
+    height_ = height;
+
+    words_per_row_ = (width + 63) / 64;
+    words_per_row_ = (words_per_row_ + BITPLANE_ROW_ALIGNMENT - 1) / BITPLANE_ROW_ALIGNMENT * BITPLANE_ROW_ALIGNMENT;
+
+    if (words_.size() < words_per_row_ * height) {
+        words_.resize(words_per_row_ * height);
+    }
+}
+
+void Bitplane::clear()
+{
+    fill(words_.begin(), words_.begin() + words_per_row_ * height_, 0);
+}
+
+void Bitplane::pack(const uint8_t *src, size_t src_stride)
+{
+    for (int y = 0; y < height_; ++y) {
+        const uint8_t *src_row = src + y * src_stride;
+        uint64_t *row = &words_[y * words_per_row_];
+        int x = 0;
+        size_t word = 0;
+
+        for (; x + 64 <= width_; x += 64) {
+            row[word++] = packWord(src_row + x);
+        }
+
+        // the last partial word, then the padding
+        if (x < width_) {
+            uint64_t bits = 0;
+
+            for (int i = 0; x + i < width_; ++i) {
+                bits |= (uint64_t)(src_row[x + i] != 0) << i;
+            }
+
+            row[word++] = bits;
+        }
+
+        for (; word < words_per_row_; ++word) {
+            row[word] = 0;
+        }
+    }
+}
+
+uint64_t Bitplane::bitsAt(const uint64_t *row, int x0) const
+{
+    size_t word = x0 >> 6;
+    int shift = x0 & 63;
+
+    uint64_t bits = row[word] >> shift;
+
+    if (shift != 0 && word + 1 < words_per_row_) {
+        bits |= row[word + 1] << (64 - shift);
+    }
+
+    return bits;
+}
+
+void Bitplane::unpack(int x0, int y0, int width, int height, uint8_t *dst, size_t dst_stride) const
+{
+    for (int y = 0; y < height; ++y) {
+        const uint64_t *row = &words_[(y0 + y) * words_per_row_];
+        uint8_t *out = dst + y * dst_stride;
+
+        for (int x = 0; x < width; x += 64) {
+            uint64_t bits = bitsAt(row, x0 + x);
+            int count = min(64, width - x);
+            int i = 0;
+
+            for (; i + 8 <= count; i += 8) {
+                memcpy(out + x + i, &byte_expansion.masks[(bits >> i) & 0xFF], 8);
+            }
+
+            for (; i < count; ++i) {
+                out[x + i] = ((bits >> i) & 0x1) ? 255 : 0;
+            }
+        }
+    }
+}
+
+void Bitplane::unpackMasked(int x0, int y0, int width, int height, const uint8_t *mask, size_t mask_stride, uint8_t *dst, size_t dst_stride) const
+{
+    for (int y = 0; y < height; ++y) {
+        const uint64_t *row = &words_[(y0 + y) * words_per_row_];
+        const uint8_t *in = mask + y * mask_stride;
+        uint8_t *out = dst + y * dst_stride;
+
+        for (int x = 0; x < width; x += 64) {
+            uint64_t bits = bitsAt(row, x0 + x);
+            int count = min(64, width - x);
+            int i = 0;
+
+            for (; i + 8 <= count; i += 8) {
+                uint64_t bytes;
+
+                memcpy(&bytes, in + x + i, 8);
+                bytes &= byte_expansion.masks[(bits >> i) & 0xFF];
+                memcpy(out + x + i, &bytes, 8);
+            }
+
+            for (; i < count; ++i) {
+                out[x + i] = ((bits >> i) & 0x1) ? in[x + i] : 0;
+            }
+        }
+    }
+}
+
+void Bitplane::andWith(const Bitplane &other)
+{
+    uint64_t *words = &words_[0];
+    const uint64_t *other_words = &other.words_[0];
+    size_t count = words_per_row_ * height_;
+    size_t i = 0;
+
+#if BITPLANE_NEON
+    for (; i + 2 <= count; i += 2) {
+        vst1q_u64(words + i, vandq_u64(vld1q_u64(words + i), vld1q_u64(other_words + i)));
+    }
+#elif BITPLANE_AVX2
+    for (; i + 4 <= count; i += 4) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(words + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(other_words + i));
+        _mm256_storeu_si256((__m256i *)(words + i), _mm256_and_si256(a, b));
+    }
+#elif BITPLANE_SSE2
+    for (; i + 2 <= count; i += 2) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(words + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(other_words + i));
+        _mm_storeu_si128((__m128i *)(words + i), _mm_and_si128(a, b));
+    }
+#endif
+
+    for (; i < count; ++i) {
+        words[i] &= other_words[i];
+    }
+}
+
+void Bitplane::orWith(const Bitplane &other)
+{
+    uint64_t *words = &words_[0];
+    const uint64_t *other_words = &other.words_[0];
+    size_t count = words_per_row_ * height_;
+    size_t i = 0;
+
+#if BITPLANE_NEON
+    for (; i + 2 <= count; i += 2) {
+        vst1q_u64(words + i, vorrq_u64(vld1q_u64(words + i), vld1q_u64(other_words + i)));
+    }
+#elif BITPLANE_AVX2
+    for (; i + 4 <= count; i += 4) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(words + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(other_words + i));
+        _mm256_storeu_si256((__m256i *)(words + i), _mm256_or_si256(a, b));
+    }
+#elif BITPLANE_SSE2
+    for (; i + 2 <= count; i += 2) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(words + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(other_words + i));
+        _mm_storeu_si128((__m128i *)(words + i), _mm_or_si128(a, b));
+    }
+#endif
+
+    for (; i < count; ++i) {
+        words[i] |= other_words[i];
+    }
+}
+
+size_t Bitplane::count() const
+{
+    const uint64_t *words = words_.data();
+    size_t words_count = words_per_row_ * height_;
+    size_t total = 0;
+    size_t i = 0;
+
+#if BITPLANE_NEON
+    // byte counts summed per 16 bytes, well within a 16-bit lane
+    for (; i + 2 <= words_count; i += 2) {
+        total += vaddlvq_u8(vcntq_u8(vreinterpretq_u8_u64(vld1q_u64(words + i))));
+    }
+#endif
+
+    for (; i < words_count; ++i) {
+        total += __builtin_popcountll(words[i]);
+    }
+
+    return total;
+}
@@ -0,0 +1,92 @@
+#ifndef __BITPLANE_H__
+#define __BITPLANE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/**
+ * A binary image packed one bit per pixel, an eighth of the size of the CV_8UC1 masks OpenCV
+ * works with.
+ *
+ * Pixel x of a row is bit x % 64 of the row's word x / 64. Rows are padded to a multiple of four
+ * words, the padding bits are always 0. Like the scanner's other buffers the storage only ever
+ * grows, so a smaller create() reuses the memory of a larger one.
+ *
+ * OpenCV still needs bytes to find contours in or draw into, so planes are packed from and
+ * unpacked into byte masks at those points. Everything in between (combining masks, sampling,
+ * counting) works on the packed bits, with NEON on ARM and AVX2 or SSE2 on x86 where it helps.
+ */
+class Bitplane {
+public:
+    Bitplane();
+
+    /**
+     * Sizes the plane, its contents are undefined until the next pack() or clear().
+     */
+    void create(int width, int height);
+
+    int width() const
+    {
+        return width_;
+    }
+
+    int height() const
+    {
+        return height_;
+    }
+
+    bool get(int x, int y) const
+    {
+        return (words_[y * words_per_row_ + (x >> 6)] >> (x & 63)) & 0x1;
+    }
+
+    /**
+     * The words of row y, followed by the row's padding.
+     */
+    const uint64_t *row(int y) const
+    {
+        return &words_[y * words_per_row_];
+    }
+
+    void clear();
+
+    /**
+     * Packs a byte mask of the plane's size, any non-zero byte is a 1.
+     */
+    void pack(const uint8_t *src, size_t src_stride);
+
+    /**
+     * Unpacks the region at (x0, y0) into a byte mask of 0 and 255. dst points at the region's
+     * top-left pixel.
+     */
+    void unpack(int x0, int y0, int width, int height, uint8_t *dst, size_t dst_stride) const;
+
+    /**
+     * Like unpack(), but only keeps the pixels that are also set in mask, the same as unpacking and
+     * then taking bitwise_and() with mask. mask and dst may be the same buffer.
+     */
+    void unpackMasked(int x0, int y0, int width, int height, const uint8_t *mask, size_t mask_stride, uint8_t *dst, size_t dst_stride) const;
+
+    /**
+     * Combines other, which has to be the same size, into this plane.
+     */
+    void andWith(const Bitplane &other);
+    void orWith(const Bitplane &other);
+
+    /**
+     * @returns The number of pixels set
+     */
+    size_t count() const;
+
+private:
+    int width_;
+    int height_;
+    size_t words_per_row_;
+    std::vector<uint64_t> words_;
+
+    // bits [x0, x0 + 64) of row, the bits past the end of the row are 0
+    uint64_t bitsAt(const uint64_t *row, int x0) const;
+};
+
+#endif // __BITPLANE_H__
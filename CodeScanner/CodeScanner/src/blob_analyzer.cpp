@@ -0,0 +1,233 @@
+#include "blob_analyzer.h"
+
+#include <algorithm>
+#include <limits.h>
+
+using namespace std;
+
+/**
+ * @returns The sum of k^2 for k in [0, n]
+ */
+static inline int64_t sumOfSquares(int64_t n)
+{
+    return n * (n + 1) * (2 * n + 1) / 6;
+}
+
+int BlobAnalyzer::find(int label)
+{
+    while (roots_[label] != label) {
+        roots_[label] = roots_[roots_[label]];
+        label = roots_[label];
+    }
+
+    return label;
+}
+
+void BlobAnalyzer::unite(int a, int b)
+{
+    a = find(a);
+    b = find(b);
+
+    // the smaller label was created first, so it's the one on the blob's first run
+    if (a < b) {
+        roots_[b] = a;
+    }
+    else if (b < a) {
+        roots_[a] = b;
+    }
+}
+
+void BlobAnalyzer::extractRuns(const Bitplane &plane, int y)
+{
+    const uint64_t *row = plane.row(y);
+    int width = plane.width();
+
+    runs_.clear();
+
+    int x = 0;
+    bool light = row[0] & 0x1;
+
+    while (x < width) {
+        // the bits that differ from the run, the first of them ends it
+        uint64_t flip = light ? ~(uint64_t)0 : 0;
+        size_t word = x >> 6;
+        uint64_t bits = (row[word] ^ flip) & (~(uint64_t)0 << (x & 63));
+
+        while (bits == 0 && (int)((word + 1) << 6) < width) {
+            bits = row[++word] ^ flip;
+        }
+
+        int end = bits != 0 ? min(width, (int)(word << 6) + __builtin_ctzll(bits)) : width;
+
+        Run run = { x, end, light, -1 };
+        runs_.push_back(run);
+
+        x = end;
+        light = !light;
+    }
+}
+
+void BlobAnalyzer::analyze(const Bitplane &plane)
+{
+    int width = plane.width();
+    int height = plane.height();
+
+    previous_runs_.clear();
+    labels_.clear();
+    roots_.clear();
+    blobs_.clear();
+
+    for (int y = 0; y < height; ++y) {
+        extractRuns(plane, y);
+
+        // both rows are partitioned into alternating runs, so the runs of the previous row that can
+        // touch a run only ever move forward
+        size_t first = 0;
+
+        for (size_t i = 0; i < runs_.size(); ++i) {
+            Run &run = runs_[i];
+            int label = -1;
+
+            while (first < previous_runs_.size() && previous_runs_[first].end < run.start) {
+                ++first;
+            }
+
+            for (size_t j = first; j < previous_runs_.size() && previous_runs_[j].start <= run.end; ++j) {
+                const Run &above = previous_runs_[j];
+
+                if (above.light != run.light) {
+                    continue;
+                }
+
+                // set runs that only meet at a corner are connected, unset ones aren't
+                int overlap = min(above.end, run.end) - max(above.start, run.start);
+
+                if (overlap < 0 || (overlap == 0 && !run.light)) {
+                    continue;
+                }
+
+                // the edges the two runs share aren't on the blob's boundary
+                labels_[above.label].perimeter -= 2 * overlap;
+
+                if (label < 0) {
+                    label = find(above.label);
+                }
+                else {
+                    unite(label, above.label);
+                    label = find(label);
+                }
+            }
+
+            if (label < 0) {
+                Blob blob = {};
+                blob.light = run.light;
+                blob.parent = -1;
+                blob.left = INT_MAX;
+                blob.top = y;
+                blob.right = -1;
+                blob.bottom = y;
+
+                // the pixel above a blob's first run is of the other polarity, and can only be part
+                // of whatever surrounds the blob
+                if (y > 0) {
+                    size_t j = first;
+
+                    while (previous_runs_[j].end <= run.start) {
+                        ++j;
+                    }
+
+                    blob.parent = previous_runs_[j].label;
+                }
+
+                label = (int)labels_.size();
+                labels_.push_back(blob);
+                roots_.push_back(label);
+            }
+
+            run.label = label;
+
+            Blob &blob = labels_[label];
+            int64_t length = run.end - run.start;
+            int64_t sum_x = (int64_t)(run.start + run.end - 1) * length / 2;
+
+            blob.area += length;
+            blob.perimeter += 2 + 2 * length;
+            blob.sum_x += sum_x;
+            blob.sum_y += length * y;
+            blob.sum_xx += sumOfSquares(run.end - 1) - sumOfSquares(run.start - 1);
+            blob.sum_xy += sum_x * y;
+            blob.sum_yy += length * y * y;
+
+            blob.left = min(blob.left, run.start);
+            blob.right = max(blob.right, run.end - 1);
+            blob.bottom = y;
+
+            if (y == 0 || y == height - 1 || run.start == 0 || run.end == width) {
+                blob.touches_border = true;
+            }
+        }
+
+        swap(previous_runs_, runs_);
+    }
+
+    // fold the provisional labels into their blobs, a root always comes before the labels merged
+    // into it
+    blob_indices_.resize(labels_.size());
+
+    for (size_t label = 0; label < labels_.size(); ++label) {
+        int root = find((int)label);
+        const Blob &part = labels_[label];
+
+        if (root == (int)label) {
+            blob_indices_[label] = (int)blobs_.size();
+            blobs_.push_back(part);
+            continue;
+        }
+
+        Blob &blob = blobs_[blob_indices_[root]];
+
+        blob.touches_border = blob.touches_border || part.touches_border;
+        blob.left = min(blob.left, part.left);
+        blob.top = min(blob.top, part.top);
+        blob.right = max(blob.right, part.right);
+        blob.bottom = max(blob.bottom, part.bottom);
+        blob.area += part.area;
+        blob.perimeter += part.perimeter;
+        blob.sum_x += part.sum_x;
+        blob.sum_y += part.sum_y;
+        blob.sum_xx += part.sum_xx;
+        blob.sum_xy += part.sum_xy;
+        blob.sum_yy += part.sum_yy;
+    }
+
+    for (size_t label = 0; label < labels_.size(); ++label) {
+        if (roots_[label] == (int)label) {
+            Blob &blob = blobs_[blob_indices_[label]];
+
+            blob.filled_area = blob.area;
+
+            if (blob.parent >= 0) {
+                blob.parent = blob_indices_[find(blob.parent)];
+            }
+        }
+    }
+
+    // enclosed blobs come after their parents, so going backwards every blob is complete by the
+    // time it's added to the blob around it. Unset blobs at the border aren't holes in anything
+    for (size_t i = blobs_.size(); i-- > 0;) {
+        const Blob &blob = blobs_[i];
+
+        if (blob.parent < 0 || (!blob.light && blob.touches_border)) {
+            continue;
+        }
+
+        Blob &parent = blobs_[blob.parent];
+
+        parent.filled_area += blob.filled_area;
+        parent.sum_x += blob.sum_x;
+        parent.sum_y += blob.sum_y;
+        parent.sum_xx += blob.sum_xx;
+        parent.sum_xy += blob.sum_xy;
+        parent.sum_yy += blob.sum_yy;
+    }
+}
@@ -0,0 +1,95 @@
+#ifndef __BLOB_ANALYZER_H__
+#define __BLOB_ANALYZER_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "bitplane.h"
+
+/**
+ * Labels the connected components of a bitplane in a single pass over its runs, measuring each
+ * one as it goes.
+ *
+ * Both polarities are labelled, with the same connectivity findContours uses: set pixels are
+ * connected to their 8 neighbours and unset pixels to their 4 neighbours. Every blob records the
+ * blob that encloses it, so the unset blobs that aren't the outside of the frame are the holes of
+ * the set blobs around them.
+ *
+ * Labels are resolved with union-find on the runs of the previous row, and a blob's statistics are
+ * the sum of those of its runs, so no blob is ever traced or stored pixel by pixel.
+ */
+class BlobAnalyzer {
+public:
+    typedef struct {
+        // a component of set pixels rather than unset ones
+        bool light;
+
+        // reaches the edge of the frame, which for unset pixels means it's the background rather
+        // than a hole
+        bool touches_border;
+
+        // index of the blob whose outer boundary surrounds this one, -1 for none
+        int parent;
+
+        // bounding box, inclusive
+        int left;
+        int top;
+        int right;
+        int bottom;
+
+        // pixels of the blob itself
+        int64_t area;
+
+        // unit pixel edges between the blob and anything else, on its outside as well as around its
+        // holes
+        int64_t perimeter;
+
+        // raw moments of everything within the blob's outer boundary, that is the blob with its
+        // holes (and whatever is in them) filled in
+        int64_t filled_area;
+        int64_t sum_x;
+        int64_t sum_y;
+        int64_t sum_xx;
+        int64_t sum_xy;
+        int64_t sum_yy;
+    } Blob;
+
+    /**
+     * Labels plane. The blobs are ordered by their first pixel in raster order, so a blob always
+     * comes after the blob that encloses it.
+     */
+    void analyze(const Bitplane &plane);
+
+    const std::vector<Blob> &blobs() const
+    {
+        return blobs_;
+    }
+
+private:
+    typedef struct {
+        // [start, end)
+        int start;
+        int end;
+        bool light;
+        int label;
+    } Run;
+
+    std::vector<Run> previous_runs_;
+    std::vector<Run> runs_;
+
+    // provisional labels, each one's statistics, union-find parent and final blob
+    std::vector<Blob> labels_;
+    std::vector<int> roots_;
+    std::vector<int> blob_indices_;
+
+    std::vector<Blob> blobs_;
+
+    int find(int label);
+
+    void unite(int a, int b);
+
+    void extractRuns(const Bitplane &plane, int y);
+};
+
+#endif // __BLOB_ANALYZER_H__
@@ -0,0 +1,247 @@
+#include "frame_archive.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <mutex>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+struct FrameArchiveWriter {
+    int fd;
+    uint64_t end;
+    mutex lock;
+};
+
+struct FrameArchive {
+    const uint8_t *mapping;
+    size_t size;
+    vector<uint64_t> offsets;
+};
+
+static const uint8_t archive_zeros[FRAME_ARCHIVE_ALIGNMENT] = {};
+
+static bool writeAt(int fd, const void *buffer, size_t size, uint64_t offset)
+{
+    const uint8_t *bytes = (const uint8_t *)buffer;
+
+    while (size > 0) {
+        ssize_t written = pwrite(fd, bytes, size, (off_t)offset);
+
+        // a signal that arrives mid-write only interrupts it, but a write that makes no progress
+        // would never finish
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (written <= 0) {
+            return false;
+        }
+
+        bytes += written;
+        size -= (size_t)written;
+        offset += (uint64_t)written;
+    }
+
+    return true;
+}
+
+/**
+ * @returns The bytes a plane takes up in an archive. Its last row is only width bytes long, a
+ * camera's plane needn't be padded after it
+ */
+static uint64_t planeSize(unsigned int width, unsigned int height, unsigned int row_stride)
+{
+    uint64_t size = height > 0 ? (uint64_t)(height - 1) * row_stride + width : 0;
+
+    return (size + FRAME_ARCHIVE_ALIGNMENT - 1) / FRAME_ARCHIVE_ALIGNMENT * FRAME_ARCHIVE_ALIGNMENT;
+}
+
+FrameArchiveWriter *frameArchiveCreate(const char *path)
+{
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    FrameArchiveHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, FRAME_ARCHIVE_MAGIC, sizeof(header.magic));
+    header.version = FRAME_ARCHIVE_VERSION;
+    header.header_size = sizeof(FrameArchiveHeader);
+    header.frame_header_size = sizeof(FrameArchiveFrame);
+
+    if (!writeAt(fd, &header, sizeof(header), 0)) {
+        close(fd);
+        return nullptr;
+    }
+
+    FrameArchiveWriter *writer = new FrameArchiveWriter;
+    writer->fd = fd;
+    writer->end = sizeof(header);
+
+    return writer;
+}
+
+void frameArchiveClose(FrameArchiveWriter *writer)
+{
+    if (writer) {
+        close(writer->fd);
+        delete writer;
+    }
+}
+
+int frameArchiveAppend(
+    FrameArchiveWriter *writer,
+    const unsigned char *plane,
+    unsigned int width,
+    unsigned int height,
+    unsigned int row_stride,
+    unsigned int device_quality,
+    uint64_t timestamp,
+    const unsigned char *payload,
+    uint64_t *out_offset)
+{
+    if (row_stride < width) {
+        return FRAME_ARCHIVE_RESULT_ERROR;
+    }
+
+    FrameArchiveFrame frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.width = width;
+    frame.height = height;
+    frame.row_stride = row_stride;
+    frame.timestamp = timestamp;
+    frame.plane_size = planeSize(width, height, row_stride);
+    frame.device_quality = device_quality;
+
+    if (payload) {
+        frame.flags |= FRAME_ARCHIVE_FLAG_PAYLOAD;
+        memcpy(frame.payload, payload, sizeof(frame.payload));
+    }
+
+    uint64_t used = height > 0 ? (uint64_t)(height - 1) * row_stride + width : 0;
+
+    lock_guard<mutex> guard(writer->lock);
+
+    uint64_t offset = writer->end;
+
+    // the frame is only complete to a reader once its last byte is written, so a frame cut short
+    // by the writer dying is ignored rather than read as garbage
+    if (!writeAt(writer->fd, &frame, sizeof(frame), offset) ||
+        !writeAt(writer->fd, plane, (size_t)used, offset + sizeof(frame)) ||
+        !writeAt(writer->fd, archive_zeros, (size_t)(frame.plane_size - used), offset + sizeof(frame) + used)) {
+        return FRAME_ARCHIVE_RESULT_ERROR;
+    }
+
+    writer->end = offset + sizeof(frame) + frame.plane_size;
+
+    if (out_offset) {
+        *out_offset = offset;
+    }
+
+    return FRAME_ARCHIVE_RESULT_SUCCESS;
+}
+
+int frameArchiveSetPayload(
+    FrameArchiveWriter *writer,
+    uint64_t offset,
+    const unsigned char *payload)
+{
+    uint32_t flags = FRAME_ARCHIVE_FLAG_PAYLOAD;
+
+    // the frame's other flags are only ever set when it's appended
+    if (!writeAt(writer->fd, payload, KIK_CODE_TOTAL_BYTE_COUNT, offset + offsetof(FrameArchiveFrame, payload)) ||
+        !writeAt(writer->fd, &flags, sizeof(flags), offset + offsetof(FrameArchiveFrame, flags))) {
+        return FRAME_ARCHIVE_RESULT_ERROR;
+    }
+
+    return FRAME_ARCHIVE_RESULT_SUCCESS;
+}
+
+FrameArchive *frameArchiveMap(const char *path)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    struct stat status;
+
+    if (fstat(fd, &status) != 0 || (size_t)status.st_size < sizeof(FrameArchiveHeader)) {
+        close(fd);
+        return nullptr;
+    }
+
+    size_t size = (size_t)status.st_size;
+    void *mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    // the mapping holds its own reference to the file
+    close(fd);
+
+    if (mapping == MAP_FAILED) {
+        return nullptr;
+    }
+
+    const FrameArchiveHeader *header = (const FrameArchiveHeader *)mapping;
+
+    if (memcmp(header->magic, FRAME_ARCHIVE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != FRAME_ARCHIVE_VERSION ||
+        header->header_size != sizeof(FrameArchiveHeader) ||
+        header->frame_header_size != sizeof(FrameArchiveFrame)) {
+        munmap(mapping, size);
+        return nullptr;
+    }
+
+    // replay reads the frames in order, once each
+    madvise(mapping, size, MADV_SEQUENTIAL);
+
+    FrameArchive *archive = new FrameArchive;
+    archive->mapping = (const uint8_t *)mapping;
+    archive->size = size;
+
+    uint64_t offset = header->header_size;
+
+    while (offset + sizeof(FrameArchiveFrame) <= size) {
+        const FrameArchiveFrame *frame = (const FrameArchiveFrame *)(archive->mapping + offset);
+
+        if (frame->row_stride < frame->width ||
+            frame->plane_size != planeSize(frame->width, frame->height, frame->row_stride) ||
+            offset + sizeof(FrameArchiveFrame) + frame->plane_size > size) {
+            break;
+        }
+
+        archive->offsets.push_back(offset);
+        offset += sizeof(FrameArchiveFrame) + frame->plane_size;
+    }
+
+    return archive;
+}
+
+void frameArchiveUnmap(FrameArchive *archive)
+{
+    if (archive) {
+        munmap((void *)archive->mapping, archive->size);
+        delete archive;
+    }
+}
+
+size_t frameArchiveFrameCount(const FrameArchive *archive)
+{
+    return archive->offsets.size();
+}
+
+const FrameArchiveFrame *frameArchiveFrameAt(const FrameArchive *archive, size_t index)
+{
+    if (index >= archive->offsets.size()) {
+        return nullptr;
+    }
+
+    return (const FrameArchiveFrame *)(archive->mapping + archive->offsets[index]);
+}
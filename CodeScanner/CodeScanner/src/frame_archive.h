@@ -0,0 +1,126 @@
+#ifndef __FRAME_ARCHIVE_H__
+#define __FRAME_ARCHIVE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "kikcode_constants.h"
+
+#define FRAME_ARCHIVE_RESULT_SUCCESS 0
+#define FRAME_ARCHIVE_RESULT_ERROR   1
+
+#define FRAME_ARCHIVE_MAGIC   "KIKFRAME"
+#define FRAME_ARCHIVE_VERSION 1
+
+// frame headers and planes start on multiples of this many bytes into the file, so that planes
+// in a mapped archive are as aligned as the buffers the scanner allocates itself
+#define FRAME_ARCHIVE_ALIGNMENT 64
+
+// the frame has a payload, the data of the code that's in it
+#define FRAME_ARCHIVE_FLAG_PAYLOAD 1
+
+/**
+ * An archive is a FrameArchiveHeader followed by frames, each a FrameArchiveFrame followed by its
+ * plane: height rows of row_stride bytes, exactly as they were passed to the scanner, padded to
+ * FRAME_ARCHIVE_ALIGNMENT. Every field is little-endian. Frames are only ever appended, so an
+ * archive whose writer was killed is read up to its last complete frame.
+ */
+typedef struct {
+    char magic[8];
+    uint32_t version;
+
+    // in bytes, so that later versions can grow them
+    uint32_t header_size;
+    uint32_t frame_header_size;
+
+    uint8_t reserved[44];
+} FrameArchiveHeader;
+
+typedef struct {
+    uint32_t width;
+    uint32_t height;
+    uint32_t row_stride;
+    uint32_t flags;
+
+    // nanoseconds on a monotonic clock, only meaningful relative to the other frames
+    uint64_t timestamp;
+
+    // bytes from the end of this header to the next frame's
+    uint64_t plane_size;
+
+    uint32_t device_quality;
+    uint32_t reserved;
+
+    // the KIK_CODE_TOTAL_BYTE_COUNT data bytes of the code in the frame, if it has
+    // FRAME_ARCHIVE_FLAG_PAYLOAD
+    uint8_t payload[KIK_CODE_TOTAL_BYTE_COUNT];
+
+    uint8_t padding[128 - 40 - KIK_CODE_TOTAL_BYTE_COUNT];
+} FrameArchiveFrame;
+
+static_assert(sizeof(FrameArchiveHeader) % FRAME_ARCHIVE_ALIGNMENT == 0, "archive header must keep frames aligned");
+static_assert(sizeof(FrameArchiveFrame) % FRAME_ARCHIVE_ALIGNMENT == 0, "frame header must keep planes aligned");
+
+typedef struct FrameArchiveWriter FrameArchiveWriter;
+typedef struct FrameArchive FrameArchive;
+
+/**
+ * Creates an archive at path, replacing any file there. One writer may be appended to from any
+ * number of threads.
+ *
+ * @returns nullptr if the file can't be created
+ */
+FrameArchiveWriter *frameArchiveCreate(const char *path);
+
+void frameArchiveClose(FrameArchiveWriter *writer);
+
+/**
+ * Appends a greyscale plane whose rows are row_stride bytes apart, taken at timestamp nanoseconds.
+ * payload, the data of the code known to be in the plane, may be nullptr. If out_offset isn't
+ * nullptr it's set to where the frame was written, for frameArchiveSetPayload.
+ *
+ * @returns FRAME_ARCHIVE_RESULT_ERROR if row_stride is less than width or the write failed
+ */
+int frameArchiveAppend(
+    FrameArchiveWriter *writer,
+    const unsigned char *plane,
+    unsigned int width,
+    unsigned int height,
+    unsigned int row_stride,
+    unsigned int device_quality,
+    uint64_t timestamp,
+    const unsigned char *payload,
+    uint64_t *out_offset);
+
+/**
+ * Gives the frame appended at offset a payload once it's known, such as after the frame has been
+ * scanned.
+ */
+int frameArchiveSetPayload(
+    FrameArchiveWriter *writer,
+    uint64_t offset,
+    const unsigned char *payload);
+
+/**
+ * Maps the archive at path read-only. Its planes are read straight out of the mapping, and stay
+ * valid until frameArchiveUnmap.
+ *
+ * @returns nullptr if the file can't be mapped or isn't an archive of a version this reads
+ */
+FrameArchive *frameArchiveMap(const char *path);
+
+void frameArchiveUnmap(FrameArchive *archive);
+
+size_t frameArchiveFrameCount(const FrameArchive *archive);
+
+const FrameArchiveFrame *frameArchiveFrameAt(const FrameArchive *archive, size_t index);
+
+/**
+ * @returns The first byte of the plane frame describes
+ */
+static inline const unsigned char *frameArchivePlane(const FrameArchiveFrame *frame)
+{
+    return (const unsigned char *)frame + sizeof(FrameArchiveFrame);
+}
+
+#endif // __FRAME_ARCHIVE_H__
@@ -0,0 +1,89 @@
+#include "frame_quality.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define FRAME_QUALITY_MAX_GRADIENT 510
+
+#define FRAME_HASH_COLUMNS 9
+#define FRAME_HASH_ROWS    8
+
+void kikCodeMeasureFrameQuality(const uint8_t *frame, size_t stride, int width, int height, FrameQuality *out_quality)
+{
+    uint32_t histogram[FRAME_QUALITY_MAX_GRADIENT + 1];
+    uint32_t cell_sums[FRAME_HASH_ROWS][FRAME_HASH_COLUMNS];
+    uint32_t cell_counts[FRAME_HASH_ROWS][FRAME_HASH_COLUMNS];
+
+    memset(histogram, 0, sizeof(histogram));
+    memset(cell_sums, 0, sizeof(cell_sums));
+    memset(cell_counts, 0, sizeof(cell_counts));
+
+    int step_x = (width - 1) / FRAME_QUALITY_GRID_SIZE;
+    int step_y = (height - 1) / FRAME_QUALITY_GRID_SIZE;
+
+    step_x = step_x > 1 ? step_x : 1;
+    step_y = step_y > 1 ? step_y : 1;
+
+    size_t sample_count = 0;
+
+    for (int y = 0; y + 1 < height; y += step_y) {
+        const uint8_t *row = frame + y * stride;
+        const uint8_t *below = row + stride;
+        int cell_y = y * FRAME_HASH_ROWS / height;
+
+        for (int x = 0; x + 1 < width; x += step_x) {
+            int gradient = abs(row[x + 1] - row[x]) + abs(below[x] - row[x]);
+            int cell_x = x * FRAME_HASH_COLUMNS / width;
+
+            ++histogram[gradient];
+            ++sample_count;
+
+            cell_sums[cell_y][cell_x] += row[x];
+            ++cell_counts[cell_y][cell_x];
+        }
+    }
+
+    // mean of the sharpest samples, read off the top of the histogram
+    size_t wanted = sample_count / FRAME_QUALITY_SHARPEST_DIVISOR;
+    size_t taken = 0;
+    uint64_t total = 0;
+
+    if (wanted == 0) {
+        wanted = sample_count;
+    }
+
+    for (int gradient = FRAME_QUALITY_MAX_GRADIENT; gradient >= 0 && taken < wanted; --gradient) {
+        size_t count = histogram[gradient];
+
+        if (count > wanted - taken) {
+            count = wanted - taken;
+        }
+
+        total += (uint64_t)count * gradient;
+        taken += count;
+    }
+
+    out_quality->sharpness = taken > 0 ? (uint32_t)(total / taken) : 0;
+
+    // compare the mean brightness of neighbouring cells, a / b < c / d as a * d < c * b
+    uint64_t hash = 0;
+    int bit = 0;
+
+    for (int r = 0; r < FRAME_HASH_ROWS; ++r) {
+        for (int c = 0; c + 1 < FRAME_HASH_COLUMNS; ++c, ++bit) {
+            uint64_t left = (uint64_t)cell_sums[r][c] * cell_counts[r][c + 1];
+            uint64_t right = (uint64_t)cell_sums[r][c + 1] * cell_counts[r][c];
+
+            if (left < right) {
+                hash |= (uint64_t)1 << bit;
+            }
+        }
+    }
+
+    out_quality->hash = hash;
+}
+
+int kikCodeFrameHashDistance(uint64_t a, uint64_t b)
+{
+    return __builtin_popcountll(a ^ b);
+}
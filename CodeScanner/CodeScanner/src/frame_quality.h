@@ -0,0 +1,37 @@
+#ifndef __FRAME_QUALITY_H__
+#define __FRAME_QUALITY_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+// frames are sampled on a grid of at most this many points along each edge
+#define FRAME_QUALITY_GRID_SIZE 64
+
+// the sharpness is the mean gradient of this fraction of the samples, the ones with the steepest
+// gradients. A code's edges only cover a small part of the frame, so the mean of the whole frame
+// would mostly measure the background
+#define FRAME_QUALITY_SHARPEST_DIVISOR 16
+
+typedef struct {
+    // mean of the sharpest gradients, from 0 for a flat frame to 510
+    uint32_t sharpness;
+
+    // difference hash of the frame, one bit per horizontally adjacent pair in a 9 x 8 grid of
+    // cells for whether the brightness increases from one cell to the next. Frames that look the
+    // same have hashes a small Hamming distance apart
+    uint64_t hash;
+} FrameQuality;
+
+/**
+ * Measures a greyscale frame from a sparse grid of samples, cheap enough to run on every frame
+ * before deciding whether to scan it. The gradient at each sample is the sum of the absolute
+ * differences to the pixels to its right and below, which a blurred frame smears out.
+ */
+void kikCodeMeasureFrameQuality(const uint8_t *frame, size_t stride, int width, int height, FrameQuality *out_quality);
+
+/**
+ * @returns The number of bits that differ between two frame hashes
+ */
+int kikCodeFrameHashDistance(uint64_t a, uint64_t b);
+
+#endif // __FRAME_QUALITY_H__
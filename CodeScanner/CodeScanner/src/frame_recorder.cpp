@@ -0,0 +1,57 @@
+#include "frame_recorder.h"
+
+#include <atomic>
+#include <mutex>
+
+using namespace std;
+
+static atomic<bool> recording(false);
+static mutex recorder_mutex;
+static shared_ptr<FrameArchiveWriter> recorder;
+
+FrameRecorder::FrameRecorder(const uint8_t *plane, unsigned int width, unsigned int height, unsigned int row_stride, unsigned int device_quality, uint64_t timestamp)
+: offset_(0)
+{
+    if (!recording.load(memory_order_relaxed)) {
+        return;
+    }
+
+    {
+        lock_guard<mutex> lock(recorder_mutex);
+        writer_ = recorder;
+    }
+
+    // the frame is written before it's scanned, so that a scan that crashes is still recorded
+    if (writer_ && frameArchiveAppend(writer_.get(), plane, width, height, row_stride, device_quality, timestamp, nullptr, &offset_) != FRAME_ARCHIVE_RESULT_SUCCESS) {
+        writer_.reset();
+    }
+}
+
+void FrameRecorder::setResults(const KikCodeScanResult *results, size_t count)
+{
+    if (writer_ && count > 0) {
+        frameArchiveSetPayload(writer_.get(), offset_, results[0].data);
+    }
+}
+
+int kikCodeRecordStart(const char *path)
+{
+    FrameArchiveWriter *writer = frameArchiveCreate(path);
+
+    if (!writer) {
+        return KIK_CODE_SCAN_RESULT_ERROR;
+    }
+
+    lock_guard<mutex> lock(recorder_mutex);
+    recorder = shared_ptr<FrameArchiveWriter>(writer, frameArchiveClose);
+    recording.store(true, memory_order_relaxed);
+
+    return KIK_CODE_SCAN_RESULT_SUCCESS;
+}
+
+void kikCodeRecordStop(void)
+{
+    lock_guard<mutex> lock(recorder_mutex);
+    recording.store(false, memory_order_relaxed);
+    recorder.reset();
+}
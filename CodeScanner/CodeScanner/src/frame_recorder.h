@@ -0,0 +1,31 @@
+#ifndef __FRAME_RECORDER_H__
+#define __FRAME_RECORDER_H__
+
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "frame_archive.h"
+#include "kikcode_scan.h"
+
+/**
+ * Appends the frame it's constructed with to the archive being recorded to, see
+ * kikCodeRecordStart, and gives it the data of the first code its scan found. While nothing is
+ * being recorded, constructing one costs a flag check and the rest does nothing.
+ */
+class FrameRecorder {
+public:
+    FrameRecorder(const uint8_t *plane, unsigned int width, unsigned int height, unsigned int row_stride, unsigned int device_quality, uint64_t timestamp);
+
+    void setResults(const KikCodeScanResult *results, size_t count);
+
+private:
+    // held so that a recording stopped meanwhile isn't closed under the frame
+    std::shared_ptr<FrameArchiveWriter> writer_;
+    uint64_t offset_;
+
+    FrameRecorder(const FrameRecorder &) = delete;
+    FrameRecorder &operator=(const FrameRecorder &) = delete;
+};
+
+#endif // __FRAME_RECORDER_H__
@@ -3,4 +3,22 @@
 
 #define KIK_CODE_TOTAL_BYTE_COUNT 35
 
+// layout of a Kik code in object space, where it is KIK_CODE_OBJECT_SIZE across and its rings are
+// spaced in multiples of KIK_CODE_MODIFIER. The scanner maps this layout onto the scene and the
+// renderer draws it, so the two always agree on where each module is
+#define KIK_CODE_OBJECT_SIZE 390.0
+#define KIK_CODE_MODIFIER 42.0
+
+// diameter of the centre circle as a fraction of the code's size
+#define KIK_CODE_INNER_RING_RATIO 0.32
+
+// radius of the finder ring in modifiers, and its modules, of which the bits set in
+// KIK_CODE_FINDER_BYTES are drawn. Every code has the same finder ring
+#define KIK_CODE_FINDER_RADIUS 2.025
+#define KIK_CODE_FINDER_MODULE_COUNT 32
+#define KIK_CODE_FINDER_BYTES {0xB2, 0xCB, 0x25, 0xC6}
+
+// data ring r, from 1, has 32 + 8r modules on a circle of (0.4 (r + 1) + 1.8) modifiers
+#define KIK_CODE_DATA_RING_COUNT 5
+
 #endif // __KIKCODE_CONSTANTS_H__
@@ -3,15 +3,9 @@
 #include <cstring>
 
 #include "kikcode_encoding.h"
-
-#include "ReedSolomonEncoder.h"
-#include "ReedSolomonDecoder.h"
-#include "ReedSolomonException.h"
-#include "IllegalArgumentException.h"
-#include "IllegalStateException.h"
+#include "kikcode_reed_solomon.h"
 
 using namespace std;
-using namespace zxing;
 
 size_t KikCode::writeByte(unsigned char *out_data, size_t offset, unsigned char value)
 {
@@ -118,48 +112,100 @@ uint8_t KikCode::extra() const
     return extra_;
 }
 
-KikCode *KikCode::parse(const uint8_t *data)
+/**
+ * Picks the bytes to erase: the least confident ones below KIK_CODE_ERASURE_CONFIDENCE, at most
+ * KIK_CODE_MAX_ERASURES of them, as indices into the reordered data section.
+ *
+ * @returns The number of erasures
+ */
+static unsigned int findErasures(const uint8_t *confidence, uint8_t *out_erasures)
 {
-    uint8_t data_section[KIK_CODE_ALL_BYTE_COUNT];
+    bool taken[KIK_CODE_ALL_BYTE_COUNT] = {false};
+    unsigned int count = 0;
+
+    while (count < KIK_CODE_MAX_ERASURES) {
+        int least = -1;
+
+        for (int i = 0; i < KIK_CODE_ALL_BYTE_COUNT; ++i) {
+            if (!taken[i] && confidence[i] < KIK_CODE_ERASURE_CONFIDENCE && (least < 0 || confidence[i] < confidence[least])) {
+                least = i;
+            }
+        }
+
+        if (least < 0) {
+            break;
+        }
+
+        taken[least] = true;
+
+        // the ECC comes first in the scanned data but last in the data section
+        if (least < KIK_CODE_ECC_BYTE_COUNT) {
+            out_erasures[count++] = least + KIK_CODE_DATA_BYTE_COUNT;
+        }
+        else {
+            out_erasures[count++] = least - KIK_CODE_ECC_BYTE_COUNT;
+        }
+    }
 
-    ArrayRef<int> codeword_ints(KIK_CODE_ALL_BYTE_COUNT);
+    return count;
+}
 
-    unsigned char reordered_data[KIK_CODE_ALL_BYTE_COUNT];
+KikCode *KikCode::parse(const uint8_t *data)
+{
+    return parse(data, nullptr);
+}
+
+bool KikCode::correct(uint8_t *data, const uint8_t *confidence)
+{
+    uint8_t codeword[KIK_CODE_ALL_BYTE_COUNT];
 
     // put the ECC back on the end
     for (size_t i = 0; i < KIK_CODE_ECC_BYTE_COUNT; ++i) {
-        reordered_data[i + KIK_CODE_DATA_BYTE_COUNT] = data[i];
+        codeword[i + KIK_CODE_DATA_BYTE_COUNT] = data[i];
     }
 
     for (size_t i = KIK_CODE_ECC_BYTE_COUNT; i < KIK_CODE_ALL_BYTE_COUNT; ++i) {
-        reordered_data[i - KIK_CODE_ECC_BYTE_COUNT] = data[i];
+        codeword[i - KIK_CODE_ECC_BYTE_COUNT] = data[i];
     }
 
-    for (size_t i = 0; i < KIK_CODE_ALL_BYTE_COUNT; ++i) {
-        codeword_ints[i] = reordered_data[i] & 0xff;
-    }
+    if (kikCodeRSDecode(codeword, nullptr, 0, nullptr) != KIK_CODE_RS_SUCCESS) {
+        if (!confidence) {
+            return false;
+        }
 
-    ReedSolomonDecoder rs_decoder(GenericGF::QR_CODE_FIELD_256);
+        // the failed decode leaves the codeword untouched, so it can simply be retried
+        uint8_t erasures[KIK_CODE_MAX_ERASURES];
+        unsigned int erasure_count = findErasures(confidence, erasures);
 
-    try {
-        rs_decoder.decode(codeword_ints, KIK_CODE_ECC_BYTE_COUNT-1);
+        if (erasure_count == 0 || kikCodeRSDecode(codeword, erasures, erasure_count, nullptr) != KIK_CODE_RS_SUCCESS) {
+            return false;
+        }
     }
-    catch (ReedSolomonException const &ignored) {
-        (void)ignored;
-        return nullptr;
+
+    // and back to the scanned order
+    for (size_t i = 0; i < KIK_CODE_ECC_BYTE_COUNT; ++i) {
+        data[i] = codeword[i + KIK_CODE_DATA_BYTE_COUNT];
     }
-    catch (IllegalArgumentException const &ignored) {
-        (void)ignored;
-        return nullptr;
+
+    for (size_t i = KIK_CODE_ECC_BYTE_COUNT; i < KIK_CODE_ALL_BYTE_COUNT; ++i) {
+        data[i] = codeword[i - KIK_CODE_ECC_BYTE_COUNT];
     }
-    catch (IllegalStateException const &ignored) {
-        (void)ignored;
+
+    return true;
+}
+
+KikCode *KikCode::parse(const uint8_t *data, const uint8_t *confidence)
+{
+    uint8_t corrected[KIK_CODE_ALL_BYTE_COUNT];
+
+    memcpy(corrected, data, KIK_CODE_ALL_BYTE_COUNT);
+
+    if (!correct(corrected, confidence)) {
         return nullptr;
     }
 
-    for (size_t i = 0; i < KIK_CODE_ALL_BYTE_COUNT; ++i) {
-        data_section[i] = (uint8_t)codeword_ints[i];
-    }
+    // the data section follows the ECC
+    uint8_t *data_section = corrected + KIK_CODE_ECC_BYTE_COUNT;
 
     // type
     uint8_t type = data_section[0] & 0x1f; // lower 5 bits
@@ -202,38 +248,20 @@ void KikCode::encode(uint8_t *out_data)
     // extra
     out_data[1] |= ((uint32_t)extra() << 3) & 0xf8; // upper 5 bits
 
-    ArrayRef<int> codeword_ints(KIK_CODE_ALL_BYTE_COUNT);
+    uint8_t codeword[KIK_CODE_ALL_BYTE_COUNT];
 
-    for (size_t i = 0; i < KIK_CODE_DATA_BYTE_COUNT; ++i) {
-        codeword_ints[i] = out_data[i] & 0xff;
-    }
+    memcpy(codeword, out_data, KIK_CODE_DATA_BYTE_COUNT);
 
     // apply error correction
-    ReedSolomonEncoder rs_encoder(*GenericGF::QR_CODE_FIELD_256);
-
-    try {
-        rs_encoder.encode(codeword_ints, KIK_CODE_ECC_BYTE_COUNT - 1);
-    }
-    catch (ReedSolomonException const &ignored) {
-        (void)ignored;
-        throw invalid_argument("Error correction error");
-    }
-    catch (IllegalArgumentException const &ignored) {
-        (void)ignored;
-        throw invalid_argument("Error correction error");
-    }
-    catch (IllegalStateException const &ignored) {
-        (void)ignored;
-        throw invalid_argument("Error correction error");
-    }
+    kikCodeRSEncode(codeword);
 
     // move the ECC to the front of the data
     for (size_t i = 0; i < KIK_CODE_ECC_BYTE_COUNT; ++i) {
-        out_data[i] = (uint8_t)codeword_ints[i + KIK_CODE_DATA_BYTE_COUNT];
+        out_data[i] = codeword[i + KIK_CODE_DATA_BYTE_COUNT];
     }
 
     for (size_t i = 0; i < KIK_CODE_DATA_BYTE_COUNT; ++i) {
-        out_data[i + KIK_CODE_ECC_BYTE_COUNT] = (uint8_t)codeword_ints[i];
+        out_data[i + KIK_CODE_ECC_BYTE_COUNT] = codeword[i];
     }
 }
 
@@ -10,6 +10,13 @@
 #define KIK_CODE_ECC_BYTE_COUNT      (104/8)
 #define KIK_CODE_PAYLOAD_BYTE_COUNT  (160/8)
 
+// bytes read with less confidence than this (in grey levels) may be treated as erasures
+#define KIK_CODE_ERASURE_CONFIDENCE  24
+
+// every erasure halves what an undetected error costs the code, but also leaves less redundancy
+// to reject a wrong decode with, so only a few are ever used
+#define KIK_CODE_MAX_ERASURES        6
+
 class KikCode {
 public:
     enum class Colour {
@@ -60,6 +67,21 @@ public:
 
     static KikCode *parse(const uint8_t *data);
 
+    /**
+     * Like parse(data), but if the code has too many errors to be corrected as is, the least
+     * confidently read bytes are retried as erasures. confidence holds one value per byte of
+     * data, as reported by the scanner.
+     */
+    static KikCode *parse(const uint8_t *data, const uint8_t *confidence);
+
+    /**
+     * Runs error correction over scanned data in place, without decoding it. confidence may be
+     * null, see parse(data, confidence).
+     *
+     * @returns True iff data is (now) a valid code
+     */
+    static bool correct(uint8_t *data, const uint8_t *confidence);
+
     virtual void encode(uint8_t *out_data);
 };
 
@@ -0,0 +1,362 @@
+#include <string.h>
+
+#include "kikcode_reed_solomon.h"
+
+#define GF_PRIMITIVE 0x11d
+#define GF_ORDER     255
+
+// every erasure uses up one syndrome and every error two, so at most 12 symbols are ever located
+#define MAX_ERRATA   KIK_CODE_RS_SYNDROME_COUNT
+
+// the codeword is the polynomial codeword[0] x^34 + ... + codeword[34], so the symbol at index i
+// belongs to the power (KIK_CODE_RS_SYMBOL_COUNT - 1 - i)
+
+typedef struct {
+    // doubled so that exp[log(a) + log(b)] never has to wrap
+    uint8_t exp[2 * GF_ORDER];
+    uint8_t log[GF_ORDER + 1];
+} GaloisField;
+
+typedef struct {
+    // highest degree first, generator[0] is always 1
+    uint8_t coefficients[KIK_CODE_RS_PARITY_COUNT + 1];
+} Generator;
+
+static constexpr GaloisField makeField()
+{
+    GaloisField field = {};
+    int x = 1;
+
+    for (int i = 0; i < GF_ORDER; ++i) {
+        field.exp[i] = (uint8_t)x;
+        field.exp[i + GF_ORDER] = (uint8_t)x;
+        field.log[x] = (uint8_t)i;
+
+        x <<= 1;
+
+        if (x & 0x100) {
+            x ^= GF_PRIMITIVE;
+        }
+    }
+
+    return field;
+}
+
+static constexpr GaloisField field = makeField();
+
+static constexpr uint8_t gfMultiply(uint8_t a, uint8_t b)
+{
+    return (a == 0 || b == 0) ? 0 : field.exp[field.log[a] + field.log[b]];
+}
+
+static constexpr uint8_t gfDivide(uint8_t a, uint8_t b)
+{
+    return a == 0 ? 0 : field.exp[field.log[a] + GF_ORDER - field.log[b]];
+}
+
+// alpha^power for any power in [0, 2 * GF_ORDER)
+static constexpr uint8_t gfPower(int power)
+{
+    return field.exp[power % GF_ORDER];
+}
+
+/**
+ * (x + 1)(x + alpha^0)(x + alpha^1)...(x + alpha^11)
+ */
+static constexpr Generator makeGenerator()
+{
+    Generator generator = {};
+    generator.coefficients[0] = 1;
+
+    for (int i = 0; i < KIK_CODE_RS_PARITY_COUNT; ++i) {
+        uint8_t root = i == 0 ? 1 : gfPower(i - 1);
+
+        // multiply the i+1 coefficients so far by (x + root)
+        for (int j = i + 1; j > 0; --j) {
+            generator.coefficients[j] ^= gfMultiply(generator.coefficients[j - 1], root);
+        }
+    }
+
+    return generator;
+}
+
+static constexpr Generator generator = makeGenerator();
+
+typedef struct {
+    // log(alpha^(i * p)) = i * p mod 255 for the symbol at power p and syndrome i
+    uint8_t logs[KIK_CODE_RS_SYMBOL_COUNT][KIK_CODE_RS_SYNDROME_COUNT];
+} SyndromePowers;
+
+static constexpr SyndromePowers makeSyndromePowers()
+{
+    SyndromePowers powers = {};
+
+    for (int p = 0; p < KIK_CODE_RS_SYMBOL_COUNT; ++p) {
+        for (int i = 0; i < KIK_CODE_RS_SYNDROME_COUNT; ++i) {
+            powers.logs[p][i] = (uint8_t)(i * p % GF_ORDER);
+        }
+    }
+
+    return powers;
+}
+
+static constexpr SyndromePowers syndrome_powers = makeSyndromePowers();
+
+void kikCodeRSEncode(uint8_t *codeword)
+{
+    uint8_t *parity = codeword + KIK_CODE_RS_DATA_COUNT;
+
+    memset(parity, 0, KIK_CODE_RS_PARITY_COUNT);
+
+    // the parity is the remainder of data * x^13 divided by the generator, computed with the
+    // usual shift register
+    for (int i = 0; i < KIK_CODE_RS_DATA_COUNT; ++i) {
+        uint8_t feedback = codeword[i] ^ parity[0];
+
+        memmove(parity, parity + 1, KIK_CODE_RS_PARITY_COUNT - 1);
+        parity[KIK_CODE_RS_PARITY_COUNT - 1] = 0;
+
+        if (feedback != 0) {
+            for (int j = 0; j < KIK_CODE_RS_PARITY_COUNT; ++j) {
+                parity[j] ^= gfMultiply(feedback, generator.coefficients[j + 1]);
+            }
+        }
+    }
+}
+
+/**
+ * S_i = codeword(alpha^i)
+ *
+ * @returns True iff any syndrome is non-zero, i.e. the codeword has errors
+ */
+static bool computeSyndromes(const uint8_t *codeword, uint8_t *out_syndromes)
+{
+    // accumulated locally, writing through out_syndromes would alias codeword
+    uint8_t syndromes[KIK_CODE_RS_SYNDROME_COUNT] = {0};
+
+    // each non-zero symbol c at power p adds c * alpha^(i * p) to S_i, which is a single lookup
+    // in the log domain
+    for (int j = 0; j < KIK_CODE_RS_SYMBOL_COUNT; ++j) {
+        if (codeword[j] == 0) {
+            continue;
+        }
+
+        const uint8_t *logs = syndrome_powers.logs[KIK_CODE_RS_SYMBOL_COUNT - 1 - j];
+        int log = field.log[codeword[j]];
+
+        for (int i = 0; i < KIK_CODE_RS_SYNDROME_COUNT; ++i) {
+            syndromes[i] ^= field.exp[log + logs[i]];
+        }
+    }
+
+    uint8_t any = 0;
+
+    for (int i = 0; i < KIK_CODE_RS_SYNDROME_COUNT; ++i) {
+        out_syndromes[i] = syndromes[i];
+        any |= syndromes[i];
+    }
+
+    return any != 0;
+}
+
+/**
+ * Berlekamp-Massey, started from the erasure locator so that the result locates the erasures as
+ * well as the errors: finds the shortest errata locator polynomial (lowest degree first) that
+ * generates the syndromes.
+ *
+ * @returns The degree of the locator, i.e. the number of erasures plus the number of errors
+ */
+static int findErrataLocator(const uint8_t *syndromes, const uint8_t *erasure_locator, int erasure_count, uint8_t *out_locator)
+{
+    uint8_t previous[KIK_CODE_RS_SYNDROME_COUNT + 1];
+    uint8_t scratch[KIK_CODE_RS_SYNDROME_COUNT + 1];
+
+    memcpy(out_locator, erasure_locator, KIK_CODE_RS_SYNDROME_COUNT + 1);
+    memcpy(previous, erasure_locator, KIK_CODE_RS_SYNDROME_COUNT + 1);
+
+    int length = erasure_count;
+    int shift = 1;
+    uint8_t previous_discrepancy = 1;
+
+    for (int n = erasure_count; n < KIK_CODE_RS_SYNDROME_COUNT; ++n) {
+        uint8_t discrepancy = 0;
+
+        for (int i = 0; i <= n; ++i) {
+            discrepancy ^= gfMultiply(out_locator[i], syndromes[n - i]);
+        }
+
+        if (discrepancy == 0) {
+            ++shift;
+            continue;
+        }
+
+        uint8_t factor = gfDivide(discrepancy, previous_discrepancy);
+
+        if (2 * length <= n + erasure_count) {
+            memcpy(scratch, out_locator, sizeof(scratch));
+
+            for (int i = 0; i + shift <= KIK_CODE_RS_SYNDROME_COUNT; ++i) {
+                out_locator[i + shift] ^= gfMultiply(factor, previous[i]);
+            }
+
+            memcpy(previous, scratch, sizeof(previous));
+
+            length = n + 1 + erasure_count - length;
+            previous_discrepancy = discrepancy;
+            shift = 1;
+        }
+        else {
+            for (int i = 0; i + shift <= KIK_CODE_RS_SYNDROME_COUNT; ++i) {
+                out_locator[i + shift] ^= gfMultiply(factor, previous[i]);
+            }
+
+            ++shift;
+        }
+    }
+
+    return length;
+}
+
+/**
+ * Evaluates a polynomial stored lowest degree first.
+ */
+static uint8_t evaluate(const uint8_t *polynomial, int degree, uint8_t x)
+{
+    uint8_t value = 0;
+
+    for (int i = degree; i >= 0; --i) {
+        value = gfMultiply(value, x) ^ polynomial[i];
+    }
+
+    return value;
+}
+
+int kikCodeRSDecode(uint8_t *codeword, const uint8_t *erasures, unsigned int erasure_count, unsigned int *out_corrected)
+{
+    uint8_t syndromes[KIK_CODE_RS_SYNDROME_COUNT];
+
+    if (out_corrected) {
+        *out_corrected = 0;
+    }
+
+    if (erasure_count > KIK_CODE_RS_SYNDROME_COUNT) {
+        return KIK_CODE_RS_UNCORRECTABLE;
+    }
+
+    if (!computeSyndromes(codeword, syndromes)) {
+        return KIK_CODE_RS_SUCCESS;
+    }
+
+    // the erasure locator is the product of (1 + X x) over the erased symbols, X = alpha^p
+    uint8_t erasure_locator[KIK_CODE_RS_SYNDROME_COUNT + 1] = {1};
+
+    for (unsigned int i = 0; i < erasure_count; ++i) {
+        if (erasures[i] >= KIK_CODE_RS_SYMBOL_COUNT) {
+            return KIK_CODE_RS_UNCORRECTABLE;
+        }
+
+        uint8_t x = gfPower(KIK_CODE_RS_SYMBOL_COUNT - 1 - erasures[i]);
+
+        for (unsigned int j = i + 1; j > 0; --j) {
+            erasure_locator[j] ^= gfMultiply(erasure_locator[j - 1], x);
+        }
+    }
+
+    uint8_t locator[KIK_CODE_RS_SYNDROME_COUNT + 1];
+    int errata_count = findErrataLocator(syndromes, erasure_locator, erasure_count, locator);
+
+    // 2 * errors + erasures must fit in the syndromes
+    if (2 * errata_count - (int)erasure_count > KIK_CODE_RS_SYNDROME_COUNT) {
+        return KIK_CODE_RS_UNCORRECTABLE;
+    }
+
+    // Chien search: an error at power p is a root of the locator at alpha^-p. Only the 35 powers
+    // the codeword actually has are searched, so roots outside of it count as a failure. Term k of
+    // the locator is kept in the log domain and stepped by alpha^-k from one power to the next
+    int positions[MAX_ERRATA];
+    int found = 0;
+
+    int terms[MAX_ERRATA + 1];
+
+    for (int k = 1; k <= errata_count; ++k) {
+        terms[k] = locator[k] == 0 ? -1 : field.log[locator[k]];
+    }
+
+    for (int power = 0; power < KIK_CODE_RS_SYMBOL_COUNT; ++power) {
+        uint8_t value = locator[0];
+
+        for (int k = 1; k <= errata_count; ++k) {
+            if (terms[k] < 0) {
+                continue;
+            }
+
+            value ^= field.exp[terms[k]];
+
+            terms[k] -= k;
+
+            if (terms[k] < 0) {
+                terms[k] += GF_ORDER;
+            }
+        }
+
+        if (value == 0) {
+            if (found == errata_count) {
+                return KIK_CODE_RS_UNCORRECTABLE;
+            }
+
+            positions[found++] = power;
+        }
+    }
+
+    if (found != errata_count) {
+        return KIK_CODE_RS_UNCORRECTABLE;
+    }
+
+    // Forney: the errata evaluator is S(x) * locator(x) mod x^12, and with a first consecutive
+    // root of 1 the magnitude at X = alpha^p is X * evaluator(X^-1) / locator'(X^-1)
+    uint8_t evaluator[KIK_CODE_RS_SYNDROME_COUNT] = {0};
+
+    for (int i = 0; i < KIK_CODE_RS_SYNDROME_COUNT; ++i) {
+        for (int j = 0; j <= errata_count && j <= i; ++j) {
+            evaluator[i] ^= gfMultiply(syndromes[i - j], locator[j]);
+        }
+    }
+
+    // the formal derivative in characteristic 2 only keeps the odd terms
+    uint8_t derivative[MAX_ERRATA] = {0};
+
+    for (int i = 1; i <= errata_count; i += 2) {
+        derivative[i - 1] = locator[i];
+    }
+
+    uint8_t magnitudes[MAX_ERRATA];
+
+    for (int i = 0; i < found; ++i) {
+        uint8_t x = gfPower(positions[i]);
+        uint8_t x_inverse = gfPower(GF_ORDER - positions[i]);
+        uint8_t denominator = evaluate(derivative, errata_count - 1, x_inverse);
+
+        if (denominator == 0) {
+            return KIK_CODE_RS_UNCORRECTABLE;
+        }
+
+        magnitudes[i] = gfMultiply(x, gfDivide(evaluate(evaluator, KIK_CODE_RS_SYNDROME_COUNT - 1, x_inverse), denominator));
+    }
+
+    unsigned int corrected = 0;
+
+    for (int i = 0; i < found; ++i) {
+        codeword[KIK_CODE_RS_SYMBOL_COUNT - 1 - positions[i]] ^= magnitudes[i];
+
+        // an erased symbol may have been read correctly after all
+        if (magnitudes[i] != 0) {
+            ++corrected;
+        }
+    }
+
+    if (out_corrected) {
+        *out_corrected = corrected;
+    }
+
+    return KIK_CODE_RS_SUCCESS;
+}
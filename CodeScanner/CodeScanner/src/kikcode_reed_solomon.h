@@ -0,0 +1,43 @@
+#ifndef __KIKCODE_REED_SOLOMON_H__
+#define __KIKCODE_REED_SOLOMON_H__
+
+#include <stdint.h>
+
+#include "kikcode_constants.h"
+
+// Reed-Solomon over GF(256) (primitive polynomial 0x11d) as laid out in a Kik code: 35 symbols,
+// 22 of data followed by 13 of parity.
+//
+// The parity is the remainder modulo (x + 1)^2 (x + a)(x + a^2)...(x + a^11). The repeated (x + 1)
+// is a quirk of the encoder the first codes were printed with and has to be kept, decoding only
+// relies on the 12 consecutive roots 1, a, ..., a^11 and so corrects up to 6 symbol errors, or up
+// to 12 erasures
+#define KIK_CODE_RS_SYMBOL_COUNT    KIK_CODE_TOTAL_BYTE_COUNT
+#define KIK_CODE_RS_PARITY_COUNT    13
+#define KIK_CODE_RS_DATA_COUNT      (KIK_CODE_RS_SYMBOL_COUNT - KIK_CODE_RS_PARITY_COUNT)
+#define KIK_CODE_RS_SYNDROME_COUNT  12
+
+#define KIK_CODE_RS_SUCCESS         0
+#define KIK_CODE_RS_UNCORRECTABLE   1
+
+/**
+ * Computes the parity symbols for the data in codeword[0, KIK_CODE_RS_DATA_COUNT) and writes them
+ * to the rest of the codeword.
+ */
+void kikCodeRSEncode(uint8_t *codeword);
+
+/**
+ * Corrects codeword in place. The codeword is left untouched if it can't be corrected.
+ *
+ * erasures lists the indices of erasure_count symbols that are known to be unreliable. Their
+ * positions don't have to be found, so each one costs half as much of the code's redundancy as an
+ * error in an unknown position: the codeword can be corrected as long as
+ * 2 * errors + erasures <= KIK_CODE_RS_SYNDROME_COUNT. erasures may be null if erasure_count is 0.
+ *
+ * out_corrected, if not null, receives the number of symbols that were changed.
+ *
+ * @returns KIK_CODE_RS_SUCCESS or KIK_CODE_RS_UNCORRECTABLE
+ */
+int kikCodeRSDecode(uint8_t *codeword, const uint8_t *erasures, unsigned int erasure_count, unsigned int *out_corrected);
+
+#endif // __KIKCODE_REED_SOLOMON_H__
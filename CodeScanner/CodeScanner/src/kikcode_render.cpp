@@ -0,0 +1,438 @@
+#include "kikcode_render.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define RENDER_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define RENDER_SSE2 1
+#endif
+
+// radius of a module's dot in modifiers, four fifths of the spacing of the data rings
+#define RENDER_DOT_RADIUS 0.16
+
+#define RENDER_RING_COUNT   (KIK_CODE_DATA_RING_COUNT + 1)
+#define RENDER_MODULE_COUNT (KIK_CODE_FINDER_MODULE_COUNT + 280)
+
+// pixels of a row whose polar coordinates are worked out at a time
+#define RENDER_SPAN 64
+
+// further from a dot than any pixel it could cover
+#define RENDER_FAR 1e9f
+
+// atan(a) for a in [0, 1] as a + a^3 (C1 + a^2 (C2 + a^2 C3)), to within about 1e-5 radians, a
+// fraction of a pixel at any size a code is drawn at
+#define RENDER_ATAN_C1 -0.327622764f
+#define RENDER_ATAN_C2  0.15931422f
+#define RENDER_ATAN_C3 -0.0464964749f
+
+static const unsigned char render_finder_bytes[] = KIK_CODE_FINDER_BYTES;
+
+typedef struct {
+    float radius;
+    int module_count;
+    int first_module;
+} RenderRing;
+
+typedef struct {
+    float center_x;
+    float center_y;
+
+    // added to a pixel's angle from the centre to make it the angle clockwise from the top of the
+    // rotated code, within half a turn either way
+    float turn;
+
+    float badge_radius;
+    float dot_radius;
+    float outer_radius;
+
+    // pixels nearer the centre than this are nearest the finder ring, the others one of the data
+    // rings, which are ring_spacing apart from data_radius outwards
+    float finder_split;
+    float data_radius;
+    float ring_spacing;
+
+    RenderRing rings[RENDER_RING_COUNT];
+
+    // every module of every ring, finder ring first: 1 if it's set, 0 if not, and where its dot
+    // is relative to the centre
+    float modules[RENDER_MODULE_COUNT];
+    float module_x[RENDER_MODULE_COUNT];
+    float module_y[RENDER_MODULE_COUNT];
+} RenderLayout;
+
+/**
+ * Polar coordinates of a span of pixels in a row, relative to the ring each is nearest.
+ */
+typedef struct {
+    // how much of the pixel the centre circle covers
+    float badge[RENDER_SPAN];
+
+    // distance from the circle the ring's dots are centred on
+    float radial[RENDER_SPAN];
+
+    // in modules clockwise round the ring from its first, less than a turn back and no more than a
+    // turn on
+    float position[RENDER_SPAN];
+
+    int ring[RENDER_SPAN];
+} RenderPolar;
+
+// fminf and fmaxf handle NaN, which keeps them from being the single instruction these are
+static inline float minFloat(float a, float b)
+{
+    return a < b ? a : b;
+}
+
+static inline float maxFloat(float a, float b)
+{
+    return a > b ? a : b;
+}
+
+static inline float clampCoverage(float coverage)
+{
+    return minFloat(maxFloat(coverage, 0), 1);
+}
+
+/**
+ * floorf, which isn't an instruction on every target this is built for
+ */
+static inline int floorInt(float value)
+{
+    int truncated = (int)value;
+
+    return truncated - (value < truncated ? 1 : 0);
+}
+
+static inline float fastAtan2(float y, float x)
+{
+    float abs_x = fabsf(x);
+    float abs_y = fabsf(y);
+    float high = maxFloat(abs_x, abs_y);
+    float low = minFloat(abs_x, abs_y);
+
+    float a = low / maxFloat(high, 1e-30f);
+    float s = a * a;
+    float angle = ((RENDER_ATAN_C3 * s + RENDER_ATAN_C2) * s + RENDER_ATAN_C1) * s * a + a;
+
+    angle = abs_y > abs_x ? (float)M_PI_2 - angle : angle;
+    angle = x < 0 ? (float)M_PI - angle : angle;
+
+    return y < 0 ? -angle : angle;
+}
+
+static void buildLayout(const unsigned char *data, double center_x, double center_y, double size, double rotation, RenderLayout *out_layout)
+{
+    // pixels per object-space unit
+    float unit = (float)(size / KIK_CODE_OBJECT_SIZE);
+    float modifier = (float)KIK_CODE_MODIFIER * unit;
+
+    // rotation is brought within [-pi / 2, 3 pi / 2) first
+    rotation -= 2 * M_PI * floor((rotation + M_PI / 2) / (2 * M_PI));
+
+    out_layout->center_x = (float)center_x;
+    out_layout->center_y = (float)center_y;
+    out_layout->turn = (float)(M_PI / 2 - rotation);
+    out_layout->badge_radius = (float)(size * KIK_CODE_INNER_RING_RATIO / 2);
+    out_layout->dot_radius = modifier * (float)RENDER_DOT_RADIUS;
+
+    int first_module = 0;
+
+    for (int r = 0; r < RENDER_RING_COUNT; ++r) {
+        RenderRing &ring = out_layout->rings[r];
+
+        ring.radius = r == 0 ? modifier * (float)KIK_CODE_FINDER_RADIUS : modifier * ((r + 1) * 0.4f + 1.8f);
+        ring.module_count = r == 0 ? KIK_CODE_FINDER_MODULE_COUNT : 32 + 8 * r;
+        ring.first_module = first_module;
+
+        // module j of a ring is j / n of the way round clockwise from the top, as the scanner
+        // reads it
+        for (int j = 0; j < ring.module_count; ++j) {
+            int module = first_module + j;
+            double angle = j * M_PI / ring.module_count * 2 - M_PI / 2 + rotation;
+            bool set;
+
+            if (r == 0) {
+                set = (render_finder_bytes[j / 8] >> (j % 8)) & 0x1;
+            }
+            else {
+                int bit = module - KIK_CODE_FINDER_MODULE_COUNT;
+                set = (data[bit / 8] >> (bit % 8)) & 0x1;
+            }
+
+            out_layout->modules[module] = set ? 1 : 0;
+            out_layout->module_x[module] = (float)(ring.radius * cos(angle));
+            out_layout->module_y[module] = (float)(ring.radius * sin(angle));
+        }
+
+        first_module += ring.module_count;
+    }
+
+    out_layout->finder_split = (out_layout->rings[0].radius + out_layout->rings[1].radius) / 2;
+    out_layout->data_radius = out_layout->rings[1].radius;
+    out_layout->ring_spacing = out_layout->rings[2].radius - out_layout->rings[1].radius;
+    out_layout->outer_radius = out_layout->rings[RENDER_RING_COUNT - 1].radius + out_layout->dot_radius + 1;
+}
+
+static inline void polarPixel(const RenderLayout &layout, float x, float y, RenderPolar *out_polar, int i)
+{
+    float rho = sqrtf(x * x + y * y);
+
+    // the rings are further apart than a dot is wide, so only the nearest can reach the pixel
+    float step = maxFloat((rho - layout.data_radius) / layout.ring_spacing + 0.5f, 0);
+    float data_ring = minFloat((float)(int)step, KIK_CODE_DATA_RING_COUNT - 1);
+    bool finder = rho < layout.finder_split;
+
+    float radius = finder ? layout.rings[0].radius : layout.data_radius + data_ring * layout.ring_spacing;
+    float module_count = finder ? KIK_CODE_FINDER_MODULE_COUNT : 40 + 8 * data_ring;
+
+    out_polar->badge[i] = clampCoverage(layout.badge_radius - rho + 0.5f);
+    out_polar->radial[i] = fabsf(rho - radius);
+    out_polar->position[i] = (fastAtan2(y, x) + layout.turn) * module_count * (float)(0.5 / M_PI);
+    out_polar->ring[i] = finder ? 0 : (int)data_ring + 1;
+}
+
+/**
+ * Works out the polar coordinates of count pixels of a row, from the one whose centre is (x, y)
+ * from the code's centre rightwards, four at a time where there's SIMD.
+ */
+static void polarSpan(const RenderLayout &layout, float x, float y, int count, RenderPolar *out_polar)
+{
+    int i = 0;
+
+#if RENDER_NEON
+    const float lane_offsets[4] = {0, 1, 2, 3};
+    const float32x4_t lanes = vld1q_f32(lane_offsets);
+    const float32x4_t y_squared = vdupq_n_f32(y * y);
+    const float32x4_t abs_y = vdupq_n_f32(fabsf(y));
+    const float32x4_t zero = vdupq_n_f32(0);
+    const float32x4_t one = vdupq_n_f32(1);
+    const float32x4_t half = vdupq_n_f32(0.5f);
+
+    for (; i + 4 <= count; i += 4) {
+        float32x4_t xs = vaddq_f32(vdupq_n_f32(x + i), lanes);
+        float32x4_t rho = vsqrtq_f32(vmlaq_f32(y_squared, xs, xs));
+
+        float32x4_t step = vdivq_f32(vsubq_f32(rho, vdupq_n_f32(layout.data_radius)), vdupq_n_f32(layout.ring_spacing));
+        step = vmaxq_f32(vaddq_f32(step, half), zero);
+        float32x4_t data_ring = vminq_f32(vcvtq_f32_s32(vcvtq_s32_f32(step)), vdupq_n_f32(KIK_CODE_DATA_RING_COUNT - 1));
+        uint32x4_t finder = vcltq_f32(rho, vdupq_n_f32(layout.finder_split));
+
+        float32x4_t data_radius = vmlaq_f32(vdupq_n_f32(layout.data_radius), data_ring, vdupq_n_f32(layout.ring_spacing));
+        float32x4_t radius = vbslq_f32(finder, vdupq_n_f32(layout.rings[0].radius), data_radius);
+        float32x4_t data_modules = vmlaq_f32(vdupq_n_f32(40), data_ring, vdupq_n_f32(8));
+        float32x4_t module_count = vbslq_f32(finder, vdupq_n_f32(KIK_CODE_FINDER_MODULE_COUNT), data_modules);
+
+        float32x4_t badge = vaddq_f32(vsubq_f32(vdupq_n_f32(layout.badge_radius), rho), half);
+
+        float32x4_t abs_x = vabsq_f32(xs);
+        float32x4_t high = vmaxq_f32(abs_x, abs_y);
+        float32x4_t low = vminq_f32(abs_x, abs_y);
+        float32x4_t a = vdivq_f32(low, vmaxq_f32(high, vdupq_n_f32(1e-30f)));
+        float32x4_t s = vmulq_f32(a, a);
+        float32x4_t angle = vmlaq_f32(vdupq_n_f32(RENDER_ATAN_C2), s, vdupq_n_f32(RENDER_ATAN_C3));
+        angle = vmlaq_f32(vdupq_n_f32(RENDER_ATAN_C1), s, angle);
+        angle = vmlaq_f32(a, vmulq_f32(s, a), angle);
+
+        angle = vbslq_f32(vcgtq_f32(abs_y, abs_x), vsubq_f32(vdupq_n_f32((float)M_PI_2), angle), angle);
+        angle = vbslq_f32(vcltq_f32(xs, zero), vsubq_f32(vdupq_n_f32((float)M_PI), angle), angle);
+        angle = y < 0 ? vnegq_f32(angle) : angle;
+
+        float32x4_t turns = vmulq_f32(module_count, vdupq_n_f32((float)(0.5 / M_PI)));
+        float32x4_t position = vmulq_f32(vaddq_f32(angle, vdupq_n_f32(layout.turn)), turns);
+        float32x4_t ring = vbslq_f32(finder, zero, vaddq_f32(data_ring, one));
+
+        vst1q_f32(out_polar->badge + i, vminq_f32(vmaxq_f32(badge, zero), one));
+        vst1q_f32(out_polar->radial + i, vabsq_f32(vsubq_f32(rho, radius)));
+        vst1q_f32(out_polar->position + i, position);
+        vst1q_s32(out_polar->ring + i, vcvtq_s32_f32(ring));
+    }
+#elif RENDER_SSE2
+    const __m128 lanes = _mm_set_ps(3, 2, 1, 0);
+    const __m128 y_squared = _mm_set1_ps(y * y);
+    const __m128 abs_y = _mm_set1_ps(fabsf(y));
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    const __m128 y_sign = y < 0 ? sign : _mm_setzero_ps();
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1);
+    const __m128 half = _mm_set1_ps(0.5f);
+
+    // SSE2 has no blend, values are selected between with masks instead
+    for (; i + 4 <= count; i += 4) {
+        __m128 xs = _mm_add_ps(_mm_set1_ps(x + i), lanes);
+        __m128 rho = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(xs, xs), y_squared));
+
+        __m128 step = _mm_div_ps(_mm_sub_ps(rho, _mm_set1_ps(layout.data_radius)), _mm_set1_ps(layout.ring_spacing));
+        step = _mm_max_ps(_mm_add_ps(step, half), zero);
+        __m128 data_ring = _mm_min_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(step)), _mm_set1_ps(KIK_CODE_DATA_RING_COUNT - 1));
+        __m128 finder = _mm_cmplt_ps(rho, _mm_set1_ps(layout.finder_split));
+
+        __m128 data_radius = _mm_add_ps(_mm_set1_ps(layout.data_radius), _mm_mul_ps(data_ring, _mm_set1_ps(layout.ring_spacing)));
+        __m128 radius = _mm_or_ps(_mm_and_ps(finder, _mm_set1_ps(layout.rings[0].radius)), _mm_andnot_ps(finder, data_radius));
+        __m128 data_modules = _mm_add_ps(_mm_set1_ps(40), _mm_mul_ps(data_ring, _mm_set1_ps(8)));
+        __m128 module_count = _mm_or_ps(_mm_and_ps(finder, _mm_set1_ps(KIK_CODE_FINDER_MODULE_COUNT)), _mm_andnot_ps(finder, data_modules));
+
+        __m128 badge = _mm_add_ps(_mm_sub_ps(_mm_set1_ps(layout.badge_radius), rho), half);
+
+        __m128 abs_x = _mm_andnot_ps(sign, xs);
+        __m128 high = _mm_max_ps(abs_x, abs_y);
+        __m128 low = _mm_min_ps(abs_x, abs_y);
+        __m128 a = _mm_div_ps(low, _mm_max_ps(high, _mm_set1_ps(1e-30f)));
+        __m128 s = _mm_mul_ps(a, a);
+        __m128 angle = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(RENDER_ATAN_C3), s), _mm_set1_ps(RENDER_ATAN_C2));
+        angle = _mm_add_ps(_mm_mul_ps(angle, s), _mm_set1_ps(RENDER_ATAN_C1));
+        angle = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(angle, s), a), a);
+
+        __m128 steep = _mm_cmpgt_ps(abs_y, abs_x);
+        angle = _mm_or_ps(_mm_and_ps(steep, _mm_sub_ps(_mm_set1_ps((float)M_PI_2), angle)), _mm_andnot_ps(steep, angle));
+        __m128 left = _mm_cmplt_ps(xs, zero);
+        angle = _mm_or_ps(_mm_and_ps(left, _mm_sub_ps(_mm_set1_ps((float)M_PI), angle)), _mm_andnot_ps(left, angle));
+        angle = _mm_xor_ps(angle, y_sign);
+
+        __m128 turns = _mm_mul_ps(module_count, _mm_set1_ps((float)(0.5 / M_PI)));
+        __m128 position = _mm_mul_ps(_mm_add_ps(angle, _mm_set1_ps(layout.turn)), turns);
+        __m128 ring = _mm_andnot_ps(finder, _mm_add_ps(data_ring, one));
+
+        _mm_storeu_ps(out_polar->badge + i, _mm_min_ps(_mm_max_ps(badge, zero), one));
+        _mm_storeu_ps(out_polar->radial + i, _mm_andnot_ps(sign, _mm_sub_ps(rho, radius)));
+        _mm_storeu_ps(out_polar->position + i, position);
+        _mm_storeu_si128((__m128i *)(out_polar->ring + i), _mm_cvttps_epi32(ring));
+    }
+#endif
+
+    for (; i < count; ++i) {
+        polarPixel(layout, x + i, y, out_polar, i);
+    }
+}
+
+/**
+ * Shades count pixels of a row, from the one whose centre is (x, y) from the code's centre.
+ */
+static void shadeSpan(const RenderLayout &layout, unsigned char *out_pixels, float x, float y, int count, float background, float range)
+{
+    RenderPolar polar;
+    polarSpan(layout, x, y, count, &polar);
+
+    float reach = layout.dot_radius + 0.5f;
+
+    for (int i = 0; i < count; ++i) {
+        float covered = polar.badge[i];
+        float radial = polar.radial[i];
+
+        if (radial < reach) {
+            const RenderRing &ring = layout.rings[polar.ring[i]];
+
+            // the pixel lies between two modules of the ring
+            int before = floorInt(polar.position[i]);
+            before += before < 0 ? ring.module_count : 0;
+            before -= before >= ring.module_count ? ring.module_count : 0;
+
+            int after = before + 1 < ring.module_count ? before + 1 : 0;
+
+            before += ring.first_module;
+            after += ring.first_module;
+
+            // neighbouring modules that are both set are joined by an arc, otherwise the pixel is
+            // only covered by the dot of whichever is set. Worked out arithmetically rather than
+            // by branching, which modules are set is as good as random
+            float before_set = layout.modules[before];
+            float after_set = layout.modules[after];
+            int nearest = before_set > 0 ? before : after;
+
+            float dx = x + i - layout.module_x[nearest];
+            float dy = y - layout.module_y[nearest];
+            float distance = sqrtf(dx * dx + dy * dy);
+
+            distance += (1 - before_set) * (1 - after_set) * RENDER_FAR;
+            distance += before_set * after_set * (radial - distance);
+
+            covered = maxFloat(covered, clampCoverage(layout.dot_radius - distance + 0.5f));
+        }
+
+        out_pixels[i] = (unsigned char)(background + range * covered + 0.5f);
+    }
+}
+
+/**
+ * Shades the pixels of a row from start up to end, RENDER_SPAN at a time.
+ */
+static void shadeRow(const RenderLayout &layout, unsigned char *row, long start, long end, float y, float background, float range)
+{
+    for (long x = start; x < end; x += RENDER_SPAN) {
+        int count = (int)(end - x < RENDER_SPAN ? end - x : RENDER_SPAN);
+
+        shadeSpan(layout, row + x, x + 0.5f - layout.center_x, y, count, background, range);
+    }
+}
+
+int kikCodeRender(
+    const unsigned char *data,
+    unsigned char *out_image,
+    unsigned int width,
+    unsigned int height,
+    unsigned int row_stride,
+    double center_x,
+    double center_y,
+    double size,
+    double rotation,
+    unsigned char foreground,
+    unsigned char background)
+{
+    if (!data || !out_image || row_stride < width || !(size > 0)) {
+        return KIK_CODE_RENDER_RESULT_ERROR;
+    }
+
+    RenderLayout layout;
+    buildLayout(data, center_x, center_y, size, rotation, &layout);
+
+    float range = (float)foreground - (float)background;
+
+    // pixels whose centres are this far inside the centre circle are covered completely
+    float solid_radius = layout.badge_radius - 1;
+
+    for (unsigned int y = 0; y < height; ++y) {
+        unsigned char *row = out_image + (size_t)y * row_stride;
+        float dy = y + 0.5f - layout.center_y;
+
+        if (fabsf(dy) >= layout.outer_radius) {
+            memset(row, background, width);
+            continue;
+        }
+
+        // only the pixels within reach of the outermost ring are shaded one by one, and of those
+        // not the ones the centre circle covers, the rest of the row is filled
+        float reach = sqrtf(layout.outer_radius * layout.outer_radius - dy * dy);
+        long start = floorInt(layout.center_x - reach);
+        long end = floorInt(layout.center_x + reach) + 1;
+
+        start = start < 0 ? 0 : (start > (long)width ? (long)width : start);
+        end = end < start ? start : (end > (long)width ? (long)width : end);
+
+        long solid_start = end;
+        long solid_end = end;
+
+        if (fabsf(dy) < solid_radius) {
+            float solid = sqrtf(solid_radius * solid_radius - dy * dy);
+
+            // the pixels from the first whose centre is within solid of the circle's centre
+            // horizontally to the last
+            solid_start = -floorInt(solid + 0.5f - layout.center_x);
+            solid_end = floorInt(layout.center_x + solid - 0.5f) + 1;
+
+            solid_start = solid_start < start ? start : (solid_start > end ? end : solid_start);
+            solid_end = solid_end < solid_start ? solid_start : (solid_end > end ? end : solid_end);
+        }
+
+        memset(row, background, start);
+        memset(row + end, background, width - end);
+        memset(row + solid_start, foreground, solid_end - solid_start);
+
+        shadeRow(layout, row, start, solid_start, dy, background, range);
+        shadeRow(layout, row, solid_end, end, dy, background, range);
+    }
+
+    return KIK_CODE_RENDER_RESULT_SUCCESS;
+}
@@ -0,0 +1,39 @@
+#ifndef __KIKCODE_RENDER_H__
+#define __KIKCODE_RENDER_H__
+
+#include "kikcode_constants.h"
+
+#define KIK_CODE_RENDER_RESULT_SUCCESS 0
+#define KIK_CODE_RENDER_RESULT_ERROR   1
+
+extern "C" {
+    /**
+     * Draws the code whose KIK_CODE_TOTAL_BYTE_COUNT data bytes are data, as kikCodeEncodeRemote
+     * and the other encoders write them, into a greyscale image whose rows are row_stride bytes
+     * apart. The whole width * height image is written, the code in foreground on background,
+     * anti-aliased, and the bytes padding each row are left alone.
+     *
+     * The code is drawn in the same layout the scanner reads it in: the centre circle, the finder
+     * ring and the five data rings, with runs of set modules joined into arcs. size is the code's
+     * extent in pixels, the same measure the scanner reports codes with, and rotation turns it
+     * clockwise, in radians, about (center_x, center_y).
+     *
+     * Codes for the scanner to find are drawn light on dark, foreground brighter than background.
+     *
+     * @returns KIK_CODE_RENDER_RESULT_ERROR if row_stride is less than width or size isn't positive
+     */
+    int kikCodeRender(
+        const unsigned char *data,
+        unsigned char *out_image,
+        unsigned int width,
+        unsigned int height,
+        unsigned int row_stride,
+        double center_x,
+        double center_y,
+        double size,
+        double rotation,
+        unsigned char foreground,
+        unsigned char background);
+}
+
+#endif // __KIKCODE_RENDER_H__
@@ -1,14 +1,155 @@
 #include "kikcode_scan.h"
+#include "async_scanner.h"
+#include "frame_recorder.h"
 #include "scanner.h"
-#include <algorithm>
-#include <opencv2/imgproc.hpp>
+#include "trace.h"
+
+#include <cstring>
+#include <thread>
 
 using namespace cv;
 
-int kikCodeScan(
+struct KikCodeScanContext {
+    KikCodeScanner scanner;
+
+    KikCodeScanContext(unsigned int width, unsigned int height, unsigned int device_quality, bool validate=false)
+    : scanner(width, height, device_quality)
+    {
+        scanner.setValidation(validate);
+    }
+};
+
+KikCodeScanContext *kikCodeScannerCreate(
+    unsigned int width,
+    unsigned int height,
+    unsigned int device_quality)
+{
+    return new KikCodeScanContext(width, height, device_quality);
+}
+
+void kikCodeScannerDestroy(KikCodeScanContext *context)
+{
+    delete context;
+}
+
+void kikCodeScannerSetTracking(
+    KikCodeScanContext *context,
+    int enabled,
+    unsigned int max_misses,
+    double motion_margin)
+{
+    context->scanner.setTracking(enabled != 0, max_misses, motion_margin);
+}
+
+void kikCodeScannerSetWorkerThreads(
+    KikCodeScanContext *context,
+    unsigned int thread_count)
+{
+    context->scanner.setWorkerThreads(thread_count);
+}
+
+void kikCodeScannerSetLocalThreshold(
+    KikCodeScanContext *context,
+    int enabled)
+{
+    context->scanner.setLocalThreshold(enabled != 0);
+}
+
+void kikCodeScannerSetValidation(
+    KikCodeScanContext *context,
+    int enabled)
+{
+    context->scanner.setValidation(enabled != 0);
+}
+
+void kikCodeScannerSetAccumulation(
+    KikCodeScanContext *context,
+    int enabled,
+    unsigned int max_frames,
+    unsigned int max_misses)
+{
+    context->scanner.setAccumulation(enabled != 0, max_frames, max_misses);
+}
+
+void kikCodeScannerSetPyramid(
+    KikCodeScanContext *context,
+    int enabled)
+{
+    context->scanner.setPyramid(enabled != 0);
+}
+
+void kikCodeScannerSetAdaptiveResolution(
+    KikCodeScanContext *context,
+    int enabled,
+    unsigned int min_edge,
+    unsigned int max_edge)
+{
+    context->scanner.setAdaptiveResolution(enabled != 0, min_edge, max_edge);
+}
+
+void kikCodeScannerSetQualityGate(
+    KikCodeScanContext *context,
+    int enabled,
+    unsigned int min_sharpness,
+    unsigned int max_hash_distance)
+{
+    context->scanner.setQualityGate(enabled != 0, min_sharpness, max_hash_distance);
+}
+
+void kikCodeScannerSetTimeBudget(
+    KikCodeScanContext *context,
+    unsigned int budget_us)
+{
+    context->scanner.setTimeBudget(budget_us);
+}
+
+int kikCodeScannerLastScanExhaustive(
+    KikCodeScanContext *context)
+{
+    return context->scanner.lastScanExhaustive() ? 1 : 0;
+}
+
+int kikCodeScannerScanAll(
+    KikCodeScanContext *context,
     const unsigned char *image,
     unsigned int width,
     unsigned int height,
+    unsigned int row_stride,
+    unsigned int device_quality,
+    KikCodeScanResult *out_results,
+    unsigned int max_results,
+    unsigned int *out_count)
+{
+    if (out_count) {
+        *out_count = 0;
+    }
+
+    if (row_stride < width) {
+        return KIK_CODE_SCAN_RESULT_ERROR;
+    }
+
+    // wrap the caller's buffer without copying it, the scanner never writes to its input
+    // and downscales straight out of this view
+    const Mat image_view(height, width, CV_8UC1, const_cast<unsigned char *>(image), row_stride);
+
+    FrameRecorder recorder(image, width, height, row_stride, device_quality, kikCodeTraceNow());
+
+    size_t count = context->scanner.scan(image_view, device_quality, out_results, max_results);
+    recorder.setResults(out_results, count);
+
+    if (out_count) {
+        *out_count = (unsigned int)count;
+    }
+
+    return context->scanner.resultCode(count);
+}
+
+int kikCodeScannerScan(
+    KikCodeScanContext *context,
+    const unsigned char *image,
+    unsigned int width,
+    unsigned int height,
+    unsigned int row_stride,
     unsigned int device_quality,
     unsigned char *out_data,
     unsigned int *out_x,
@@ -16,84 +157,120 @@ int kikCodeScan(
     unsigned int *out_scale,
     double *out_transform)
 {
-    Mat greyscale;
-    Mat transform;
-    unsigned int temp_x = 0;
-    unsigned int temp_y = 0;
-    unsigned int temp_scale = 0;
-    double scale = 0.0;
-
-    greyscale.create(height, width, CV_8UC1);
-
-    memcpy(greyscale.data, image, height * width);
-
-    int max_edge_size = std::max(height, width);
-
-    switch (device_quality) {
-        case SCAN_DEVICE_QUALITY_LOW:
-            if (max_edge_size > 240) {
-                scale = 240.0 / max_edge_size;
-            }
-            break;
-
-        case SCAN_DEVICE_QUALITY_MEDIUM:
-            if (max_edge_size > 320) {
-                scale = 320.0 / max_edge_size;
-            }
-            break;
-
-        case SCAN_DEVICE_QUALITY_HIGH:
-            if (max_edge_size > 480) {
-                scale = 480.0 / max_edge_size;
-            }
-            break;
-
-        case SCAN_DEVICE_QUALITY_BEST:
-            if (max_edge_size > 960.0) {
-                scale = 960.0 / max_edge_size;
-            }
-            break;
-
-        default:
-            assert(false);
+    KikCodeScanResult result;
+
+    int status = kikCodeScannerScanAll(context, image, width, height, row_stride, device_quality, &result, 1, nullptr);
+
+    if (status != KIK_CODE_SCAN_RESULT_SUCCESS) {
+        return status;
+    }
+
+    memcpy(out_data, result.data, sizeof(result.data));
+
+    if (out_x) {
+        *out_x = result.x;
+    }
+    if (out_y) {
+        *out_y = result.y;
+    }
+    if (out_scale) {
+        *out_scale = result.scale;
+    }
+    if (out_transform) {
+        memcpy(out_transform, result.transform, sizeof(result.transform));
     }
 
-    if (scale > 0.0) {
-        Mat sized;
-        resize(greyscale, sized, Size(), scale, scale, cv::INTER_AREA);
+    return KIK_CODE_SCAN_RESULT_SUCCESS;
+}
+
+struct KikCodeAsyncScanner {
+    AsyncScanner scanner;
 
-        width = scale * width;
-        height = scale * height;
-        greyscale = sized;
+    KikCodeAsyncScanner(KikCodeScanContext *context, unsigned int max_results, KikCodeScanCallback callback, void *user_data)
+    : scanner(context->scanner, max_results, callback, user_data)
+    {
     }
+};
+
+KikCodeAsyncScanner *kikCodeAsyncScannerCreate(
+    KikCodeScanContext *context,
+    unsigned int max_results,
+    KikCodeScanCallback callback,
+    void *user_data)
+{
+    return new KikCodeAsyncScanner(context, max_results, callback, user_data);
+}
 
-//    DebugTiming timing;
-//    memset(&timing, 0, sizeof(DebugTiming));
-
-    if (detectKikCode(greyscale, nullptr, device_quality, out_data, &temp_x, &temp_y, &temp_scale, &transform, nullptr/*&timing*/)) {
-        if (out_x) {
-            *out_x = temp_x;
-        }
-        if (out_y) {
-            *out_y = temp_y;
-        }
-        if (out_scale) {
-            *out_scale = temp_scale;
-        }
-        if (out_transform) {
-            out_transform[0] = transform.at<double>(0, 0);
-            out_transform[1] = transform.at<double>(0, 1);
-            out_transform[2] = transform.at<double>(0, 2);
-            out_transform[3] = transform.at<double>(1, 0);
-            out_transform[4] = transform.at<double>(1, 1);
-            out_transform[5] = transform.at<double>(1, 2);
-            out_transform[6] = transform.at<double>(3, 0);
-            out_transform[7] = transform.at<double>(3, 1);
-            out_transform[8] = transform.at<double>(3, 2);
-        }
-
-        return KIK_CODE_SCAN_RESULT_SUCCESS;
+void kikCodeAsyncScannerDestroy(KikCodeAsyncScanner *scanner)
+{
+    // the worker can't join itself, and is still running the callback that got here. Once it's
+    // stopped it only touches the AsyncScanner, so that's left to another thread to join and free
+    if (scanner->scanner.onWorkerThread()) {
+        scanner->scanner.stop();
+        std::thread([scanner] { delete scanner; }).detach();
+        return;
     }
 
-    return KIK_CODE_SCAN_RESULT_ERROR;
+    delete scanner;
+}
+
+unsigned int kikCodeAsyncScannerSubmit(
+    KikCodeAsyncScanner *scanner,
+    const unsigned char *plane,
+    unsigned int width,
+    unsigned int height,
+    unsigned int row_stride,
+    unsigned int device_quality)
+{
+    return scanner->scanner.submit(plane, width, height, row_stride, device_quality);
+}
+
+int kikCodeScan(
+    const unsigned char *image,
+    unsigned int width,
+    unsigned int height,
+    unsigned int device_quality,
+    unsigned char *out_data,
+    unsigned int *out_x,
+    unsigned int *out_y,
+    unsigned int *out_scale,
+    double *out_transform)
+{
+    // each scanning thread keeps its own context so that repeated calls at the same
+    // resolution reuse the buffers from the previous frame
+    static thread_local KikCodeScanContext context(width, height, device_quality, true);
+
+    return kikCodeScannerScan(&context, image, width, height, width, device_quality, out_data, out_x, out_y, out_scale, out_transform);
+}
+
+int kikCodeScanStrided(
+    const unsigned char *plane,
+    unsigned int width,
+    unsigned int height,
+    unsigned int row_stride,
+    unsigned int device_quality,
+    unsigned char *out_data,
+    unsigned int *out_x,
+    unsigned int *out_y,
+    unsigned int *out_scale,
+    double *out_transform)
+{
+    static thread_local KikCodeScanContext context(width, height, device_quality, true);
+
+    return kikCodeScannerScan(&context, plane, width, height, row_stride, device_quality, out_data, out_x, out_y, out_scale, out_transform);
+}
+
+int kikCodeScanAll(
+    const unsigned char *plane,
+    unsigned int width,
+    unsigned int height,
+    unsigned int row_stride,
+    unsigned int device_quality,
+    KikCodeScanResult *out_results,
+    unsigned int max_results,
+    unsigned int *out_count)
+{
+    static thread_local KikCodeScanContext context(width, height, device_quality, true);
+
+    return kikCodeScannerScanAll(&context, plane, width, height, row_stride, device_quality, out_results, max_results, out_count);
 }
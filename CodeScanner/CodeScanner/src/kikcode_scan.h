@@ -3,15 +3,297 @@
 
 #include <iostream>
 
-#define KIK_CODE_SCAN_RESULT_SUCCESS 0
-#define KIK_CODE_SCAN_RESULT_ERROR   1
+#include "kikcode_constants.h"
+
+#define KIK_CODE_SCAN_RESULT_SUCCESS   0
+#define KIK_CODE_SCAN_RESULT_ERROR     1
+
+// the quality gate turned the frame away without scanning it, see kikCodeScannerSetQualityGate
+#define KIK_CODE_SCAN_RESULT_BLURRED   2
+#define KIK_CODE_SCAN_RESULT_UNCHANGED 3
 
 #define KIK_CODE_SCAN_DEVICE_QUALITY_LOW    0
 #define KIK_CODE_SCAN_DEVICE_QUALITY_MEDIUM 3
 #define KIK_CODE_SCAN_DEVICE_QUALITY_HIGH   8
 #define KIK_CODE_SCAN_DEVICE_QUALITY_BEST   10
 
+#define KIK_CODE_TRACE_HISTOGRAM_BUCKETS 20
+
 extern "C" {
+    typedef struct {
+        // the 35 data bytes of the code, to be decoded with kikCodeDecode
+        unsigned char data[KIK_CODE_TOTAL_BYTE_COUNT];
+
+        // how clearly each data byte was read, the smallest distance of any of its modules
+        // from the threshold in grey levels, for kikCodeDecodeWithConfidence
+        unsigned char confidence[KIK_CODE_TOTAL_BYTE_COUNT];
+
+        // center and size of the code in the scanner's working resolution
+        unsigned int x;
+        unsigned int y;
+        unsigned int scale;
+
+        // row-major 3x3 transform from the scene onto the exemplar code
+        double transform[9];
+
+        // the working resolution the frame was scanned at, which x, y, scale and transform are in.
+        // Scale them by the frame's width over working_width to map them onto the frame. With
+        // adaptive resolution this changes from frame to frame
+        unsigned int working_width;
+        unsigned int working_height;
+    } KikCodeScanResult;
+
+    // how long the stages of a scan took, in milliseconds, and the resolution it ran at
+    typedef struct {
+        unsigned int frame_id;
+
+        // frames dropped unscanned since the last frame reported, because a newer one arrived
+        // while they waited
+        unsigned int dropped_frames;
+
+        // from submitting the frame until its scan started
+        double queued;
+
+        double quality_gate;
+        double sharpen;
+        double threshold;
+        double blobs;
+        double ellipses;
+        double candidates;
+        double total;
+
+        // 0 if the time budget ran out before every candidate was evaluated
+        int exhaustive;
+
+        // the working resolution this frame was scanned at, 0 if the quality gate turned it away,
+        // and the longer edge of the one the next frame will be scanned at, as picked by adaptive
+        // resolution
+        unsigned int working_width;
+        unsigned int working_height;
+        unsigned int next_working_edge;
+    } KikCodeScanTiming;
+
+    // durations of the recent runs of one stage, in milliseconds. Bucket k counts durations of
+    // 2^k up to 2^(k+1) microseconds, the first bucket everything shorter and the last everything
+    // longer
+    typedef struct {
+        const char *name;
+        unsigned int count;
+
+        double p50;
+        double p90;
+        double p99;
+        double max;
+
+        unsigned int buckets[KIK_CODE_TRACE_HISTOGRAM_BUCKETS];
+    } KikCodeTraceHistogram;
+
+    /**
+     * Receives the outcome of an asynchronous scan: a KIK_CODE_SCAN_RESULT_ status and the
+     * result_count codes found. results and timing are only valid during the call.
+     */
+    typedef void (*KikCodeScanCallback)(
+        void *user_data,
+        int status,
+        const KikCodeScanResult *results,
+        unsigned int result_count,
+        const KikCodeScanTiming *timing);
+
+    /**
+     * Opaque scanning context that owns the working buffers for a capture resolution. Holding on
+     * to a context across frames avoids reallocating those buffers for every scan. A context must
+     * only be used by one thread at a time.
+     */
+    typedef struct KikCodeScanContext KikCodeScanContext;
+
+    KikCodeScanContext *kikCodeScannerCreate(
+        unsigned int width,
+        unsigned int height,
+        unsigned int device_quality);
+
+    void kikCodeScannerDestroy(KikCodeScanContext *context);
+
+    /**
+     * Tracking mode: after a successful scan the next frame is first searched only in a crop
+     * around the last detection, grown by motion_margin times the code size on every side. After
+     * max_misses consecutive misses the context falls back to scanning the full frame.
+     */
+    void kikCodeScannerSetTracking(
+        KikCodeScanContext *context,
+        int enabled,
+        unsigned int max_misses,
+        double motion_margin);
+
+    /**
+     * Evaluates candidate codes in a frame on thread_count background threads as well as the
+     * calling thread, instead of one after another. 0 (the default) turns this off again.
+     */
+    void kikCodeScannerSetWorkerThreads(
+        KikCodeScanContext *context,
+        unsigned int thread_count);
+
+    /**
+     * Local thresholding: light codes are also thresholded against the mean of each pixel's
+     * surroundings rather than only against a fixed level, so that they still read in shadow or
+     * under uneven lighting. Off by default.
+     */
+    void kikCodeScannerSetLocalThreshold(
+        KikCodeScanContext *context,
+        int enabled);
+
+    /**
+     * Validation: only candidates whose data error corrects count as codes, and their corrected
+     * data is returned. A candidate that doesn't is skipped and the search continues with the
+     * next one. Off by default for contexts from kikCodeScannerCreate, always on for the scanning
+     * functions that don't take a context.
+     */
+    void kikCodeScannerSetValidation(
+        KikCodeScanContext *context,
+        int enabled);
+
+    /**
+     * Soft-bit accumulation: the context averages how clearly each module of a code was read over
+     * up to max_frames consecutive frames, and decodes a code that can't be corrected from a
+     * single frame from that average. The evidence for a code is dropped after max_misses scans
+     * that don't find it.
+     */
+    void kikCodeScannerSetAccumulation(
+        KikCodeScanContext *context,
+        int enabled,
+        unsigned int max_frames,
+        unsigned int max_misses);
+
+    /**
+     * Pyramid mode: candidate codes are found in a quarter-resolution copy of the frame, and only
+     * searched for at the resolution device_quality calls for in a crop around each candidate.
+     * A frame then costs a quarter-resolution scan plus a small full scan of each candidate's
+     * crop, which is well under a full scan when there are few candidates but can exceed it when
+     * there are many. Codes under about 50 pixels across at the working resolution don't show up
+     * as candidates and are missed. Off by default.
+     */
+    void kikCodeScannerSetPyramid(
+        KikCodeScanContext *context,
+        int enabled);
+
+    /**
+     * Adaptive resolution: instead of a fixed resolution per device_quality, each frame is scanned
+     * at a resolution picked from the size of the codes found in recent frames and from how often
+     * recent frames missed, with the longer edge kept between min_edge and max_edge pixels. Off by
+     * default.
+     */
+    void kikCodeScannerSetAdaptiveResolution(
+        KikCodeScanContext *context,
+        int enabled,
+        unsigned int min_edge,
+        unsigned int max_edge);
+
+    /**
+     * Quality gate: before scanning, the context measures each frame on a sparse grid, well under
+     * a millisecond, and turns away frames that are too blurred to read (sharpness below
+     * min_sharpness, from 0 to 510) with KIK_CODE_SCAN_RESULT_BLURRED, and frames that look the
+     * same as the last one that was scanned without finding anything (hashes at most
+     * max_hash_distance of 64 bits apart) with KIK_CODE_SCAN_RESULT_UNCHANGED. Off by default.
+     */
+    void kikCodeScannerSetQualityGate(
+        KikCodeScanContext *context,
+        int enabled,
+        unsigned int min_sharpness,
+        unsigned int max_hash_distance);
+
+    /**
+     * Time budget: the context stops evaluating candidates once budget_us microseconds have passed
+     * since the scan started, trying the most likely ones first, so that a cluttered frame can't
+     * hold up the frames after it. The budget is checked between candidates and may be overrun by
+     * one candidate's evaluation. 0, the default, for no limit.
+     */
+    void kikCodeScannerSetTimeBudget(
+        KikCodeScanContext *context,
+        unsigned int budget_us);
+
+    /**
+     * @returns 0 if the time budget ran out before every candidate of the last frame scanned was
+     * evaluated, so a code in it may have been missed
+     */
+    int kikCodeScannerLastScanExhaustive(
+        KikCodeScanContext *context);
+
+    int kikCodeScannerScan(
+        KikCodeScanContext *context,
+        const unsigned char *image,
+        unsigned int width,
+        unsigned int height,
+        unsigned int row_stride,
+        unsigned int device_quality,
+        unsigned char *out_data,
+        unsigned int *out_x,
+        unsigned int *out_y,
+        unsigned int *out_scale,
+        double *out_transform);
+
+    /**
+     * Scans for every Kik code in the image, filling up to max_results entries of out_results.
+     * Candidates that overlap a code that has already been found are skipped.
+     *
+     * @returns KIK_CODE_SCAN_RESULT_SUCCESS if at least one code was found
+     */
+    int kikCodeScannerScanAll(
+        KikCodeScanContext *context,
+        const unsigned char *image,
+        unsigned int width,
+        unsigned int height,
+        unsigned int row_stride,
+        unsigned int device_quality,
+        KikCodeScanResult *out_results,
+        unsigned int max_results,
+        unsigned int *out_count);
+
+    /**
+     * Asynchronous scanner that runs a context on a thread of its own. Submitting a frame copies
+     * it and returns straight away. The worker always scans the newest frame submitted and drops
+     * any older ones still waiting, so capture never waits on a scan.
+     */
+    typedef struct KikCodeAsyncScanner KikCodeAsyncScanner;
+
+    /**
+     * Creates an asynchronous scanner around context, which must be configured beforehand and
+     * not used again until the scanner is destroyed. callback is called on the scanner's thread
+     * once for each frame scanned, with up to max_results codes.
+     */
+    KikCodeAsyncScanner *kikCodeAsyncScannerCreate(
+        KikCodeScanContext *context,
+        unsigned int max_results,
+        KikCodeScanCallback callback,
+        void *user_data);
+
+    /**
+     * Stops the scanner. A frame still waiting is dropped, the callback for a frame being scanned
+     * is called before this returns.
+     *
+     * It may also be called from the callback, such as when the callback releases the last
+     * reference to what owns the scanner. The callback isn't called again and the context isn't
+     * used again once this returns, but the scanner's thread is joined and freed on another thread
+     * after the callback returns.
+     */
+    void kikCodeAsyncScannerDestroy(KikCodeAsyncScanner *scanner);
+
+    /**
+     * Queues a copy of a greyscale plane whose rows are row_stride bytes apart. Safe to call from
+     * any thread.
+     *
+     * @returns The id the frame is reported with, 0 if row_stride is less than width
+     */
+    unsigned int kikCodeAsyncScannerSubmit(
+        KikCodeAsyncScanner *scanner,
+        const unsigned char *plane,
+        unsigned int width,
+        unsigned int height,
+        unsigned int row_stride,
+        unsigned int device_quality);
+
+    /**
+     * Scans a tightly packed width * height greyscale image using a context that is reused by
+     * every call made from the same thread.
+     */
     int kikCodeScan(
         const unsigned char *image,
         unsigned int width,
@@ -22,6 +304,79 @@ extern "C" {
         unsigned int *out_y,
         unsigned int *out_scale,
         double *out_transform);
+
+    /**
+     * Scans a greyscale plane whose rows are row_stride bytes apart, such as the padded luminance
+     * plane of a camera frame. The plane is read in place and is never copied at full resolution.
+     */
+    int kikCodeScanStrided(
+        const unsigned char *plane,
+        unsigned int width,
+        unsigned int height,
+        unsigned int row_stride,
+        unsigned int device_quality,
+        unsigned char *out_data,
+        unsigned int *out_x,
+        unsigned int *out_y,
+        unsigned int *out_scale,
+        double *out_transform);
+
+    /**
+     * Multi-code variant of kikCodeScanStrided, see kikCodeScannerScanAll.
+     */
+    int kikCodeScanAll(
+        const unsigned char *plane,
+        unsigned int width,
+        unsigned int height,
+        unsigned int row_stride,
+        unsigned int device_quality,
+        KikCodeScanResult *out_results,
+        unsigned int max_results,
+        unsigned int *out_count);
+
+    /**
+     * Tracing: while enabled, every scan records how long each of its stages took, nested as they
+     * ran, along with counters such as the number of candidates, on every thread it uses. The cost
+     * while disabled is a flag check per stage. Off by default.
+     */
+    void kikCodeTraceSetEnabled(int enabled);
+
+    /**
+     * Takes the events recorded since the last export as a Chrome trace (chrome://tracing or
+     * Perfetto) in JSON. Events that were overwritten or dropped before they could be exported are
+     * counted in a "dropped_events" counter.
+     *
+     * @returns A string to be freed with kikCodeTraceFree
+     */
+    char *kikCodeTraceExportChrome(void);
+
+    void kikCodeTraceFree(char *trace);
+
+    /**
+     * Fills up to max_histograms entries of out_histograms with the distribution of the most
+     * recent durations of each stage, in order of name.
+     *
+     * @returns The number of entries written
+     */
+    unsigned int kikCodeTraceHistograms(
+        KikCodeTraceHistogram *out_histograms,
+        unsigned int max_histograms);
+
+    /**
+     * Recording: every frame scanned from now on, on any thread and through any of the scanning
+     * functions or an asynchronous scanner, is appended to a frame archive at path (see
+     * frame_archive.h) as it was passed in, with the time it was passed and the data of the first
+     * code found in it, to be replayed with kikscan_replay. Frames are written on the scanning
+     * thread before they're scanned. Replaces any recording in progress.
+     *
+     * @returns KIK_CODE_SCAN_RESULT_ERROR if the archive can't be created
+     */
+    int kikCodeRecordStart(const char *path);
+
+    /**
+     * Stops recording and closes the archive once the frames being scanned have been written.
+     */
+    void kikCodeRecordStop(void);
 }
 
 #endif // __KIKCODE_SCAN_H__
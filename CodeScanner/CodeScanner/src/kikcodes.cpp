@@ -50,7 +50,17 @@ int kikCodeDecode(
     KikCodePayload *out_payload,
     unsigned int *out_colour_code)
 {
-    KikCode *kik_code = KikCode::parse(data);
+    return kikCodeDecodeWithConfidence(data, nullptr, out_type, out_payload, out_colour_code);
+}
+
+int kikCodeDecodeWithConfidence(
+    const unsigned char *data,
+    const unsigned char *confidence,
+    unsigned int *out_type,
+    KikCodePayload *out_payload,
+    unsigned int *out_colour_code)
+{
+    KikCode *kik_code = KikCode::parse(data, confidence);
 
     if (!kik_code) {
         return KIK_CODE_RESULT_ERROR;
@@ -46,6 +46,14 @@ extern "C" {
         unsigned int *out_type,
         KikCodePayload *out_payload,
         unsigned int *out_colour_code);
+
+    // decodes scanned data, using the scanner's per-byte confidence to correct more damage
+    int kikCodeDecodeWithConfidence(
+        const unsigned char *data,
+        const unsigned char *confidence,
+        unsigned int *out_type,
+        KikCodePayload *out_payload,
+        unsigned int *out_colour_code);
 }
 
 #endif // __KIKCODES_H__
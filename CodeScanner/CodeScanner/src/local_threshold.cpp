@@ -0,0 +1,144 @@
+#include "local_threshold.h"
+
+#include <algorithm>
+
+using namespace std;
+
+LocalThreshold::LocalThreshold()
+: src_(nullptr)
+, src_stride_(0)
+, width_(0)
+, height_(0)
+, sum_stride_(0)
+{
+}
+
+void LocalThreshold::build(const uint8_t *src, size_t src_stride, int width, int height)
+{
+    src_ = src;
+    src_stride_ = src_stride;
+    width_ = width;
+    height_ = height;
+    sum_stride_ = width + 1;
+
+    size_t size = sum_stride_ * (height + 1);
+
+    if (sums_.size() < size) {
+        sums_.resize(size);
+    }
+
+    fill(sums_.begin(), sums_.begin() + sum_stride_, 0);
+
+    for (int y = 0; y < height; ++y) {
+        const uint8_t *row = src + y * src_stride;
+        const uint32_t *above = &sums_[y * sum_stride_];
+        uint32_t *sums = &sums_[(y + 1) * sum_stride_];
+        uint32_t row_sum = 0;
+
+        sums[0] = 0;
+
+        for (int x = 0; x < width; ++x) {
+            row_sum += row[x];
+            sums[x + 1] = above[x + 1] + row_sum;
+        }
+    }
+}
+
+uint32_t LocalThreshold::windowSum(int x, int y, int radius, uint32_t *out_area) const
+{
+    int left = max(x - radius, 0);
+    int right = min(x + radius + 1, width_);
+    int top = max(y - radius, 0);
+    int bottom = min(y + radius + 1, height_);
+
+    const uint32_t *top_row = &sums_[top * sum_stride_];
+    const uint32_t *bottom_row = &sums_[bottom * sum_stride_];
+
+    *out_area = (right - left) * (bottom - top);
+
+    return bottom_row[right] - bottom_row[left] - top_row[right] + top_row[left];
+}
+
+int LocalThreshold::mean(int x, int y, int radius) const
+{
+    uint32_t area;
+    uint32_t sum = windowSum(x, y, radius, &area);
+
+    return (int)((sum + area / 2) / area);
+}
+
+bool LocalThreshold::isDark(int x, int y, int radius, int delta) const
+{
+    uint32_t area;
+    int64_t sum = windowSum(x, y, radius, &area);
+
+    // the same test as dark()
+    return (src_[y * src_stride_ + x] + delta) * (int64_t)area <= sum;
+}
+
+void LocalThreshold::dark(int x0, int y0, int width, int height, int radius, int delta, uint8_t *dst, size_t dst_stride) const
+{
+    for (int y = y0; y < y0 + height; ++y) {
+        int top = max(y - radius, 0);
+        int bottom = min(y + radius + 1, height_);
+
+        const uint32_t *top_row = &sums_[top * sum_stride_];
+        const uint32_t *bottom_row = &sums_[bottom * sum_stride_];
+        const uint8_t *src = src_ + y * src_stride_;
+        uint8_t *out = dst + (y - y0) * dst_stride;
+
+        for (int x = x0; x < x0 + width; ++x) {
+            int left = max(x - radius, 0);
+            int right = min(x + radius + 1, width_);
+
+            int64_t sum = bottom_row[right] - bottom_row[left] - top_row[right] + top_row[left];
+            int64_t area = (right - left) * (bottom - top);
+
+            // src - mean <= -delta, without dividing
+            out[x - x0] = (src[x] + delta) * area <= sum ? 255 : 0;
+        }
+    }
+}
+
+void LocalThreshold::light(int x0, int y0, int width, int height, int radius, int percent, int floor, uint8_t *dst, size_t dst_stride) const
+{
+    for (int y = y0; y < y0 + height; ++y) {
+        int top = max(y - radius, 0);
+        int bottom = min(y + radius + 1, height_);
+
+        const uint32_t *top_row = &sums_[top * sum_stride_];
+        const uint32_t *bottom_row = &sums_[bottom * sum_stride_];
+        const uint8_t *src = src_ + y * src_stride_;
+        uint8_t *out = dst + (y - y0) * dst_stride;
+
+        for (int x = x0; x < x0 + width; ++x) {
+            if (src[x] <= floor) {
+                continue;
+            }
+
+            int left = max(x - radius, 0);
+            int right = min(x + radius + 1, width_);
+
+            int64_t sum = bottom_row[right] - bottom_row[left] - top_row[right] + top_row[left];
+            int64_t area = (right - left) * (bottom - top);
+
+            // src > mean * (100 - percent) / 100, without dividing
+            if (src[x] * area * 100 > sum * (100 - percent)) {
+                out[x - x0] = 255;
+            }
+        }
+    }
+}
+
+int LocalThreshold::lightMargin(int x, int y, int radius, int percent, int floor) const
+{
+    uint32_t area;
+    int64_t sum = windowSum(x, y, radius, &area);
+    int pixel = src_[y * src_stride_ + x];
+
+    // the same tests as light(): above floor, and above mean * (100 - percent) / 100, of which a
+    // whole grey level is only above the level rounded down
+    int64_t level = sum * (100 - percent) / ((int64_t)area * 100);
+
+    return pixel - (int)max((int64_t)floor, level) - 1;
+}
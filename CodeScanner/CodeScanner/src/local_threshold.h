@@ -0,0 +1,74 @@
+#ifndef __LOCAL_THRESHOLD_H__
+#define __LOCAL_THRESHOLD_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/**
+ * Thresholds a greyscale frame against the mean of each pixel's neighbourhood, using a summed-area
+ * table so that the mean of any square window costs four lookups whatever its size.
+ *
+ * The table is built once per frame, after which both polarities can be read from it at any window
+ * size: pixels clearly darker than their surroundings for inverted-colour codes, and pixels that are
+ * light relative to their surroundings for codes under uneven lighting. Either can be produced for
+ * a whole frame, for just the region around a candidate, or for single pixels.
+ *
+ * Windows are clipped to the frame, so the mean near the border is over fewer pixels rather than
+ * over replicated ones.
+ */
+class LocalThreshold {
+public:
+    LocalThreshold();
+
+    /**
+     * Builds the table for a frame. The frame is referenced, not copied, and has to outlive every
+     * other call until the next build().
+     */
+    void build(const uint8_t *src, size_t src_stride, int width, int height);
+
+    /**
+     * @returns The mean of the window of the given radius around (x, y), rounded
+     */
+    int mean(int x, int y, int radius) const;
+
+    /**
+     * @returns True iff the pixel at (x, y) is at least delta below the mean of its window
+     */
+    bool isDark(int x, int y, int radius, int delta) const;
+
+    /**
+     * Writes 255 for every pixel of the region at (x0, y0) that is at least delta below the mean of
+     * its window and 0 for every other one. dst points at the region's top-left pixel.
+     */
+    void dark(int x0, int y0, int width, int height, int radius, int delta, uint8_t *dst, size_t dst_stride) const;
+
+    /**
+     * Sets every pixel of the region at (x0, y0) to 255 that is above floor and no more than
+     * percent below the mean of its window, and leaves the others as they are. This is Bradley's
+     * adaptive threshold: unlike a fixed cutoff it follows the lighting across the frame.
+     */
+    void light(int x0, int y0, int width, int height, int radius, int percent, int floor, uint8_t *dst, size_t dst_stride) const;
+
+    /**
+     * @returns How far the pixel at (x, y) is above the higher of the two levels light() holds it
+     * to, in whole grey levels: at least 0 where light() sets it, and negative where it doesn't
+     */
+    int lightMargin(int x, int y, int radius, int percent, int floor) const;
+
+private:
+    const uint8_t *src_;
+    size_t src_stride_;
+    int width_;
+    int height_;
+
+    // (width + 1) * (height + 1) running sums, the first row and column are 0. The sums wrap for
+    // frames of more than 2^24 pixels, but the differences that make up a window don't as long as
+    // the window itself is smaller than that
+    std::vector<uint32_t> sums_;
+    size_t sum_stride_;
+
+    uint32_t windowSum(int x, int y, int radius, uint32_t *out_area) const;
+};
+
+#endif // __LOCAL_THRESHOLD_H__
@@ -1,10 +1,10 @@
 #include "scanner.h"
 #include "kikcode_encoding.h"
 #include "kikcode_constants.h"
+#include "trace.h"
 
 #include <iostream>
-#include <sstream>
-#include <sys/time.h>
+#include <algorithm>
 
 #include <opencv2/core.hpp>
 #include <opencv2/imgproc.hpp>
@@ -15,7 +15,6 @@
 #endif
 
 #define DEBUGGING 0
-#define FINDER_POINT_COUNT 9
 
 /**
  * If you are going to poke around the scanning algorithm first review the "Will it scan?"
@@ -25,33 +24,40 @@
 using namespace std;
 using namespace cv;
 
-const uint8_t finder_bytes[] = {0xB2, 0xCB, 0x25, 0xC6};
+const uint8_t finder_bytes[] = KIK_CODE_FINDER_BYTES;
 
+/**
+ * @returns Microseconds on the tracing clock
+ */
 static uint64_t getTimestamp()
 {
-    struct timeval now;
-    gettimeofday (&now, NULL);
-    return now.tv_usec + (uint64_t)now.tv_sec * 1000000;
+    return kikCodeTraceNow() / 1000;
 }
 
-#define INNER_RING_RATIO 0.32
+// pyramid scans look for candidates at this fraction of the working resolution, then search a crop
+// this much wider than the code a candidate would be the centre of
+#define PYRAMID_FACTOR 4
+#define PYRAMID_CROP_MARGIN 0.25
 
-#define START_DEBUG_TIMING(x) uint64_t __##x = getTimestamp();
-#define END_DEBUG_TIMING(timing, x) if (timing) {timing->x += ((getTimestamp() - __##x) / 1000.0L);}
+// adaptive resolution aims for codes this many working pixels across, and weighs each frame this
+// much in the miss rate. The working edge moves in steps of ADAPTIVE_EDGE_STEP pixels, and only
+// once it would change by more than ADAPTIVE_HYSTERESIS of itself
+#define ADAPTIVE_TARGET_CODE_SIZE 128.0
+#define ADAPTIVE_MISS_WEIGHT 0.25
+#define ADAPTIVE_EDGE_STEP 16
+#define ADAPTIVE_HYSTERESIS 0.15
 
-typedef struct {
-    double dx;
-    double dy;
-    
-    double x;
-    double y;
-    
-    double angle;
-    double dist;
-    
-    int contourIndex;
-    int contourSize;
-} FinderPoint;
+// light modules are brighter than this after sharpening
+#define WHITISH_THRESHOLD 170
+
+// in inverted-colour codes, dark modules are this much darker than their surroundings
+#define BLACKISH_DELTA 5
+
+// with local thresholding, light modules are also those above this level that are no more than
+// this many percent darker than the mean of a window of a sixteenth of the frame around them
+#define WHITISH_LOCAL_FLOOR 48
+#define WHITISH_LOCAL_PERCENT 15
+#define WHITISH_LOCAL_WINDOW_DIVISOR 16
 
 bool compareFinderPointsSize(FinderPoint a, FinderPoint b)
 {
@@ -125,366 +131,1515 @@ void dilation(Mat &src, Mat &out, size_t dilation_size)
     dilate(src, out, element);
 }
 
-void unsharpMask(cv::Mat &im) 
+KikCodeScanner::KikCodeScanner()
+: tracking_enabled_(false)
+, tracking_max_misses_(3)
+, tracking_motion_margin_(0.5)
+, validation_enabled_(false)
+, pyramid_enabled_(false)
+, quality_gate_enabled_(false)
+, quality_min_sharpness_(0)
+, quality_max_hash_distance_(0)
+, frame_status_(SCAN_FRAME_ACCEPTED)
+, failed_hash_valid_(false)
+, failed_hash_(0)
+, adaptive_enabled_(false)
+, adaptive_min_edge_(240)
+, adaptive_max_edge_(960)
+, budget_us_(0)
+, deadline_(0)
+, search_exhaustive_(true)
+, accumulation_enabled_(false)
+, accumulation_max_frames_(8)
+, accumulation_max_misses_(3)
+, sharpen_thresholded_(false)
+, local_threshold_built_(false)
+, local_threshold_enabled_(false)
+, whitish_local_radius_(0)
+, blackish_radius_(9)
 {
-    cv::Mat tmp;
-    cv::GaussianBlur(im, tmp, cv::Size(0, 0), 2);
-    cv::addWeighted(im, 1.5, tmp, -0.5, 0, im);
-}
+    tracking_.valid = false;
+    tracking_.misses = 0;
 
-/**
- * For a specific, candidate ellipse, try to find the components of the orientation ring and 
- * determine the actual orientation of the code
- *
- * When this method completes, if an orientation ring was found, out_finder_points will
- * be populated with a representation of the center of each bit sequence in the finder pattern
- *
- * @returns True iff the orientation ring was present, containing the correct pattern of bits
- */
-bool extractFinderPoints(int ellipse_id, bool check_high, RotatedRect inner_ring, Mat &blackish, Mat &whitish, Mat &progress, vector<FinderPoint> &out_finder_points, DebugTiming *timing, bool debug)
-{
-    START_DEBUG_TIMING(efp);
+    hint_.valid = false;
 
-    START_DEBUG_TIMING(efp_compute_offset);
+    resetAccumulation();
+    resetAdaptiveResolution();
 
-    double finder_deltas[FINDER_POINT_COUNT - 1];
-    computeFinderDeltas(finder_deltas);
+    computeFinderDeltas(finder_deltas_);
 
-    END_DEBUG_TIMING(timing, efp_compute_offset);
+    const float modifier = KIK_CODE_MODIFIER;
+    const float offset_x = KIK_CODE_OBJECT_SIZE / 2;
+    const float offset_y = KIK_CODE_OBJECT_SIZE / 2;
 
-    vector<FinderPoint> finder_points;
+    // the object-space positions of the finder points and data points are a constant of the
+    // Kik code layout, so they only need to be generated once
+    double current_angle = M_PI / 16 - M_PI / 2;
 
-    RotatedRect finder_point_ellipse_boundaries = inner_ring;
+    for (int j = 0; j < FINDER_POINT_COUNT; ++j) {
+        object_finder_points_.push_back(
+            Point2f(modifier * KIK_CODE_FINDER_RADIUS * cos(current_angle) + offset_x, modifier * KIK_CODE_FINDER_RADIUS * sin(current_angle) + offset_y));
 
-    // start by masking off the region where we expect to find the finder
-    // ring (between 1.22 and 1.525 times the size of the inner circle)
-    Mat finder_point_range = Mat::zeros(whitish.size(), whitish.type());
-    
-    inner_ring.size.width *= 1.525;
-    inner_ring.size.height *= 1.525;
-    
-    START_DEBUG_TIMING(efp_ellipse_region);
-    ellipse(finder_point_range, inner_ring, Scalar(255, 255, 255), -1);
-    
-    inner_ring.size.width *= 0.805;
-    inner_ring.size.height *= 0.805;
-    
-    ellipse(finder_point_range, inner_ring, Scalar(0, 0, 0), -1);
+        if (j < FINDER_POINT_COUNT - 1) {
+            current_angle += finder_deltas_[j];
+        }
+    }
 
-#if DEBUGGING
-    if (debug) {
-        char filename[128];
+    for (int r = 1; r <= KIK_CODE_DATA_RING_COUNT; ++r) {
+        size_t n = 32 + 8 * r;
 
-        sprintf(filename, "07_%d_candidates.jpg", ellipse_id);
+        for (int j = 0; j < n; ++j) {
+            double angle = j * M_PI / n * 2 - M_PI / 2;
+            double radius = modifier * ((r + 1) * 0.4 + 1.8);
 
-        imwrite(filename, finder_point_range);
+            object_data_points_.push_back(Point2f(radius * cos(angle) + offset_x, radius * sin(angle) + offset_y));
+        }
     }
-#endif
-    
-    END_DEBUG_TIMING(timing, efp_ellipse_region);
-    Point2i last_point;
 
-    Mat candidate_region;
+    setWorkerThreads(0);
+}
 
-    START_DEBUG_TIMING(efp_and);
+KikCodeScanner::KikCodeScanner(uint32_t width, uint32_t height, uint32_t device_quality)
+: KikCodeScanner()
+{
+    reserve(width, height, device_quality);
+}
 
-    // mask off the thresholded image to only look at the candidate region
-    if (!check_high) {
-        bitwise_and(blackish, finder_point_range, candidate_region);
-    }
-    else {
-        bitwise_and(whitish, finder_point_range, candidate_region);
-    }
-    END_DEBUG_TIMING(timing, efp_and);
+/**
+ * @returns The longest edge device_quality scans at, larger frames are downscaled to it
+ */
+static uint32_t qualityEdge(uint32_t device_quality)
+{
+    switch (device_quality) {
+        case SCAN_DEVICE_QUALITY_LOW:
+            return 240;
 
-    vector<vector<Point2i> > contours;
-    vector<Vec4i> hierarchy;
-    
-    // detect all blobs within the candidate region
-    START_DEBUG_TIMING(efp_contours);
-    findContours(candidate_region, contours, hierarchy, cv::RETR_CCOMP, cv::CHAIN_APPROX_SIMPLE, Point2i(0, 0));
-    END_DEBUG_TIMING(timing, efp_contours);
-    
-    // compute the image moments for each blob in the candidate region, we use these
-    // moments to look and the relative angles between the **centers** of each blob
-    START_DEBUG_TIMING(efp_moments);
-    vector<Moments> mu(contours.size());
-    vector<Point2f> mc(contours.size());
+        case SCAN_DEVICE_QUALITY_MEDIUM:
+            return 320;
 
-    for (int i = 0; i < contours.size(); ++i) {
-        vector<Point2i> &contour = contours[i];
+        case SCAN_DEVICE_QUALITY_HIGH:
+            return 480;
 
-        if (contour.size() > 1) {
-            mu[i] = moments(contour, false);
-            mc[i] = Point2f(mu[i].m10/mu[i].m00 , mu[i].m01/mu[i].m00);
-        }
+        case SCAN_DEVICE_QUALITY_BEST:
+            return 960;
+
+        default:
+            assert(false);
     }
-    END_DEBUG_TIMING(timing, efp_moments);
 
-    Mat finder_point_extraction;
+    return 0;
+}
 
-#if DEBUGGING
-    if (debug) {
-        finder_point_extraction = Mat::zeros(whitish.size(), CV_8UC3);
-        char filename[128];
+Size KikCodeScanner::workingSize(uint32_t width, uint32_t height, uint32_t device_quality, double *out_scale) const
+{
+    double scale = 0.0;
+    uint32_t max_edge_size = std::max(height, width);
+    uint32_t edge = qualityEdge(device_quality);
 
-        Mat finder_point_range = Mat::zeros(whitish.size(), CV_8UC3);
+    if (adaptive_enabled_ && resolution_.edge > 0) {
+        edge = resolution_.edge;
+    }
 
-        sprintf(filename, "08_%d_finder_contours.jpg", ellipse_id);
+    if (edge > 0 && max_edge_size > edge) {
+        scale = (double)edge / max_edge_size;
+    }
 
-        for (int i = 0; i < contours.size(); ++i) {
-            drawContours(finder_point_range, contours, i, Scalar(rand() & 255, rand() & 255, rand() & 255), 1, 8, hierarchy, 0, Point2i());
-        }
+    if (out_scale) {
+        *out_scale = scale;
+    }
 
-        imwrite(filename, finder_point_range);
+    if (scale > 0.0) {
+        // matches the destination size resize() derives from a scale factor
+        return Size(saturate_cast<int>(width * scale), saturate_cast<int>(height * scale));
     }
-#endif
 
-    // set up the finder point extraction process by computing the vector from the center
-    // of the candidate ellipse to the center of each blob. From this vector, we care about
-    // the angle and the distance from the center point
-    START_DEBUG_TIMING(efp_extraction);
-    for (int i = 0; i < contours.size(); ++i) {
-        vector<Point2i> &contour = contours[i];
-        
-        Point2i point = mc[i];
-        
-        double dist = sqrt(pow(point.x - last_point.x, 2.0) + pow(point.y - last_point.y, 2.0));
-        
-        if (dist < 2) {
-            continue;
-        }
-        
-        last_point = point;
-        
-        if (contour.size() > 1) {
-            if (mc[i].y > 0 && mc[i].x > 0) {
-                if (finder_point_range.at<char>(mc[i].y, mc[i].x) != 0) {
-                    FinderPoint finder;
-                    
-                    finder.x = mc[i].x;
-                    finder.y = mc[i].y;
-                    
-                    finder.dx = finder.x - inner_ring.center.x;
-                    finder.dy = finder.y - inner_ring.center.y;
-                    
-                    finder.contourIndex = i;
+    return Size(width, height);
+}
 
-                    finder.contourSize = contour.size();
-                    
-                    finder.dist = sqrt(finder.dx * finder.dx + finder.dy * finder.dy);
-                    
-                    finder.angle = atan2(finder.dy, finder.dx);
-                    
-                    finder_points.push_back(finder);
-                }
-            }
-        }
+/**
+ * Points view at the top-left size.width x size.height corner of storage, growing the storage
+ * first if it is too small. The view shares the storage's memory.
+ */
+static void fitBuffer(Mat &storage, Mat &view, Size size)
+{
+    if (storage.cols < size.width || storage.rows < size.height) {
+        storage.create(MAX(storage.rows, size.height), MAX(storage.cols, size.width), CV_8UC1);
     }
-    END_DEBUG_TIMING(timing, efp_extraction);
-    
-    START_DEBUG_TIMING(efp_filter_and_sort);
-    if (finder_points.size() > 0) {
-        // disard small shards that were erroneously picked up
-        sort(finder_points.begin(), finder_points.end(), compareFinderPointsSize);
 
-        int p90_size = finder_points[finder_points.size() * 0.9].contourSize;
-        
-        for (int i = 0; i < finder_points.size(); ++i) {
-            if (finder_points[i].contourSize < p90_size / 5) {
-                finder_points.erase(finder_points.begin() + i);
+    view = storage(Rect(0, 0, size.width, size.height));
+}
 
-                --i;
-            }
-        }
+void KikCodeScanner::reserve(uint32_t width, uint32_t height, uint32_t device_quality)
+{
+    Size size = workingSize(width, height, device_quality, nullptr);
 
-        if (debug) {
-            for (int i = 0; i < finder_points.size(); ++i) {
-                FinderPoint finder = finder_points[i];
-                Scalar colour = Scalar(rand() & 255, rand() & 255, rand() & 255);
+    workingBuffer(size);
+    allocateBuffers(size);
+}
 
-                drawContours(finder_point_extraction, contours, finder.contourIndex, colour, 1, 8, hierarchy, 0, Point2i());
-                circle(finder_point_extraction, Point2i(finder.x, finder.y), 2, colour, -1);
-            }
-        }
-    }
+Mat &KikCodeScanner::workingBuffer(Size size)
+{
+    fitBuffer(working_storage_, working_, size);
 
-#if DEBUGGING
-    if (debug) {
-        char filename[128];
+    return working_;
+}
 
-        sprintf(filename, "09_%d_finder_point_extraction.jpg", ellipse_id);
+void KikCodeScanner::allocateBuffers(Size size)
+{
+    fitBuffer(contour_mat_storage_, contour_mat_, size);
 
-        imwrite(filename, finder_point_extraction);
-    }
-#endif
+    whitish_.create(size.width, size.height);
+    ellipse_boundaries_.create(size.width, size.height);
+}
 
-    // if we have too few or too many finder points (we need 9), we couldn't have
-    // possibly found an orientation ring
-    if (finder_points.size() != sizeof(finder_deltas) / sizeof(double) + 1) {
-        return false;
-    }
-    
-    // sort the finder points into a clockwise winding based on the angle of the computed vector
-    sort(finder_points.begin(), finder_points.end(), compareFinderPoints);
-    END_DEBUG_TIMING(timing, efp_filter_and_sort);
-    
-    vector<double> point_deltas(finder_points.size());
-    
-    START_DEBUG_TIMING(efp_check_ratio);
-    // compute the relative angles between each neighbouring pair of finder points
-    for (int j = 0; j < finder_points.size(); ++j) {
-        point_deltas[j] = finder_points[(j + 1) % finder_points.size()].angle - finder_points[j].angle;
-        
-        while (point_deltas[j] < 0.0) {
-            point_deltas[j] += 2 * M_PI;
-        }
-    }
+void KikCodeScanner::setTracking(bool enabled, uint32_t max_misses, double motion_margin)
+{
+    tracking_enabled_ = enabled;
+    tracking_max_misses_ = MAX(max_misses, 1u);
+    tracking_motion_margin_ = MAX(motion_margin, 0.0);
 
-    int offset = -1;
+    resetTracking();
+}
 
-    // check the relative angles against the exemplar within a +/-0.25 rad tolerance
-    // find an offset such that the point deltas match the exemplar deltas relative to
-    // the given starting offset
-    for (int j = 0; j < point_deltas.size(); ++j) {
-        bool found = true;
-        
-        for (int k = 0; k < sizeof(finder_deltas) / sizeof(double); ++k) {
-            double pointRatio = point_deltas[(j + k) % point_deltas.size()];
-            
-            double lower_bound = finder_deltas[k] - 0.25;
-            double upper_bound = finder_deltas[k] + 0.25;
-            
-            if (pointRatio < lower_bound) {
-                found = false;
-                break;
-            }
-            else if (pointRatio > upper_bound) {
-                found = false;
-                break;
-            }
-        }
-        
-        if (found) {
-            offset = j;
-            break;
-        }
-    }
+void KikCodeScanner::resetTracking()
+{
+    tracking_.valid = false;
+    tracking_.misses = 0;
+}
 
-    END_DEBUG_TIMING(timing, efp_check_ratio);
-    END_DEBUG_TIMING(timing, efp);
+void KikCodeScanner::setLocalThreshold(bool enabled)
+{
+    local_threshold_enabled_ = enabled;
+}
 
-    // if we couldn't find an offset that matches the data, we don't have a match
-    if (offset < 0) {
-        return false;
-    }
+void KikCodeScanner::setValidation(bool enabled)
+{
+    validation_enabled_ = enabled;
+}
 
-    // we have a match! load our finder points into the output for the next step
-    for (int j = 0; j < finder_points.size(); ++j) {
-        out_finder_points.push_back(finder_points[(j + offset) % finder_points.size()]);
-    }
+void KikCodeScanner::setAccumulation(bool enabled, uint32_t max_frames, uint32_t max_misses)
+{
+    accumulation_enabled_ = enabled;
+    accumulation_max_frames_ = MAX(max_frames, 1u);
+    accumulation_max_misses_ = MAX(max_misses, 1u);
 
-    return true;
+    resetAccumulation();
 }
 
-/**
- * Given an 8-bit, greyscale image, find an object within the image conforming to the Kik code specification.
- * We're looking for a circle, surrounded by a finder patter, surrounded by data rings, that's it.
- * 
- * If a Kik code is found, the 35 bytes contained in out_data will contain the data from the Kik code
- * that was found. That data can be decoded using other methods. Other output variables describing the scene
- * are used for debugging or aesthetic flourishes as a result of the scanning process and will be set appropriately.
- * 
- * @returns True iff a conforming Kik code has been found in the image. Note that this does not require the
- * Kik code to be properly encoded, just properly structured visually.
- */
-bool detectKikCode(Mat &greyscale, Mat *out_progress, uint32_t device_quality, uint8_t *out_data, uint32_t *out_x, uint32_t *out_y, uint32_t *out_scale, Mat *transform, DebugTiming *timing, bool output_snapshots)
+void KikCodeScanner::setPyramid(bool enabled)
 {
-    if (timing) {
-        memset(timing, 0, sizeof(DebugTiming));
-    }
+    pyramid_enabled_ = enabled;
+}
 
-    // slow mode cuts down some operations and also decreases scanning results
-    // but is necessary for some crumby devices
-    bool in_slow_mode = device_quality < SCAN_DEVICE_QUALITY_HIGH;
+void KikCodeScanner::setTimeBudget(uint32_t budget_us)
+{
+    budget_us_ = budget_us;
+}
 
-    // the target buffer for the resulting scan data (if successful)
-    uint8_t scan_data[KIK_CODE_BYTE_COUNT];
+/**
+ * Starts the time budget of a frame.
+ */
+void KikCodeScanner::startBudget()
+{
+    deadline_ = budget_us_ > 0 ? getTimestamp() + budget_us_ : 0;
+    search_exhaustive_ = true;
+}
 
-    START_DEBUG_TIMING(total);
+bool KikCodeScanner::pastDeadline() const
+{
+    return deadline_ != 0 && getTimestamp() >= deadline_;
+}
 
-    double scaling_rate = MIN(greyscale.rows, greyscale.cols) / 480.0;
+void KikCodeScanner::setQualityGate(bool enabled, uint32_t min_sharpness, uint32_t max_hash_distance)
+{
+    quality_gate_enabled_ = enabled;
+    quality_min_sharpness_ = min_sharpness;
+    quality_max_hash_distance_ = max_hash_distance;
+    failed_hash_valid_ = false;
+}
 
-    double finder_deltas[FINDER_POINT_COUNT - 1];
-    computeFinderDeltas(finder_deltas);
+int KikCodeScanner::resultCode(size_t count) const
+{
+    switch (frame_status_) {
+        case SCAN_FRAME_BLURRED:
+            return KIK_CODE_SCAN_RESULT_BLURRED;
 
-    bool found = false;
+        case SCAN_FRAME_UNCHANGED:
+            return KIK_CODE_SCAN_RESULT_UNCHANGED;
+    }
 
-    Mat blurry;
-    Mat progress;
-    Mat whitish;
-    Mat blackish;
+    return count > 0 ? KIK_CODE_SCAN_RESULT_SUCCESS : KIK_CODE_SCAN_RESULT_ERROR;
+}
 
-    // we switch to an inverted scheme (dark is high, light is low) if the
-    // center ellipse is dark, but we don't want to compute the extra threshold everytime
-    // so we only do this when necessary
-    bool blackish_created = false;
+void KikCodeScanner::setAdaptiveResolution(bool enabled, uint32_t min_edge, uint32_t max_edge)
+{
+    adaptive_enabled_ = enabled;
+    adaptive_min_edge_ = MAX(min_edge, 1u);
+    adaptive_max_edge_ = MAX(max_edge, adaptive_min_edge_);
 
-    const int minimum_ellipse_contour_size = 22 * scaling_rate;
-    const int ellipse_edge_tolerance = 5 * scaling_rate;
-    const int adaptive_threshold_width = in_slow_mode ? 13 : 19;
+    resetAdaptiveResolution();
+}
 
-    if (out_progress) {
-        Mat rgb_colour;
-        
-        cvtColor(greyscale, rgb_colour, cv::COLOR_GRAY2RGB);
+void KikCodeScanner::resetAdaptiveResolution()
+{
+    resolution_.edge = 0;
+    resolution_.code_size = 0.0;
+    resolution_.miss_rate = 0.0;
+}
 
-        progress = rgb_colour;
+void KikCodeScanner::resetAccumulation()
+{
+    for (size_t i = 0; i < ACCUMULATOR_COUNT; ++i) {
+        accumulators_[i].valid = false;
     }
+}
 
-    START_DEBUG_TIMING(unsharp_image);
+/**
+ * Adds the samples of every code found in a frame to the accumulator following that code, and
+ * replaces the data of any code that can't be corrected on its own with the data corrected from
+ * its accumulated samples, if that works. With validation enabled, codes that can't be corrected
+ * either way are removed from the results.
+ *
+ * @returns The number of results left.
+ */
+size_t KikCodeScanner::accumulate(KikCodeScanResult *results, size_t result_count)
+{
+    size_t valid_count = 0;
 
-    // sharpen up the edges of our image to get more accurate blobs
-    if (!in_slow_mode) {
-        unsharpMask(greyscale);
-        unsharpMask(greyscale);
+    for (size_t i = 0; i < ACCUMULATOR_COUNT; ++i) {
+        if (accumulators_[i].valid && ++accumulators_[i].misses > accumulation_max_misses_) {
+            accumulators_[i].valid = false;
+        }
+    }
+
+    for (size_t r = 0; r < result_count; ++r) {
+        KikCodeScanResult &result = results[r];
+        const ModuleMargins &margins = result_margins_[r];
+
+        Point2f center(result.x, result.y);
+        int nearest = nearestAccumulator(center, result.scale, 0);
+        SoftAccumulator *accumulator = nearest >= 0 ? &accumulators_[nearest] : nullptr;
+
+        uint8_t data[KIK_CODE_TOTAL_BYTE_COUNT];
+        memcpy(data, result.data, sizeof(data));
+
+        bool readable = KikCode::correct(data, result.confidence);
+
+        // a new code, or one that reads on its own: start over from this frame, so that nothing of
+        // an earlier code (or of frames with glare that has since moved) lingers
+        if (!accumulator || readable) {
+            if (!accumulator) {
+                accumulator = &accumulators_[0];
+
+                for (size_t i = 0; i < ACCUMULATOR_COUNT; ++i) {
+                    if (!accumulators_[i].valid) {
+                        accumulator = &accumulators_[i];
+                        break;
+                    }
+
+                    if (accumulators_[i].misses > accumulator->misses) {
+                        accumulator = &accumulators_[i];
+                    }
+                }
+            }
+
+            accumulator->valid = true;
+            accumulator->frames = 0;
+        }
+
+        accumulator->center = center;
+        accumulator->misses = 0;
+
+        addFrame(*accumulator, margins);
+
+        if (readable) {
+            memcpy(result.data, data, sizeof(data));
+        }
+        else if (accumulator->frames > 1) {
+            readable = correctAccumulated(*accumulator, result);
+        }
+
+        if (readable || !validation_enabled_) {
+            results[valid_count++] = result;
+        }
+    }
+
+    return valid_count;
+}
+
+/**
+ * Finds the accumulator of the code centred at center, in working-resolution coordinates of the
+ * full frame. The same code sits close to where it was last seen, so that's the closest one less
+ * than half the code's size away. Every code's modules are sampled in the same object-space order,
+ * so the samples of different frames line up. Accumulators that pending_misses more misses would
+ * drop are passed over.
+ *
+ * @returns The index of the accumulator, -1 if there is none
+ */
+int KikCodeScanner::nearestAccumulator(Point2f center, double scale, uint32_t pending_misses) const
+{
+    int nearest = -1;
+    double radius = scale / 2.0;
+    double best_distance = radius * radius;
+
+    for (size_t i = 0; i < ACCUMULATOR_COUNT; ++i) {
+        const SoftAccumulator &accumulator = accumulators_[i];
+
+        if (!accumulator.valid || accumulator.misses + pending_misses > accumulation_max_misses_) {
+            continue;
+        }
+
+        Point2f delta = accumulator.center - center;
+        double distance = delta.dot(delta);
+
+        if (distance < best_distance) {
+            best_distance = distance;
+            nearest = (int)i;
+        }
+    }
+
+    return nearest;
+}
+
+/**
+ * Averages a frame's module margins into an accumulator: a plain average until max_frames, a
+ * moving one after that.
+ */
+void KikCodeScanner::addFrame(SoftAccumulator &accumulator, const ModuleMargins &margins) const
+{
+    accumulator.frames = MIN(accumulator.frames + 1, accumulation_max_frames_);
+
+    float weight = 1.0f / accumulator.frames;
+
+    for (size_t j = 0; j < DATA_MODULE_COUNT; ++j) {
+        if (accumulator.frames == 1) {
+            accumulator.margins[j] = margins.values[j];
+        }
+        else {
+            accumulator.margins[j] += (margins.values[j] - accumulator.margins[j]) * weight;
+        }
+    }
+}
+
+/**
+ * Checks, while candidates are still being searched, whether one that doesn't correct on its own
+ * would once accumulate() adds it to the frames before it. Only reads the accumulators, so that
+ * candidates can be checked in parallel.
+ */
+bool KikCodeScanner::readableAccumulated(Point2f center, double scale, const ModuleMargins &margins) const
+{
+    // accumulate() counts this frame as a miss for every accumulator before matching any
+    int nearest = nearestAccumulator(center, scale, 1);
+
+    if (nearest < 0) {
+        return false;
+    }
+
+    SoftAccumulator accumulator = accumulators_[nearest];
+    KikCodeScanResult result;
+
+    addFrame(accumulator, margins);
+
+    return accumulator.frames > 1 && correctAccumulated(accumulator, result);
+}
+
+/**
+ * Rebuilds a code from an accumulator's averaged samples and writes its data and confidence to
+ * result if it can be corrected.
+ */
+bool KikCodeScanner::correctAccumulated(const SoftAccumulator &accumulator, KikCodeScanResult &result) const
+{
+    uint8_t data[KIK_CODE_TOTAL_BYTE_COUNT];
+
+    // again a byte is only as reliable as its least reliable module
+    uint8_t confidence[KIK_CODE_TOTAL_BYTE_COUNT];
+
+    memset(data, 0, sizeof(data));
+    memset(confidence, 255, sizeof(confidence));
+
+    for (size_t j = 0; j < DATA_MODULE_COUNT; ++j) {
+        float margin = accumulator.margins[j];
+
+        if (margin > 0.0f) {
+            data[j / 8] |= 0x1 << (j % 8);
+        }
+
+        confidence[j / 8] = MIN(confidence[j / 8], saturate_cast<uint8_t>(fabs(margin)));
+    }
+
+    if (!KikCode::correct(data, confidence)) {
+        return false;
+    }
+
+    memcpy(result.data, data, sizeof(data));
+    memcpy(result.confidence, confidence, sizeof(confidence));
+
+    return true;
+}
+
+void KikCodeScanner::setWorkerThreads(size_t thread_count)
+{
+    if (thread_count > 0) {
+        pool_.reset(new WorkerPool(thread_count));
+    }
+    else {
+        pool_.reset();
+    }
+
+    // worker 0 (the scanning thread) always has scratch space, the serial search uses it too
+    scratch_.resize(pool_ ? pool_->workerCount() : 1);
+
+    for (size_t i = 0; i < scratch_.size(); ++i) {
+        scratch_[i].scene_corners.resize(object_finder_points_.size());
+        scratch_[i].scene_points.resize(object_data_points_.size());
+    }
+}
+
+/**
+ * Computes the region of the full-resolution frame to search while tracking: the bounding box of
+ * the last detection's outer data ring, projected through its homography, grown by the motion
+ * margin on every side.
+ *
+ * @returns False if there is nothing to track or the region would cover most of the frame anyway.
+ */
+bool KikCodeScanner::trackingRegion(Size frame_size, Size working_size, Rect *out_region) const
+{
+    const size_t outer_ring_size = 32 + 8 * 5;
+
+    Matx31d first = tracking_.homography * Matx31d(object_data_points_.back().x, object_data_points_.back().y, 1.0);
+
+    double min_x = first(0) / first(2);
+    double max_x = min_x;
+    double min_y = first(1) / first(2);
+    double max_y = min_y;
+
+    for (size_t i = object_data_points_.size() - outer_ring_size; i < object_data_points_.size(); ++i) {
+        Matx31d p = tracking_.homography * Matx31d(object_data_points_[i].x, object_data_points_[i].y, 1.0);
+
+        if (p(2) == 0.0) {
+            return false;
+        }
+
+        min_x = MIN(min_x, p(0) / p(2));
+        max_x = MAX(max_x, p(0) / p(2));
+        min_y = MIN(min_y, p(1) / p(2));
+        max_y = MAX(max_y, p(1) / p(2));
+    }
+
+    double margin = tracking_motion_margin_ * MAX(max_x - min_x, max_y - min_y);
+
+    // working-resolution coordinates back to full-resolution frame coordinates
+    double scale_x = (double)frame_size.width / working_size.width;
+    double scale_y = (double)frame_size.height / working_size.height;
+
+    Rect region(Point2i((int)floor((min_x - margin) * scale_x), (int)floor((min_y - margin) * scale_y)),
+                Point2i((int)ceil((max_x + margin) * scale_x), (int)ceil((max_y + margin) * scale_y)));
+
+    region &= Rect(Point2i(0, 0), frame_size);
+
+    if (region.width <= 0 || region.height <= 0) {
+        return false;
+    }
+
+    // searching a crop only pays off if it is meaningfully smaller than the frame
+    if (region.area() > 0.75 * frame_size.area()) {
+        return false;
+    }
+
+    *out_region = region;
+
+    return true;
+}
+
+void KikCodeScanner::unsharpMask(cv::Mat &im)
+{
+    cv::GaussianBlur(im, blurred_, cv::Size(0, 0), 2);
+    cv::addWeighted(im, 1.5, blurred_, -0.5, 0, im);
+}
+
+/**
+ * For a specific, candidate ellipse, try to find the components of the orientation ring and 
+ * determine the actual orientation of the code
+ *
+ * When this method completes, if an orientation ring was found, out_finder_points will
+ * be populated with a representation of the center of each bit sequence in the finder pattern
+ *
+ * @returns True iff the orientation ring was present, containing the correct pattern of bits
+ */
+bool KikCodeScanner::extractFinderPoints(CandidateScratch &scratch, int ellipse_id, bool check_high, RotatedRect inner_ring, bool debug)
+{
+#if !DEBUGGING
+    (void)ellipse_id;
+    (void)debug;
+#endif
+
+    TRACE_SPAN(efp);
+
+    TRACE_SPAN(efp_compute_offset);
+
+    // the finder deltas are computed once when the scanner is constructed
+    const double *finder_deltas = finder_deltas_;
+    const size_t finder_delta_count = FINDER_POINT_COUNT - 1;
+
+    TRACE_SPAN_END(efp_compute_offset);
+
+    vector<FinderPoint> &finder_points = scratch.finder_candidates;
+    finder_points.clear();
+    scratch.finder_points.clear();
+
+    // start by masking off the region where we expect to find the finder
+    // ring (between 1.22 and 1.525 times the size of the inner circle)
+    inner_ring.size.width *= 1.525;
+    inner_ring.size.height *= 1.525;
+
+    // everything below only looks at the bounding rectangle of the outer finder ellipse
+    // (plus a small margin so blobs never touch the edge of the view), so the cost of a
+    // candidate scales with the size of the code rather than the size of the frame
+    Rect roi = inner_ring.boundingRect();
+    roi.x -= 2;
+    roi.y -= 2;
+    roi.width += 4;
+    roi.height += 4;
+    roi &= Rect(0, 0, whitish_.width(), whitish_.height());
+
+    if (roi.width <= 0 || roi.height <= 0) {
+        return false;
     }
 
+    const Point2f roi_offset(roi.x, roi.y);
+
+    // views onto the worker's scratch buffers, sized to the region of interest
+    Mat finder_point_range;
+    Mat candidate_region;
+
+    fitBuffer(scratch.finder_point_range_storage, finder_point_range, roi.size());
+    fitBuffer(scratch.candidate_region_storage, candidate_region, roi.size());
+
+    finder_point_range.setTo(Scalar(0));
+
+    RotatedRect local_ring = inner_ring;
+    local_ring.center -= roi_offset;
+    
+    TRACE_SPAN(efp_ellipse_region);
+    ellipse(finder_point_range, local_ring, Scalar(255, 255, 255), -1);
+    
+    inner_ring.size.width *= 0.805;
+    inner_ring.size.height *= 0.805;
+    local_ring.size = inner_ring.size;
+    
+    ellipse(finder_point_range, local_ring, Scalar(0, 0, 0), -1);
+
 #if DEBUGGING
-    if (output_snapshots) {
-        imwrite("01_sharpend.jpg", greyscale);
+    if (debug) {
+        char filename[128];
+
+        sprintf(filename, "07_%d_candidates.jpg", ellipse_id);
+
+        imwrite(filename, finder_point_range);
+    }
+#endif
+    
+    TRACE_SPAN_END(efp_ellipse_region);
+    Point2i last_point;
+
+    TRACE_SPAN(efp_and);
+
+    // mask off the thresholded image to only look at the candidate region. Dark codes are only
+    // ever thresholded around the candidate
+    if (!check_high) {
+        local_threshold_.dark(roi.x, roi.y, roi.width, roi.height, blackish_radius_, BLACKISH_DELTA, candidate_region.ptr<uint8_t>(), candidate_region.step);
+        bitwise_and(candidate_region, finder_point_range, candidate_region);
+    }
+    else {
+        whitish_.unpackMasked(roi.x, roi.y, roi.width, roi.height, finder_point_range.ptr<uint8_t>(), finder_point_range.step,
+                              candidate_region.ptr<uint8_t>(), candidate_region.step);
+    }
+    TRACE_SPAN_END(efp_and);
+
+    vector<vector<Point2i> > &contours = scratch.finder_contours;
+    vector<Vec4i> &hierarchy = scratch.finder_hierarchy;
+    
+    // detect all blobs within the candidate region, offsetting them back into frame coordinates
+    TRACE_SPAN(efp_contours);
+    findContours(candidate_region, contours, hierarchy, cv::RETR_CCOMP, cv::CHAIN_APPROX_SIMPLE, roi.tl());
+    TRACE_SPAN_END(efp_contours);
+    
+    // compute the image moments for each blob in the candidate region, we use these
+    // moments to look and the relative angles between the **centers** of each blob
+    TRACE_SPAN(efp_moments);
+    vector<Point2f> &mc = scratch.finder_centers;
+    mc.assign(contours.size(), Point2f());
+
+    for (int i = 0; i < contours.size(); ++i) {
+        vector<Point2i> &contour = contours[i];
+
+        if (contour.size() > 1) {
+            Moments mu = moments(contour, false);
+            mc[i] = Point2f(mu.m10/mu.m00 , mu.m01/mu.m00);
+        }
+    }
+    TRACE_SPAN_END(efp_moments);
+
+#if DEBUGGING
+    Mat finder_point_extraction;
+
+    if (debug) {
+        finder_point_extraction = Mat::zeros(whitish_.height(), whitish_.width(), CV_8UC3);
+        char filename[128];
+
+        Mat finder_point_range = Mat::zeros(whitish_.height(), whitish_.width(), CV_8UC3);
+
+        sprintf(filename, "08_%d_finder_contours.jpg", ellipse_id);
+
+        for (int i = 0; i < contours.size(); ++i) {
+            drawContours(finder_point_range, contours, i, Scalar(rand() & 255, rand() & 255, rand() & 255), 1, 8, hierarchy, 0, Point2i());
+        }
+
+        imwrite(filename, finder_point_range);
     }
 #endif
 
-    END_DEBUG_TIMING(timing, unsharp_image);
+    // set up the finder point extraction process by computing the vector from the center
+    // of the candidate ellipse to the center of each blob. From this vector, we care about
+    // the angle and the distance from the center point
+    TRACE_SPAN(efp_extraction);
+    for (int i = 0; i < contours.size(); ++i) {
+        vector<Point2i> &contour = contours[i];
+        
+        Point2i point = mc[i];
+        
+        double dist = sqrt(pow(point.x - last_point.x, 2.0) + pow(point.y - last_point.y, 2.0));
+        
+        if (dist < 2) {
+            continue;
+        }
+        
+        last_point = point;
+        
+        if (contour.size() > 1) {
+            Point2i local((int)mc[i].x - roi.x, (int)mc[i].y - roi.y);
+
+            if (mc[i].y > 0 && mc[i].x > 0 && local.x >= 0 && local.y >= 0 && local.x < roi.width && local.y < roi.height) {
+                if (finder_point_range.at<char>(local.y, local.x) != 0) {
+                    FinderPoint finder;
+                    
+                    finder.x = mc[i].x;
+                    finder.y = mc[i].y;
+                    
+                    finder.dx = finder.x - inner_ring.center.x;
+                    finder.dy = finder.y - inner_ring.center.y;
+                    
+                    finder.contourIndex = i;
+
+                    finder.contourSize = contour.size();
+                    
+                    finder.dist = sqrt(finder.dx * finder.dx + finder.dy * finder.dy);
+                    
+                    finder.angle = atan2(finder.dy, finder.dx);
+                    
+                    finder_points.push_back(finder);
+                }
+            }
+        }
+    }
+    TRACE_SPAN_END(efp_extraction);
+    
+    TRACE_SPAN(efp_filter_and_sort);
+    if (finder_points.size() > 0) {
+        // disard small shards that were erroneously picked up
+        sort(finder_points.begin(), finder_points.end(), compareFinderPointsSize);
+
+        int p90_size = finder_points[finder_points.size() * 0.9].contourSize;
+        
+        for (int i = 0; i < finder_points.size(); ++i) {
+            if (finder_points[i].contourSize < p90_size / 5) {
+                finder_points.erase(finder_points.begin() + i);
+
+                --i;
+            }
+        }
+
+#if DEBUGGING
+        if (debug) {
+            for (int i = 0; i < finder_points.size(); ++i) {
+                FinderPoint finder = finder_points[i];
+                Scalar colour = Scalar(rand() & 255, rand() & 255, rand() & 255);
+
+                drawContours(finder_point_extraction, contours, finder.contourIndex, colour, 1, 8, hierarchy, 0, Point2i());
+                circle(finder_point_extraction, Point2i(finder.x, finder.y), 2, colour, -1);
+            }
+        }
+#endif
+    }
+
+#if DEBUGGING
+    if (debug) {
+        char filename[128];
+
+        sprintf(filename, "09_%d_finder_point_extraction.jpg", ellipse_id);
+
+        imwrite(filename, finder_point_extraction);
+    }
+#endif
+
+    // if we have too few or too many finder points (we need 9), we couldn't have
+    // possibly found an orientation ring
+    if (finder_points.size() != finder_delta_count + 1) {
+        return false;
+    }
+    
+    // sort the finder points into a clockwise winding based on the angle of the computed vector
+    sort(finder_points.begin(), finder_points.end(), compareFinderPoints);
+    TRACE_SPAN_END(efp_filter_and_sort);
+    
+    vector<double> &point_deltas = scratch.point_deltas;
+    point_deltas.resize(finder_points.size());
+    
+    TRACE_SPAN(efp_check_ratio);
+    // compute the relative angles between each neighbouring pair of finder points
+    for (int j = 0; j < finder_points.size(); ++j) {
+        point_deltas[j] = finder_points[(j + 1) % finder_points.size()].angle - finder_points[j].angle;
+        
+        while (point_deltas[j] < 0.0) {
+            point_deltas[j] += 2 * M_PI;
+        }
+    }
+
+    int offset = -1;
+
+    // check the relative angles against the exemplar within a +/-0.25 rad tolerance
+    // find an offset such that the point deltas match the exemplar deltas relative to
+    // the given starting offset
+    for (int j = 0; j < point_deltas.size(); ++j) {
+        bool found = true;
+        
+        for (int k = 0; k < finder_delta_count; ++k) {
+            double pointRatio = point_deltas[(j + k) % point_deltas.size()];
+            
+            double lower_bound = finder_deltas[k] - 0.25;
+            double upper_bound = finder_deltas[k] + 0.25;
+            
+            if (pointRatio < lower_bound) {
+                found = false;
+                break;
+            }
+            else if (pointRatio > upper_bound) {
+                found = false;
+                break;
+            }
+        }
+        
+        if (found) {
+            offset = j;
+            break;
+        }
+    }
+
+    TRACE_SPAN_END(efp_check_ratio);
+    TRACE_SPAN_END(efp);
+
+    // if we couldn't find an offset that matches the data, we don't have a match
+    if (offset < 0) {
+        return false;
+    }
+
+    // we have a match! load our finder points into the output for the next step
+    for (int j = 0; j < finder_points.size(); ++j) {
+        scratch.finder_points.push_back(finder_points[(j + offset) % finder_points.size()]);
+    }
+
+    return true;
+}
+
+/**
+ * Moves a result found in a crop at (offset_x, offset_y) back into the coordinates of the frame.
+ */
+static void offsetResult(KikCodeScanResult &result, double offset_x, double offset_y)
+{
+    result.x += (unsigned int)cvRound(offset_x);
+    result.y += (unsigned int)cvRound(offset_y);
+
+    // the transform maps scene to object space, so undo the offset before applying it
+    Matx33d transform(result.transform);
+    Matx33d untranslate(1, 0, -offset_x, 0, 1, -offset_y, 0, 0, 1);
+
+    transform = transform * untranslate;
+
+    memcpy(result.transform, transform.val, sizeof(result.transform));
+}
+
+size_t KikCodeScanner::scan(const Mat &frame, uint32_t device_quality, KikCodeScanResult *out_results, size_t max_results)
+{
+    if (max_results == 0) {
+        return 0;
+    }
+
+    TRACE_SPAN(scan);
+
+    startBudget();
+
+    frame_status_ = SCAN_FRAME_ACCEPTED;
+    last_working_size_ = Size();
+
+    FrameQuality quality = {};
+
+    if (quality_gate_enabled_) {
+        TRACE_SPAN(quality_gate);
+
+        kikCodeMeasureFrameQuality(frame.ptr<uint8_t>(), frame.step, frame.cols, frame.rows, &quality);
+
+        if (quality.sharpness < quality_min_sharpness_) {
+            frame_status_ = SCAN_FRAME_BLURRED;
+        }
+        else if (failed_hash_valid_ && kikCodeFrameHashDistance(quality.hash, failed_hash_) <= (int)quality_max_hash_distance_) {
+            frame_status_ = SCAN_FRAME_UNCHANGED;
+        }
+
+        TRACE_SPAN_END(quality_gate);
+        TRACE_COUNT(sharpness, quality.sharpness);
+
+        // a rejected frame leaves the hash alone. The hash compares the brightness of whole cells,
+        // which blur barely changes, so a blurred frame would turn away the sharp ones that follow
+        // it once the camera focuses, and each of those would then turn away the next
+        if (frame_status_ != SCAN_FRAME_ACCEPTED) {
+            return 0;
+        }
+    }
+
+    size_t found_count = scanFrame(frame, device_quality, out_results, max_results);
+
+    if (quality_gate_enabled_) {
+        failed_hash_valid_ = found_count == 0;
+        failed_hash_ = quality.hash;
+    }
+
+    return found_count;
+}
+
+/**
+ * Scans a frame the quality gate let through.
+ */
+size_t KikCodeScanner::scanFrame(const Mat &frame, uint32_t device_quality, KikCodeScanResult *out_results, size_t max_results)
+{
+    double scale = 0.0;
+
+    Size size = workingSize(frame.cols, frame.rows, device_quality, &scale);
+
+    reserve(frame.cols, frame.rows, device_quality);
+
+    last_working_size_ = size;
+
+    // detection thresholds are tuned relative to the size of the whole working image, they
+    // must not shrink when only a crop of it is searched
+    double scaling_rate = MIN(size.width, size.height) / 480.0;
+
+    size_t found_count = 0;
+
+    candidate_origin_ = Point2f(0, 0);
+    candidate_frame_size_ = size;
+
+    if (tracking_enabled_ && tracking_.valid
+            && (tracking_.frame_size != frame.size() || tracking_.device_quality != device_quality)) {
+        resetTracking();
+    }
+
+    Rect region;
+
+    // a crop around one code can't find the others, so tracking only applies to single-code scans
+    if (tracking_enabled_ && tracking_.valid && max_results == 1 && trackingRegion(frame.size(), tracking_.working_size, &region)) {
+        // scan only the crop around the last detection, at the same working resolution
+        // the full frame would be scanned at
+        double factor_x = (double)size.width / frame.cols;
+        double factor_y = (double)size.height / frame.rows;
+
+        Size crop_size(MAX(1, cvRound(region.width * factor_x)), MAX(1, cvRound(region.height * factor_y)));
+        Mat &working = workingBuffer(crop_size);
+
+        if (scale > 0.0) {
+            resize(frame(region), working, crop_size, 0, 0, cv::INTER_AREA);
+        }
+        else {
+            frame(region).copyTo(working);
+        }
+
+        candidate_origin_ = Point2f(region.x * factor_x, region.y * factor_y);
+
+        found_count = detectRegion(working, scaling_rate, nullptr, device_quality, out_results, max_results, false);
+
+        if (found_count > 0) {
+            offsetResult(out_results[0], region.x * factor_x, region.y * factor_y);
+        }
+        else if (++tracking_.misses >= tracking_max_misses_) {
+            resetTracking();
+        }
+
+        if (found_count == 0) {
+            if (accumulation_enabled_) {
+                accumulate(out_results, 0);
+            }
+
+            adaptResolution(out_results, 0, frame.size(), size, device_quality);
+
+            return 0;
+        }
+    }
+    else if (pyramid_enabled_) {
+        found_count = scanPyramid(frame, size, scaling_rate, device_quality, out_results, max_results);
+    }
+    else {
+        Mat &working = workingBuffer(size);
+
+        // the detector can sharpen its input in place, so it always runs on the scanner's own
+        // working buffer rather than on the caller's frame
+        if (scale > 0.0) {
+            resize(frame, working, size, 0, 0, cv::INTER_AREA);
+        }
+        else {
+            frame.copyTo(working);
+        }
+
+        found_count = detectRegion(working, scaling_rate, nullptr, device_quality, out_results, max_results, false);
+    }
+
+    if (accumulation_enabled_) {
+        found_count = accumulate(out_results, found_count);
+    }
+
+    // with adaptive resolution the working size changes from frame to frame, so each result
+    // carries the one its coordinates are in
+    for (size_t i = 0; i < found_count; ++i) {
+        out_results[i].working_width = size.width;
+        out_results[i].working_height = size.height;
+    }
+
+    if (found_count > 0) {
+        const KikCodeScanResult &result = out_results[0];
+
+        hint_.valid = true;
+        hint_.center = Point2f((float)result.x / size.width, (float)result.y / size.height);
+        hint_.size = (double)result.scale / MAX(size.width, size.height);
+    }
+
+    if (found_count > 0 && tracking_enabled_) {
+        const KikCodeScanResult &result = out_results[0];
+
+        tracking_.valid = true;
+        tracking_.homography = Matx33d(result.transform).inv();
+        tracking_.frame_size = frame.size();
+        tracking_.working_size = size;
+        tracking_.device_quality = device_quality;
+        tracking_.misses = 0;
+    }
+
+    adaptResolution(out_results, found_count, frame.size(), size, device_quality);
+
+    return found_count;
+}
+
+/**
+ * Picks the working resolution of the next frame from the codes found in this one, which was
+ * scanned at working_size, and reports it through nextWorkingSize() and to the tracer.
+ */
+void KikCodeScanner::adaptResolution(const KikCodeScanResult *results, size_t result_count, Size frame_size, Size working_size, uint32_t device_quality)
+{
+    uint32_t working_edge = MAX(working_size.width, working_size.height);
+
+    if (adaptive_enabled_) {
+        ResolutionState &state = resolution_;
+
+        state.miss_rate += ADAPTIVE_MISS_WEIGHT * ((result_count == 0 ? 1.0 : 0.0) - state.miss_rate);
+
+        // with several codes in view, the smallest one needs the most resolution
+        if (result_count > 0) {
+            unsigned int smallest = results[0].scale;
+
+            for (size_t i = 1; i < result_count; ++i) {
+                smallest = MIN(smallest, results[i].scale);
+            }
+
+            state.code_size = (double)smallest / working_edge;
+        }
+
+        // scale the last code seen to the target size. The more frames have missed lately, the
+        // more likely it is the code moved away or there is a smaller one, so spend more of the
+        // headroom up to max_edge on finding it
+        double edge = state.code_size > 0.0 ? ADAPTIVE_TARGET_CODE_SIZE / state.code_size : qualityEdge(device_quality);
+
+        edge = MIN(MAX(edge, (double)adaptive_min_edge_), (double)adaptive_max_edge_);
+        edge += state.miss_rate * (adaptive_max_edge_ - edge);
+
+        uint32_t next_edge = (uint32_t)cvRound(edge / ADAPTIVE_EDGE_STEP) * ADAPTIVE_EDGE_STEP;
+        next_edge = MIN(MAX(next_edge, adaptive_min_edge_), adaptive_max_edge_);
+
+        if (state.edge == 0 || fabs((double)next_edge - state.edge) > ADAPTIVE_HYSTERESIS * state.edge) {
+            state.edge = next_edge;
+
+            // accumulated codes are matched by where they are in the working resolution
+            Size next_size = workingSize(frame_size.width, frame_size.height, device_quality, nullptr);
+            float ratio_x = (float)next_size.width / working_size.width;
+            float ratio_y = (float)next_size.height / working_size.height;
+
+            for (size_t i = 0; i < ACCUMULATOR_COUNT; ++i) {
+                accumulators_[i].center.x *= ratio_x;
+                accumulators_[i].center.y *= ratio_y;
+            }
+        }
+    }
+
+    next_working_size_ = workingSize(frame_size.width, frame_size.height, device_quality, nullptr);
+
+    if (kikCodeTraceActive()) {
+        TRACE_COUNT(working_edge, working_edge);
+        TRACE_COUNT(next_working_edge, MAX(next_working_size_.width, next_working_size_.height));
+        TRACE_COUNT(miss_rate, resolution_.miss_rate);
+    }
+}
+
+/**
+ * Scans frame in pyramid mode: candidates are found in a copy of the frame PYRAMID_FACTOR times
+ * smaller than the working size, with the settings of the lowest device quality, then each one is
+ * searched for at the working size in a crop of the frame around the code it would be the centre
+ * of. The crop is searched in full, since the centre found at the coarse size is too rough to
+ * place the finder ring with, but with the local threshold window of the whole working frame.
+ *
+ * @returns The number of results written to out_results, in working-resolution coordinates
+ */
+size_t KikCodeScanner::scanPyramid(const Mat &frame, Size size, double scaling_rate, uint32_t device_quality, KikCodeScanResult *out_results, size_t max_results)
+{
+    TRACE_SPAN(pyramid);
+
+    Size coarse_size(MAX(1, size.width / PYRAMID_FACTOR), MAX(1, size.height / PYRAMID_FACTOR));
+    Mat &coarse = workingBuffer(coarse_size);
+
+    resize(frame, coarse, coarse_size, 0, 0, cv::INTER_AREA);
+
+    double coarse_scaling_rate = MIN(coarse_size.width, coarse_size.height) / 480.0;
+
+    // the coarse copy is a whole frame of its own, the crops below are parts of the working one
+    candidate_frame_size_ = coarse_size;
+    findCandidates(coarse, coarse_scaling_rate, nullptr, SCAN_DEVICE_QUALITY_LOW, false);
+    candidate_frame_size_ = size;
+
+    // searching the crops replaces the scanner's candidates
+    vector<RotatedRect> &candidates = pyramid_candidates_;
+    candidates.assign(ellipses_.begin(), ellipses_.end());
+
+    if (pyramid_results_.size() < max_results) {
+        pyramid_results_.resize(max_results);
+        pyramid_margins_.resize(max_results);
+    }
+
+    // frame pixels per coarse pixel, and working pixels per frame pixel
+    double coarse_x = (double)frame.cols / coarse_size.width;
+    double coarse_y = (double)frame.rows / coarse_size.height;
+    double factor_x = (double)size.width / frame.cols;
+    double factor_y = (double)size.height / frame.rows;
+
+    // every crop is a scan of its own, so with a budget the likely ones go first
+    if (budget_us_ > 0) {
+        orderCandidates(candidates, nullptr, Point2f(0, 0), (double)size.width / coarse_size.width);
+    }
+
+    size_t found_count = 0;
+
+    for (size_t i = 0; i < candidates.size() && found_count < max_results; ++i) {
+        if (pastDeadline()) {
+            search_exhaustive_ = false;
+
+            TRACE_COUNT(candidates_skipped, candidates.size() - i);
+
+            break;
+        }
+
+        const RotatedRect &candidate = candidates[i];
+        Point2f center((candidate.center.x + 0.5) * coarse_x - 0.5, (candidate.center.y + 0.5) * coarse_y - 0.5);
+
+        if (overlapsResult(Point2f(center.x * factor_x, center.y * factor_y), out_results, found_count)) {
+            continue;
+        }
+
+        double radius = MAX(candidate.size.width * coarse_x, candidate.size.height * coarse_y) / KIK_CODE_INNER_RING_RATIO / 2.0;
+        radius *= 1.0 + PYRAMID_CROP_MARGIN;
+
+        Rect region(Point2i((int)floor(center.x - radius), (int)floor(center.y - radius)),
+                    Point2i((int)ceil(center.x + radius), (int)ceil(center.y + radius)));
+
+        region &= Rect(Point2i(0, 0), frame.size());
+
+        if (region.width <= 0 || region.height <= 0) {
+            continue;
+        }
+
+        Size crop_size(MAX(1, cvRound(region.width * factor_x)), MAX(1, cvRound(region.height * factor_y)));
+        Mat &working = workingBuffer(crop_size);
+
+        if (crop_size != region.size()) {
+            resize(frame(region), working, crop_size, 0, 0, cv::INTER_AREA);
+        }
+        else {
+            frame(region).copyTo(working);
+        }
+
+        candidate_origin_ = Point2f(region.x * factor_x, region.y * factor_y);
+
+        findCandidates(working, scaling_rate, nullptr, device_quality, false);
+
+        size_t crop_count = searchCandidates(working, &pyramid_results_[0], max_results, false);
+
+        // the crop can also take in codes that were already found from an earlier candidate
+        for (size_t j = 0; j < crop_count && found_count < max_results; ++j) {
+            KikCodeScanResult &result = pyramid_results_[j];
+
+            offsetResult(result, region.x * factor_x, region.y * factor_y);
+
+            if (overlapsResult(Point2f(result.x, result.y), out_results, found_count)) {
+                continue;
+            }
+
+            out_results[found_count] = result;
+            pyramid_margins_[found_count] = result_margins_[j];
+            ++found_count;
+        }
+    }
+
+    copy(pyramid_margins_.begin(), pyramid_margins_.begin() + found_count, result_margins_.begin());
+
+    TRACE_SPAN_END(pyramid);
+    return found_count;
+}
+
+bool KikCodeScanner::detect(Mat &greyscale, Mat *out_progress, uint32_t device_quality, uint8_t *out_data, uint32_t *out_x, uint32_t *out_y, uint32_t *out_scale, Mat *transform, bool output_snapshots)
+{
+    double scaling_rate = MIN(greyscale.rows, greyscale.cols) / 480.0;
+
+    KikCodeScanResult result;
+
+    startBudget();
+
+    candidate_origin_ = Point2f(0, 0);
+    candidate_frame_size_ = greyscale.size();
+
+    if (detectRegion(greyscale, scaling_rate, out_progress, device_quality, &result, 1, output_snapshots) == 0) {
+        return false;
+    }
+
+    memcpy(out_data, result.data, KIK_CODE_TOTAL_BYTE_COUNT);
+
+    *out_x = result.x;
+    *out_y = result.y;
+    *out_scale = result.scale;
+    *transform = Mat(3, 3, CV_64F, result.transform).clone();
+
+    return true;
+}
+
+/**
+ * @returns True iff point lies within the footprint of one of the codes already found
+ */
+bool KikCodeScanner::overlapsResult(Point2f point, const KikCodeScanResult *results, size_t result_count) const
+{
+    for (size_t i = 0; i < result_count; ++i) {
+        double dx = point.x - (double)results[i].x;
+        double dy = point.y - (double)results[i].y;
+        double radius = results[i].scale / 2.0;
+
+        if (dx * dx + dy * dy < radius * radius) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @returns The ratio of the smallest to the largest principal moment of inertia, 1 for a circle
+ */
+static double inertiaRatio(double mu20, double mu11, double mu02)
+{
+    double denominator = sqrt(pow(2 * mu11, 2) + pow(mu20 - mu02, 2));
+    const double eps = 1e-2;
+
+    if (denominator <= eps) {
+        return 1;
+    }
+
+    double cosmin = (mu20 - mu02) / denominator;
+    double sinmin = 2 * mu11 / denominator;
+    double cosmax = -cosmin;
+    double sinmax = -sinmin;
+
+    double imin = 0.5 * (mu20 + mu02) - 0.5 * (mu20 - mu02) * cosmin - mu11 * sinmin;
+    double imax = 0.5 * (mu20 + mu02) - 0.5 * (mu20 - mu02) * cosmax - mu11 * sinmax;
+
+    return imin / imax;
+}
+
+/**
+ * Loose versions of the area, circularity and inertia checks detectRegion() makes on a contour,
+ * from the blob's measurements alone. The contour runs through the centres of the blob's edge
+ * pixels, or of the pixels around a hole, so only bounds on its area and perimeter are known here
+ * and the checks are made against those. A blob that fails here would fail on its contour.
+ */
+static bool isPotentialEllipse(const BlobAnalyzer::Blob &blob, double minimum_area, double minimum_circularity, double minimum_inertia)
+{
+    // the pixel moments of a hole are a little more squished than those of the contour around it
+    const double inertia_slack = 0.75;
+
+    // the contour around a hole encloses at most another pixel for every edge of the hole
+    double area = blob.light ? blob.filled_area : blob.filled_area + blob.perimeter;
+
+    if (area < minimum_area) {
+        return false;
+    }
+
+    // a closed contour is at least twice as long as the diagonal of its bounding box
+    int margin = blob.light ? 0 : 2;
+    double width = blob.right - blob.left + margin;
+    double height = blob.bottom - blob.top + margin;
+    double diagonal_squared = width * width + height * height;
+
+    if (diagonal_squared > 0 && CV_PI * area / diagonal_squared < minimum_circularity) {
+        return false;
+    }
+
+    double count = blob.filled_area;
+    double mu20 = blob.sum_xx - (double)blob.sum_x * blob.sum_x / count;
+    double mu11 = blob.sum_xy - (double)blob.sum_x * blob.sum_y / count;
+    double mu02 = blob.sum_yy - (double)blob.sum_y * blob.sum_y / count;
+
+    return inertiaRatio(mu20, mu11, mu02) >= minimum_inertia * inertia_slack;
+}
+
+bool KikCodeScanner::traceBlob(const BlobAnalyzer::Blob &blob, vector<Point2i> &out_contour)
+{
+    // findContours clears the edge of the region it's given. The outer boundary of a blob only
+    // touches the pixels next to it, but following the boundary around a hole looks one further
+    int margin = blob.light ? 1 : 3;
+    Rect bounds(blob.left, blob.top, blob.right - blob.left + 1, blob.bottom - blob.top + 1);
+    Rect roi = Rect(bounds.x - margin, bounds.y - margin, bounds.width + 2 * margin, bounds.height + 2 * margin)
+        & Rect(0, 0, whitish_.width(), whitish_.height());
+
+    fitBuffer(blob_region_storage_, blob_region_, roi.size());
+    whitish_.unpack(roi.x, roi.y, roi.width, roi.height, blob_region_.ptr<uint8_t>(), blob_region_.step);
+
+    vector<vector<Point2i> > &contours = blob_contours_;
+    int match = -1;
+
+    if (blob.light) {
+        // other blobs can reach into the region, but only this one spans all of it
+        findContours(blob_region_, contours, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE, roi.tl());
+
+        for (int i = 0; i < contours.size() && match < 0; ++i) {
+            if (boundingRect(contours[i]) == bounds) {
+                match = i;
+            }
+        }
+    }
+    else {
+        // every other hole in the region is either inside this one or squeezed into the margin, so
+        // the boundary around this one is the widest
+        vector<Vec4i> &hierarchy = hierarchy_;
+        int widest = 0;
+
+        findContours(blob_region_, contours, hierarchy, cv::RETR_CCOMP, cv::CHAIN_APPROX_SIMPLE, roi.tl());
+
+        for (int i = 0; i < contours.size(); ++i) {
+            if (hierarchy[i][3] < 0) {
+                continue;
+            }
+
+            Rect rect = boundingRect(contours[i]);
+
+            if (rect.area() > widest) {
+                widest = rect.area();
+                match = i;
+            }
+        }
+    }
+
+    if (match < 0) {
+        return false;
+    }
+
+    out_contour.swap(contours[match]);
+
+    return true;
+}
+
+/**
+ * Given an 8-bit, greyscale image, find objects within the image conforming to the Kik code specification.
+ * We're looking for a circle, surrounded by a finder patter, surrounded by data rings, that's it.
+ * 
+ * For each Kik code found (up to max_results), the 35 bytes in the result's data will contain the data from
+ * the Kik code that was found. That data can be decoded using other methods. Other fields describing the scene
+ * are used for debugging or aesthetic flourishes as a result of the scanning process and will be set appropriately.
+ * 
+ * @returns The number of conforming Kik codes found in the image. Note that unless validation is enabled
+ * this does not require the Kik codes to be properly encoded, just properly structured visually.
+ */
+size_t KikCodeScanner::detectRegion(Mat &greyscale, double scaling_rate, Mat *out_progress, uint32_t device_quality, KikCodeScanResult *out_results, size_t max_results, bool output_snapshots)
+{
+    TRACE_SPAN(detect_region);
+
+    findCandidates(greyscale, scaling_rate, out_progress, device_quality, output_snapshots);
+
+    size_t found_count = searchCandidates(greyscale, out_results, max_results, output_snapshots);
+
+    TRACE_SPAN_END(detect_region);
+    return found_count;
+}
+
+/**
+ * Thresholds greyscale and finds the ellipses that could be the centre of a Kik code in it, leaving
+ * them in ellipses_ for searchCandidates().
+ *
+ * @returns The number of candidates found
+ */
+size_t KikCodeScanner::findCandidates(Mat &greyscale, double scaling_rate, Mat *out_progress, uint32_t device_quality, bool output_snapshots)
+{
+#if !DEBUGGING
+    (void)output_snapshots;
+#endif
+
+    allocateBuffers(greyscale.size());
+
+    // slow mode cuts down some operations and also decreases scanning results
+    // but is necessary for some crumby devices
+    bool in_slow_mode = device_quality < SCAN_DEVICE_QUALITY_HIGH;
+
+    Mat progress;
+
+    // the threshold is produced as bytes, which is what the kernels and OpenCV write, and packed
+    // into the whitish bitplane that everything after it reads
+    Mat &contour_mat = contour_mat_;
+
+    // we switch to an inverted scheme (dark is high, light is low) if the
+    // center ellipse is dark, but we don't want to compute the extra threshold everytime
+    // so we only do this when necessary
+    local_threshold_built_ = false;
+
+    const int minimum_ellipse_contour_size = 22 * scaling_rate;
+    const int ellipse_edge_tolerance = 5 * scaling_rate;
+    const int adaptive_threshold_width = in_slow_mode ? 13 : 19;
+
+    blackish_radius_ = adaptive_threshold_width / 2;
+
+    if (out_progress) {
+        Mat rgb_colour;
+        
+        cvtColor(greyscale, rgb_colour, cv::COLOR_GRAY2RGB);
+
+        progress = rgb_colour;
+    }
+
+    TRACE_SPAN(unsharp_image);
+
+    // sharpen up the edges of our image to get more accurate blobs. The two passes of the unsharp
+    // mask are fused with the threshold below, which leaves greyscale itself untouched, so its time
+    // is all reported under unsharp_image. Everything else reads greyscale unsharpened, except
+    // in frames too small for the fused kernel
+    bool thresholded = false;
+
+    if (!in_slow_mode) {
+        thresholded = sharpen_threshold_.apply(greyscale.ptr<uint8_t>(), greyscale.step, contour_mat.ptr<uint8_t>(), contour_mat.step,
+                                               greyscale.cols, greyscale.rows, WHITISH_THRESHOLD);
+
+        // too small for the fused kernel
+        if (!thresholded) {
+            unsharpMask(greyscale);
+            unsharpMask(greyscale);
+        }
+    }
+
+    sharpen_thresholded_ = thresholded;
+
+    TRACE_SPAN_END(unsharp_image);
+
+    // determine the light vs. dark areas of the image
+    TRACE_SPAN(threshold);
+    if (!thresholded) {
+        threshold(greyscale, contour_mat, WHITISH_THRESHOLD, 255, THRESH_BINARY);
+    }
+
+    // a fixed threshold loses the light modules that fall in shadow, so also take in whatever
+    // is light for its surroundings
+    if (local_threshold_enabled_) {
+        ensureLocalThreshold(greyscale);
+
+        // sized from the whole frame, as the fixed threshold is, so that a crop of it is
+        // thresholded as the frame would be
+        whitish_local_radius_ = MIN(candidate_frame_size_.width, candidate_frame_size_.height) / WHITISH_LOCAL_WINDOW_DIVISOR;
+
+        local_threshold_.light(0, 0, greyscale.cols, greyscale.rows, whitish_local_radius_, WHITISH_LOCAL_PERCENT, WHITISH_LOCAL_FLOOR,
+                               contour_mat.ptr<uint8_t>(), contour_mat.step);
+    }
+
+    // findContours always treated the edge of the frame as dark, and so does the blob analyser
+    contour_mat.row(0).setTo(Scalar(0));
+    contour_mat.row(contour_mat.rows - 1).setTo(Scalar(0));
+    contour_mat.col(0).setTo(Scalar(0));
+    contour_mat.col(contour_mat.cols - 1).setTo(Scalar(0));
 
-    // determine the light vs. dark areas of the image
-    START_DEBUG_TIMING(threshold);
-    threshold(greyscale, whitish, 170, 255, THRESH_BINARY);
-    END_DEBUG_TIMING(timing, threshold);
+    whitish_.pack(contour_mat.ptr<uint8_t>(), contour_mat.step);
+    TRACE_SPAN_END(threshold);
 
 #if DEBUGGING
     if (output_snapshots) {
-        imwrite("02_threshold.jpg", whitish);
+        imwrite("02_threshold.jpg", contour_mat);
     }
 #endif
 
-    Mat contour_mat = whitish.clone();
-    
-    // extract the contours and blobs from the thresholded image
-    vector<vector<Point2i> > contours;
-    vector<Vec4i> hierarchy;
-    
-    START_DEBUG_TIMING(contours_1);
-    findContours(contour_mat, contours, hierarchy, cv::RETR_CCOMP, cv::CHAIN_APPROX_SIMPLE, Point2i(0, 0));
-    END_DEBUG_TIMING(timing, contours_1);
+    // the contour must be...
+    // large enough
+    const double minimum_ellipse_area = 220 * scaling_rate;
+
+    // circular enough
+    const double minimum_ellipse_circularity = 0.75;
+
+    // convex (not having a lot of concave components)
+    const double minimum_ellipse_convexity = 0.9;
+
+    // not too squished
+    const double minimum_ellipse_inertia = 0.5;
+
+    // label the blobs of the thresholded image, measuring them as they're found, and only trace
+    // the contours of the ones that could pass the checks above
+    vector<vector<Point2i> > &contours = contours_;
+    size_t contours_count = 0;
+
+    TRACE_SPAN(contours_1);
+    blob_analyzer_.analyze(whitish_);
+
+    const vector<BlobAnalyzer::Blob> &blobs = blob_analyzer_.blobs();
+
+    for (size_t i = 0; i < blobs.size(); ++i) {
+        const BlobAnalyzer::Blob &blob = blobs[i];
+
+        // the background around everything else
+        if (!blob.light && blob.touches_border) {
+            continue;
+        }
+
+        if (!isPotentialEllipse(blob, minimum_ellipse_area, minimum_ellipse_circularity, minimum_ellipse_inertia)) {
+            continue;
+        }
+
+        if (contours.size() <= contours_count) {
+            contours.resize(contours_count + 1);
+        }
+
+        if (traceBlob(blob, contours[contours_count])) {
+            ++contours_count;
+        }
+    }
+    TRACE_SPAN_END(contours_1);
 
 #if DEBUGGING
     if (output_snapshots) {
         Mat contour_debug = Mat::zeros(greyscale.size(), CV_8UC3);
 
-        for (int i = 0; i < contours.size(); ++i) {
-            drawContours(contour_debug, contours, i, Scalar(rand() & 255, rand() & 255, rand() & 255), 1, 8, hierarchy, 0, Point2i());
+        for (int i = 0; i < contours_count; ++i) {
+            drawContours(contour_debug, contours, i, Scalar(rand() & 255, rand() & 255, rand() & 255), 1, 8, noArray(), 0, Point2i());
         }
 
         imwrite("03_contours.jpg", contour_debug);
@@ -492,29 +1647,35 @@ bool detectKikCode(Mat &greyscale, Mat *out_progress, uint32_t device_quality, u
 #endif
     
     // compute the moments of each contour to search for large, roundish, blobs
-    vector<Moments> mu(contours.size());
-    vector<Point2f> mc(contours.size());
+    vector<Moments> &mu = mu_;
+    mu.assign(contours_count, Moments());
     
-    START_DEBUG_TIMING(moment_pass_1);
+    TRACE_SPAN(moment_pass_1);
 
-    // find ellipses
-    Mat ellipse_boundaries = Mat::zeros(contour_mat.size(), CV_8UC1);
+    // find ellipses. The blobs are done with contour_mat, so the ellipse boundaries are drawn into
+    // it before being packed
+    Mat &ellipse_boundaries = contour_mat;
+    ellipse_boundaries.setTo(Scalar(0));
     
-    for (int i = 0; i < contours.size(); ++i) {
+    for (int i = 0; i < contours_count; ++i) {
         vector<Point2i> &contour = contours[i];
 
         if (contour.size() > minimum_ellipse_contour_size) {
             mu[i] = moments(contour, false);
-            mc[i] = Point2f(mu[i].m10/mu[i].m00 , mu[i].m01/mu[i].m00);
         }
     }
-    END_DEBUG_TIMING(timing, moment_pass_1);
+    TRACE_SPAN_END(moment_pass_1);
 
+#if DEBUGGING
     Mat contour_selection = Mat::zeros(greyscale.size(), CV_8UC3);
-    vector<vector<Point2i>> ellipse_contours;
+#endif
 
-    START_DEBUG_TIMING(ellipse_fitting_1);
-    for (int i = 0; i < contours.size(); ++i) {
+    // track the contours that started each ellipse by index rather than by copy
+    vector<size_t> &ellipse_contour_indices = ellipse_contour_indices_;
+    ellipse_contour_indices.clear();
+
+    TRACE_SPAN(ellipse_fitting_1);
+    for (int i = 0; i < contours_count; ++i) {
         vector<Point2i> &contour = contours[i];
 
         if (contour.size() <= minimum_ellipse_contour_size) {
@@ -522,19 +1683,6 @@ bool detectKikCode(Mat &greyscale, Mat *out_progress, uint32_t device_quality, u
         }
 
         Moments moment = mu[i];
-        
-        // the contour must be...
-        // large enough
-        const double minimum_ellipse_area = 220 * scaling_rate;
-
-        // circular enough
-        const double minimum_ellipse_circularity = 0.75;
-
-        // convex (not having a lot of concave components)
-        const double minimum_ellipse_convexity = 0.9;
-
-        // not too squished
-        const double minimum_ellipse_inertia = 0.5;
 
         // perform checks based on the moments already computed
         double area = moment.m00;
@@ -542,63 +1690,45 @@ bool detectKikCode(Mat &greyscale, Mat *out_progress, uint32_t device_quality, u
         if (area < minimum_ellipse_area) {
 #if DEBUGGING
             if (output_snapshots) {
-                drawContours(contour_selection, contours, i, Scalar(0, 0, 255), 1, 8, hierarchy, 0, Point2i());
+                drawContours(contour_selection, contours, i, Scalar(0, 0, 255), 1, 8, noArray(), 0, Point2i());
             }
 #endif
             continue;
         }
 
-        double perimeter = arcLength(Mat(contour), true);
+        double perimeter = arcLength(contour, true);
         double circularity = 4 * CV_PI * area / (perimeter * perimeter);
 
         if (circularity < minimum_ellipse_circularity) {
 #if DEBUGGING
             if (output_snapshots) {
-                drawContours(contour_selection, contours, i, Scalar(0, 128, 255), 1, 8, hierarchy, 0, Point2i());
+                drawContours(contour_selection, contours, i, Scalar(0, 128, 255), 1, 8, noArray(), 0, Point2i());
             }
 #endif
             continue;
         }
 
         vector<Point> hull;
-        convexHull(Mat(contour), hull);
+        convexHull(contour, hull);
 
-        double hull_area = contourArea(Mat(hull));
+        double hull_area = contourArea(hull);
         double convexity = area / hull_area;
 
         if (convexity < minimum_ellipse_convexity) {
 #if DEBUGGING
             if (output_snapshots) {
-                drawContours(contour_selection, contours, i, Scalar(128, 0, 255), 1, 8, hierarchy, 0, Point2i());
+                drawContours(contour_selection, contours, i, Scalar(128, 0, 255), 1, 8, noArray(), 0, Point2i());
             }
 #endif
             continue;
         }
 
-        // compute inertia
-        double denominator = sqrt(pow(2 * moment.mu11, 2) + pow(moment.mu20 - moment.mu02, 2));
-        const double eps = 1e-2;
-
-        double inertia;
-        if (denominator > eps) {
-            double cosmin = (moment.mu20 - moment.mu02) / denominator;
-            double sinmin = 2 * moment.mu11 / denominator;
-            double cosmax = -cosmin;
-            double sinmax = -sinmin;
-
-            double imin = 0.5 * (moment.mu20 + moment.mu02) - 0.5 * (moment.mu20 - moment.mu02) * cosmin - moment.mu11 * sinmin;
-            double imax = 0.5 * (moment.mu20 + moment.mu02) - 0.5 * (moment.mu20 - moment.mu02) * cosmax - moment.mu11 * sinmax;
-
-            inertia = imin / imax;
-        }
-        else {
-            inertia = 1;
-        }
+        double inertia = inertiaRatio(moment.mu20, moment.mu11, moment.mu02);
 
         if (inertia < minimum_ellipse_inertia) {
 #if DEBUGGING
             if (output_snapshots) {
-                drawContours(contour_selection, contours, i, Scalar(255, 0, 255), 1, 8, hierarchy, 0, Point2i());
+                drawContours(contour_selection, contours, i, Scalar(255, 0, 255), 1, 8, noArray(), 0, Point2i());
             }
 #endif
             continue;
@@ -606,22 +1736,19 @@ bool detectKikCode(Mat &greyscale, Mat *out_progress, uint32_t device_quality, u
 
         // all of our checks passed, looks like a potential center circle
         // fit an ellipse to the contour
-//        ++timing->ellipses_fit;
         RotatedRect rect = fitEllipse(contour);
 
 #if DEBUGGING
         if (output_snapshots) {
-            drawContours(contour_selection, contours, i, Scalar(255, 0, 0), 1, 8, hierarchy, 0, Point2i());
+            drawContours(contour_selection, contours, i, Scalar(255, 0, 0), 1, 8, noArray(), 0, Point2i());
         }
 #endif
 
-//        ++timing->ellipses_fit_matches;
-
         rect.size.width -= 2;
         rect.size.height -= 2;
 
         // track the contour that started this ellipse
-        ellipse_contours.push_back(contour);
+        ellipse_contour_indices.push_back(i);
 
         // draw the ellipse boundaries so that we can filter out edges that do not directly
         // contribute to the main part of the elllipse (this is how we clean up issues with
@@ -635,77 +1762,88 @@ bool detectKikCode(Mat &greyscale, Mat *out_progress, uint32_t device_quality, u
     }
 #endif
 
-    END_DEBUG_TIMING(timing, ellipse_fitting_1);
+    TRACE_SPAN_END(ellipse_fitting_1);
+    TRACE_COUNT(ellipses_fit, ellipse_contour_indices.size());
     
     // only keep edges that share edges with the fitted ellipses
-    Mat matches_near_ellipses;
+    Bitplane &matches_near_ellipses = ellipse_boundaries_;
 
-    START_DEBUG_TIMING(and_ellipses);
-    bitwise_and(whitish, ellipse_boundaries, matches_near_ellipses);
-    END_DEBUG_TIMING(timing, and_ellipses);
+    TRACE_SPAN(and_ellipses);
+    matches_near_ellipses.pack(ellipse_boundaries.ptr<uint8_t>(), ellipse_boundaries.step);
+    matches_near_ellipses.andWith(whitish_);
+    TRACE_SPAN_END(and_ellipses);
 
     // filter the contours down to only the points that are within the ellipse
-    // fitting tolerance (+/-2 pixels)
-    vector<vector<Point2i>> pruned_contours;
+    // fitting tolerance (+/-2 pixels). The inner vectors are cleared rather than
+    // destroyed so their storage carries over to the next frame
+    vector<vector<Point2i> > &pruned_contours = pruned_contours_;
+
+    if (pruned_contours.size() < ellipse_contour_indices.size()) {
+        pruned_contours.resize(ellipse_contour_indices.size());
+    }
 
-    for (int i = 0; i < ellipse_contours.size(); ++i) {
-        vector<Point2i> &contour = ellipse_contours[i];
-        vector<Point2i> pruned_contour;
+    for (int i = 0; i < ellipse_contour_indices.size(); ++i) {
+        vector<Point2i> &contour = contours[ellipse_contour_indices[i]];
+        vector<Point2i> &pruned_contour = pruned_contours[i];
+
+        pruned_contour.clear();
 
         for (int j = 0; j < contour.size(); ++j) {
             Point2i &point = contour[j];
 
-            if (point.x >= 0 && point.y >= 0 && point.x < matches_near_ellipses.cols && point.y < matches_near_ellipses.rows
-                    && matches_near_ellipses.at<char>(point.y, point.x) != 0) {
+            if (point.x >= 0 && point.y >= 0 && point.x < matches_near_ellipses.width() && point.y < matches_near_ellipses.height()
+                    && matches_near_ellipses.get(point.x, point.y)) {
                 pruned_contour.push_back(point);
             }
         }
-
-        pruned_contours.push_back(pruned_contour);
     }
 
-    vector<vector<Point2i> > contours2 = pruned_contours;
-    vector<Vec4i> hierarchy2;
+    vector<vector<Point2i> > &contours2 = pruned_contours;
+    const size_t contours2_count = ellipse_contour_indices.size();
     
     // search the limited edges to find strong ellipse matches
-    vector<RotatedRect> ellipses;
-    vector<size_t> contour_indices;
+    vector<RotatedRect> &ellipses = ellipses_;
+    vector<size_t> &contour_indices = contour_indices_;
+
+    ellipses.clear();
+    contour_indices.clear();
 
 #if DEBUGGING
     if (output_snapshots) {
         Mat nearby_contours = Mat::zeros(greyscale.size(), CV_8UC3);
 
-        for (int i = 0; i < contours2.size(); ++i) {
-            drawContours(nearby_contours, contours2, i, Scalar(rand() & 255, rand() & 255, rand() & 255), 1, 8, hierarchy, 0, Point2i());
+        for (int i = 0; i < contours2_count; ++i) {
+            drawContours(nearby_contours, contours2, i, Scalar(rand() & 255, rand() & 255, rand() & 255), 1, 8, noArray(), 0, Point2i());
         }
 
         imwrite("05_nearby_contours.jpg", nearby_contours);
     }
 #endif
 
-    vector<RotatedRect> potential_ellipses;
-    vector<size_t> potential_contour_indices;
+    vector<RotatedRect> &potential_ellipses = potential_ellipses_;
+    vector<size_t> &potential_contour_indices = potential_contour_indices_;
+
+    potential_ellipses.clear();
+    potential_contour_indices.clear();
     
     // re-fit the ellipses based on only the filtered points
     // and only if the contours have enough points to be useful
     // (ellipse fitting requires 5 reference points at a minimum)
-    START_DEBUG_TIMING(ellipse_fitting_2);
+    TRACE_SPAN(ellipse_fitting_2);
     // find all ellipses in the search space by estimating the fit
-    for (int i = 0; i < contours2.size(); ++i) {
+    for (int i = 0; i < contours2_count; ++i) {
         vector<Point2i> &contour = contours2[i];
         
         // the contour must be sufficiently dense
         // and the mass of the moment must be large enough
         if (contour.size() > 5) {
-//            ++timing->ellipses_fit_2;
             RotatedRect rect = fitEllipse(contour);
-
-//            ++timing->ellipses_fit_2_matches;
             potential_ellipses.push_back(rect);
             potential_contour_indices.push_back(i);
         }
     }
-    END_DEBUG_TIMING(timing, ellipse_fitting_2);
+    TRACE_SPAN_END(ellipse_fitting_2);
+    TRACE_COUNT(ellipses_fit_2, potential_ellipses.size());
 
     // prune the potential ellipses to avoid any ellipses that are too close in size and
     // position to other ellipses (these can occur because of the Kik code aesthetic)
@@ -739,7 +1877,7 @@ bool detectKikCode(Mat &greyscale, Mat *out_progress, uint32_t device_quality, u
         }
     }
 
-//    timing->ellipse_candidates = ellipses.size();
+    TRACE_COUNT(ellipse_candidates, ellipses.size());
 
 #if DEBUGGING
     if (output_snapshots) {
@@ -753,278 +1891,518 @@ bool detectKikCode(Mat &greyscale, Mat *out_progress, uint32_t device_quality, u
     }
 #endif
     
+    if (out_progress != nullptr) {
+        *out_progress = progress;
+    }
+
+    return ellipses.size();
+}
+
+/**
+ * Evaluates the candidates findCandidates() left for greyscale, in order, until max_results codes
+ * are found.
+ *
+ * @returns The number of results written to out_results
+ */
+size_t KikCodeScanner::searchCandidates(Mat &greyscale, KikCodeScanResult *out_results, size_t max_results, bool output_snapshots)
+{
+    vector<RotatedRect> &ellipses = ellipses_;
+    vector<size_t> &contour_indices = contour_indices_;
+    vector<vector<Point2i> > &contours2 = pruned_contours_;
+
+    if (result_margins_.size() < max_results) {
+        result_margins_.resize(max_results);
+    }
+
     // iterate over each candidate ring and determine if it's really the
     // center of a Kik code
-    START_DEBUG_TIMING(ellipse_search);
-    for (int i = 0; i < ellipses.size(); ++i) {
-//        ++timing->ellipses_searched;
-        RotatedRect candidate_center = ellipses[i];
-        vector<FinderPoint> finder_points;
-        vector<Point2i> &contour = contours2[contour_indices[i]];
+    TRACE_SPAN(ellipse_search);
+    size_t found_count = 0;
+
+    if (budget_us_ > 0 && ellipses.size() > 1) {
+        orderCandidates(ellipses, &contour_indices, candidate_origin_, 1.0);
+    }
 
-        // check if this is an inverted-colour Kik code by searching the area just
-        // inside the contour
-        int offset = 0;
-        bool check_high = true;
-        bool is_region_dark = false;
+    if (pool_ && ellipses.size() > 1) {
+        found_count = searchCandidatesParallel(greyscale, out_results, max_results, output_snapshots);
+    }
+    else {
+        size_t searched_count = 0;
 
-        size_t dark_count = 0;
+        for (int i = 0; i < ellipses.size() && found_count < max_results; ++i) {
+            if (pastDeadline()) {
+                search_exhaustive_ = false;
 
-        for (int j = 0; j < contour.size(); ++j) {
-            Point2i point = contour[j];
-            int x = 0.9 * (point.x - candidate_center.center.x) + candidate_center.center.x;
-            int y = 0.9 * (point.y - candidate_center.center.y) + candidate_center.center.y;
+                TRACE_COUNT(candidates_skipped, ellipses.size() - i);
 
-            if (x >= 0 && y >= 0 && x < whitish.cols && y < whitish.rows) {
-                if (whitish.at<char>(y, x) == 0) {
-                    ++dark_count;
-                }
+                break;
+            }
+
+            RotatedRect candidate_center = ellipses[i];
+            vector<Point2i> &contour = contours2[contour_indices[i]];
+
+            // don't spend any time on candidates that sit inside a code we've already found,
+            // these are features of that code (or duplicates of its centre) rather than new codes
+            if (overlapsResult(candidate_center.center, out_results, found_count)) {
+                continue;
+            }
+
+            // check if this is an inverted-colour Kik code, if so build the summed-area table it
+            // is thresholded from if it hasn't yet been built
+            bool check_high = !isCandidateDark(candidate_center, contour);
+
+            if (!check_high) {
+                ensureLocalThreshold(greyscale);
+            }
+
+            // extract the orientation ring and data if it is present
+            ++searched_count;
+
+            if (evaluateCandidate(scratch_[0], i, check_high, candidate_center, greyscale, &out_results[found_count], &result_margins_[found_count], output_snapshots)) {
+                ++found_count;
             }
         }
 
-        if (dark_count > 0.8 * contour.size()) {
-            is_region_dark = true;
+        TRACE_COUNT(ellipses_searched, searched_count);
+    }
+    TRACE_SPAN_END(ellipse_search);
+
+    return found_count;
+}
+
+/**
+ * Scores how likely ellipse, found in a crop at origin of the working-resolution frame and scaled
+ * down by factor, is to be the centre of a code. Only the order of the scores matters.
+ */
+double KikCodeScanner::candidateScore(const RotatedRect &ellipse, Point2f origin, double factor) const
+{
+    double major = MAX(ellipse.size.width, ellipse.size.height) * factor;
+    double minor = MIN(ellipse.size.width, ellipse.size.height) * factor;
+
+    if (major <= 0.0) {
+        return 0.0;
+    }
+
+    Point2f center(ellipse.center.x * factor + origin.x, ellipse.center.y * factor + origin.y);
+    double code_size = major / KIK_CODE_INNER_RING_RATIO;
+
+    Size frame_size = candidate_frame_size_;
+    double frame_min = MAX(1, MIN(frame_size.width, frame_size.height));
+
+    // the centre of a code seen straight on is a circle, tilting it flattens it
+    double score = minor / major;
+
+    if (hint_.valid) {
+        // codes don't move far or change size much from one frame to the next
+        double expected = MAX(1.0, hint_.size * MAX(frame_size.width, frame_size.height));
+        double ratio = code_size / expected;
+        Point2f last(hint_.center.x * frame_size.width, hint_.center.y * frame_size.height);
+
+        score *= MIN(ratio, 1.0 / ratio);
+        score /= 1.0 + norm(center - last) / expected;
+    }
+    else {
+        // a code has to fit in the frame to be read, and is usually held near the middle of it
+        Point2f middle(frame_size.width / 2.0f, frame_size.height / 2.0f);
+
+        if (code_size > frame_min) {
+            score *= frame_min / code_size;
         }
 
-        // if this is an inverted-colour code, create the dark-thresholded image if it hasn't
-        // yet been created
-        if (is_region_dark) {
-            check_high = false;
+        score /= 1.0 + norm(center - middle) / frame_min;
+    }
 
-            if (!blackish_created) {
-                blackish_created = true;
-                adaptiveThreshold(greyscale, blackish, 255, cv::ADAPTIVE_THRESH_MEAN_C, cv::THRESH_BINARY_INV, adaptive_threshold_width, 5);
-            }
+    return score;
+}
+
+void KikCodeScanner::orderCandidates(vector<RotatedRect> &ellipses, vector<size_t> *contour_indices, Point2f origin, double factor)
+{
+    vector<double> &scores = candidate_scores_;
+    vector<size_t> &order = candidate_order_;
+
+    scores.resize(ellipses.size());
+    order.resize(ellipses.size());
+
+    for (size_t i = 0; i < ellipses.size(); ++i) {
+        scores[i] = candidateScore(ellipses[i], origin, factor);
+        order[i] = i;
+    }
+
+    // equally likely candidates keep the order they were found in
+    stable_sort(order.begin(), order.end(), [&scores](size_t a, size_t b) { return scores[a] > scores[b]; });
+
+    // the potential ellipses are done with once the candidates are found
+    vector<RotatedRect> &sorted = potential_ellipses_;
+    sorted.clear();
+
+    for (size_t i = 0; i < order.size(); ++i) {
+        sorted.push_back(ellipses[order[i]]);
+    }
+
+    ellipses.swap(sorted);
+
+    if (contour_indices) {
+        vector<size_t> &sorted_indices = potential_contour_indices_;
+        sorted_indices.clear();
+
+        for (size_t i = 0; i < order.size(); ++i) {
+            sorted_indices.push_back((*contour_indices)[order[i]]);
         }
 
-        // extract the orientation ring if it is present
-        if (extractFinderPoints(i, check_high, candidate_center, blackish, whitish, progress, finder_points, timing, output_snapshots)) {
-            if (finder_points.size() != FINDER_POINT_COUNT) {
-                continue;
+        contour_indices->swap(sorted_indices);
+    }
+}
+
+/**
+ * Checks the area just inside a candidate's contour for an inverted-colour Kik code.
+ *
+ * @returns True iff most of the area inside the contour is dark
+ */
+bool KikCodeScanner::isCandidateDark(const RotatedRect &candidate_center, const vector<Point2i> &contour) const
+{
+    const Bitplane &whitish = whitish_;
+
+    size_t dark_count = 0;
+
+    for (int j = 0; j < contour.size(); ++j) {
+        Point2i point = contour[j];
+        int x = 0.9 * (point.x - candidate_center.center.x) + candidate_center.center.x;
+        int y = 0.9 * (point.y - candidate_center.center.y) + candidate_center.center.y;
+
+        if (x >= 0 && y >= 0 && x < whitish.width() && y < whitish.height()) {
+            if (!whitish.get(x, y)) {
+                ++dark_count;
             }
-            
-            double current_angle = M_PI / 16 - M_PI / 2;
-            vector<Point2f> object_finder_points;
-            vector<Point2f> scene_finder_points;
+        }
+    }
+
+    return dark_count > 0.8 * contour.size();
+}
+
+void KikCodeScanner::ensureLocalThreshold(const Mat &greyscale)
+{
+    if (!local_threshold_built_) {
+        local_threshold_built_ = true;
+        local_threshold_.build(greyscale.ptr<uint8_t>(), greyscale.step, greyscale.cols, greyscale.rows);
+    }
+}
+
+void KikCodeScanner::evaluateCandidateTask(void *context, size_t task, size_t worker)
+{
+    CandidateSearch *search = (CandidateSearch *)context;
+    KikCodeScanner *scanner = search->scanner;
+
+    // a candidate earlier in the list already decoded, and it wins over this one
+    if (search->single_result && task > search->first_found.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    if (scanner->pastDeadline()) {
+        search->skipped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    CandidateScratch &scratch = scanner->scratch_[worker];
+
+    search->searched.fetch_add(1, std::memory_order_relaxed);
+
+    if (!scanner->evaluateCandidate(scratch, (int)task, scanner->candidate_high_[task], scanner->ellipses_[task],
+                                    *search->greyscale, &scanner->candidate_results_[task], &scanner->candidate_margins_[task], search->output_snapshots)) {
+        return;
+    }
+
+    scanner->candidate_found_[task] = 1;
+
+    size_t first_found = search->first_found.load(std::memory_order_relaxed);
+
+    while (task < first_found && !search->first_found.compare_exchange_weak(first_found, task, std::memory_order_relaxed)) {
+    }
+}
+
+/**
+ * Evaluates every candidate ellipse on the worker pool. The results are gathered in candidate order
+ * and filtered the same way the serial search filters them, so both searches find the same codes.
+ * For single-code scans, candidates after the first one that decodes are skipped.
+ */
+size_t KikCodeScanner::searchCandidatesParallel(Mat &greyscale, KikCodeScanResult *out_results, size_t max_results, bool output_snapshots)
+{
+    const size_t candidate_count = ellipses_.size();
+
+    // the workers only read the thresholded image and the summed-area table, so decide which one
+    // each candidate is read from (and build the table if needed) before any of them start
+    candidate_high_.resize(candidate_count);
+
+    for (size_t i = 0; i < candidate_count; ++i) {
+        candidate_high_[i] = !isCandidateDark(ellipses_[i], pruned_contours_[contour_indices_[i]]);
+
+        if (!candidate_high_[i]) {
+            ensureLocalThreshold(greyscale);
+        }
+    }
+
+    candidate_found_.assign(candidate_count, 0);
+    candidate_results_.resize(candidate_count);
+    candidate_margins_.resize(candidate_count);
+
+    CandidateSearch search;
+    search.scanner = this;
+    search.greyscale = &greyscale;
+    search.single_result = max_results == 1;
+    search.output_snapshots = output_snapshots;
+    search.first_found = candidate_count;
+    search.searched = 0;
+    search.skipped = 0;
+
+    pool_->run(candidate_count, evaluateCandidateTask, &search);
+
+    TRACE_COUNT(ellipses_searched, search.searched.load(std::memory_order_relaxed));
+
+    size_t skipped = search.skipped.load(std::memory_order_relaxed);
+
+    if (skipped > 0) {
+        search_exhaustive_ = false;
+
+        TRACE_COUNT(candidates_skipped, skipped);
+    }
+
+    size_t found_count = 0;
+
+    for (size_t i = 0; i < candidate_count && found_count < max_results; ++i) {
+        if (!candidate_found_[i] || overlapsResult(ellipses_[i].center, out_results, found_count)) {
+            continue;
+        }
+
+        result_margins_[found_count] = candidate_margins_[i];
+        out_results[found_count++] = candidate_results_[i];
+    }
+
+    return found_count;
+}
+
+/**
+ * Measures how clearly a module reads: the signed distance, in grey levels, of the pixel from the
+ * threshold it was read against, measured on the same values the threshold was applied to. A light
+ * pixel is measured on the sharpened frame whenever the whitish plane was thresholded from it, and
+ * also against its window's mean with local thresholding. Values of 0 and above read as a 1,
+ * values near 0 could go either way.
+ */
+int KikCodeScanner::moduleMargin(const Mat &greyscale, int x, int y, bool check_high) const
+{
+    int pixel = greyscale.at<uint8_t>(y, x);
+
+    if (!check_high) {
+        // the margin isDark() tests, against the window mean rounded to a whole grey level
+        return local_threshold_.mean(x, y, blackish_radius_) - BLACKISH_DELTA - pixel;
+    }
+
+    int margin;
+
+    if (sharpen_thresholded_) {
+        margin = sharpen_threshold_.margin(greyscale.ptr<uint8_t>(), greyscale.step, greyscale.cols, greyscale.rows, x, y, WHITISH_THRESHOLD);
+    }
+    else {
+        // threshold() keeps the pixels strictly above it
+        margin = pixel - (WHITISH_THRESHOLD + 1);
+    }
+
+    // a pixel is light if either threshold says so, so it's as clearly light as the clearer one
+    if (local_threshold_enabled_) {
+        margin = MAX(margin, local_threshold_.lightMargin(x, y, whitish_local_radius_, WHITISH_LOCAL_PERCENT, WHITISH_LOCAL_FLOOR));
+    }
+
+    return margin;
+}
+
+/**
+ * Checks a single candidate ellipse for an orientation ring and, if one is present, maps the
+ * exemplar Kik code onto the scene and reads its data rings into out_result.
+ *
+ * @returns True iff the candidate is a structurally valid Kik code
+ */
+bool KikCodeScanner::evaluateCandidate(CandidateScratch &scratch, int ellipse_id, bool check_high, RotatedRect candidate_center, Mat &greyscale, KikCodeScanResult *out_result, ModuleMargins *out_margins, bool output_snapshots)
+{
+    const Bitplane &whitish = whitish_;
+
+    // the target buffer for the resulting scan data (if successful)
+    uint8_t scan_data[KIK_CODE_BYTE_COUNT];
+    uint8_t scan_confidence[KIK_CODE_BYTE_COUNT];
+    ModuleMargins scan_margins;
+
+    const int offset = 0;
 
-            vector<Point2f> object_corner_points;
-            vector<Point2f> scene_corner_points;
+    // extract the orientation ring if it is present
+    if (extractFinderPoints(scratch, ellipse_id, check_high, candidate_center, output_snapshots)) {
+        vector<FinderPoint> &finder_points = scratch.finder_points;
 
-            float modifier = 42;
-            float offset_x = 195.0;
-            float offset_y = 195.0;
+        if (finder_points.size() != FINDER_POINT_COUNT) {
+            return false;
+        }
+
+        const vector<Point2f> &object_finder_points = object_finder_points_;
+        vector<Point2f> &scene_finder_points = scratch.scene_finder_points;
+
+        // create the set of scene points for computing the homography to map
+        // our exemplar Kik code onto the scene, the object points are fixed
+        TRACE_SPAN(generate_scene_points);
+        scene_finder_points.clear();
+
+        for (int j = 0; j < finder_points.size(); ++j) {
+            FinderPoint point = finder_points[(j+offset) % finder_points.size()];
+            scene_finder_points.push_back(Point2f(point.x, point.y));
+        }
+        TRACE_SPAN_END(generate_scene_points);
+
+        try {
+            // compute the homography from the object orientation ring to the scene orientation ring
+            TRACE_SPAN(find_homography);
+            Mat H = findHomography(object_finder_points, scene_finder_points, cv::RANSAC);
+            TRACE_SPAN_END(find_homography);
             
-            // create the set of scene points and object points for computing the homography to map
-            // our exemplar Kik code onto the scene
-            START_DEBUG_TIMING(generate_scene_points);
-            for (int j = 0; j < finder_points.size(); ++j) {
-                object_finder_points.push_back(
-                    Point2f(modifier * 2.025 * cos(current_angle) + offset_x, modifier * 2.025 * sin(current_angle) + offset_y));
-                
-                current_angle += finder_deltas[j];
-            }
+            TRACE_SPAN(transform_finder_points);
+            vector<Point2f> &scene_corners = scratch.scene_corners;
             
-            for (int j = 0; j < finder_points.size(); ++j) {
-                FinderPoint point = finder_points[(j+offset) % finder_points.size()];
-                scene_finder_points.push_back(Point2f(point.x, point.y));
-            }
-            END_DEBUG_TIMING(timing, generate_scene_points);
+            perspectiveTransform(object_finder_points, scene_corners, H);
+            TRACE_SPAN_END(transform_finder_points);
 
-            try {
-                // compute the homography from the object orientation ring to the scene orientation ring
-                START_DEBUG_TIMING(find_homography);
-                Mat H = findHomography(object_finder_points, scene_finder_points, cv::RANSAC);
-                END_DEBUG_TIMING(timing, find_homography);
-                
-                START_DEBUG_TIMING(transform_finder_points);
-                vector<Point2f> scene_corners(object_finder_points.size());
-                
-                perspectiveTransform(object_finder_points, scene_corners, H);
-                END_DEBUG_TIMING(timing, transform_finder_points);
+            TRACE_SPAN(transform_all_points);
+            vector<Point2f> &scene_points = scratch.scene_points;
+            
+            // map each position in the object-space Kik code on to the scene space
+            perspectiveTransform(object_data_points_, scene_points, H);
+            TRACE_SPAN_END(transform_all_points);
 
-                START_DEBUG_TIMING(transform_all_points);
-                vector<Point2f> all_points;
-                vector<Point2f> scene_points;
-                
-                // generate all positions on the Kik code in the object space
-                for (int r = 1; r < 6; ++r) {
-                    size_t n = 32 + 8 * r;
-                    
-                    for (int j = 0; j < n; ++j) {
-                        double angle = j * M_PI / n * 2 - M_PI / 2;
-                        double radius = modifier * ((r + 1) * 0.4 + 1.8);
-                        
-                        all_points.push_back(Point2f(radius * cos(angle) + offset_x, radius * sin(angle) + offset_y));
-                    }
-                }
-                
-                // map each position in the object-space Kik code on to the scene space
-                perspectiveTransform(all_points, scene_points, H);
-                END_DEBUG_TIMING(timing, transform_all_points);
+            TRACE_SPAN(extract_data);
 
-                START_DEBUG_TIMING(extract_data);
+            // we always have the finder pattern in the first 32 bits
+            memset(scan_data, 0, sizeof(scan_data));
+            memcpy(scan_data, finder_bytes, sizeof(finder_bytes));
 
-                // we always have the finder pattern in the first 32 bits
-                memset(scan_data, 0, sizeof(scan_data));
-                memcpy(scan_data, finder_bytes, sizeof(finder_bytes));
+            // a byte is only as reliable as its least reliable bit
+            memset(scan_confidence, 255, sizeof(scan_confidence));
+            
+            // use the scene-space points to determine the data contained in the Kik code
+            for (int j = 0; j < scene_points.size(); ++j) {
+                int x = (int)floor(scene_points[j].x);
+                int y = (int)floor(scene_points[j].y);
+
+                size_t pos = j + 32;
+                int margin = 0;
+                uint8_t confidence = 0;
                 
-                // use the scene-space points to determine the data contained in the Kik code
-                for (int j = 0; j < scene_points.size(); ++j) {
-                    int x = (int)floor(scene_points[j].x);
-                    int y = (int)floor(scene_points[j].y);
-
-                    size_t pos = j + 32;
-                    
-                    // at each position, if the data is white (black in the case of inverted-colour
-                    // codes), it's a 1, otherwise it's a 0
-                    if (x >= 0 && y >= 0 && x < whitish.cols && y < whitish.rows) {
-                        bool bit = false;
+                // at each position, if the data is white (black in the case of inverted-colour
+                // codes), it's a 1, otherwise it's a 0
+                if (x >= 0 && y >= 0 && x < whitish.width() && y < whitish.height()) {
+                    bool bit = false;
 
-                        if (check_high) {
-                            bit = whitish.at<char>(y, x) != 0;
-                        }
-                        else {
-                            bit = blackish.at<char>(y, x) != 0;
-                        }
+                    if (check_high) {
+                        bit = whitish.get(x, y);
+                    }
+                    else {
+                        bit = local_threshold_.isDark(x, y, blackish_radius_, BLACKISH_DELTA);
+                    }
 
-                        if (bit) {
-                            scan_data[pos/8] |= 0x1 << (pos % 8);
-                        }
+                    if (bit) {
+                        scan_data[pos/8] |= 0x1 << (pos % 8);
                     }
+
+                    // how far the module is from the threshold, on the side of the bit that was read
+                    margin = moduleMargin(greyscale, x, y, check_high);
+                    confidence = saturate_cast<uint8_t>(bit ? margin : -margin);
                 }
 
-                END_DEBUG_TIMING(timing, extract_data);
+                scan_confidence[pos/8] = MIN(scan_confidence[pos/8], confidence);
+                scan_margins.values[j] = saturate_cast<int8_t>(margin);
+            }
+
+            TRACE_SPAN_END(extract_data);
 
-                found = true;
+            // a candidate that is structurally a code can still be something else entirely, so
+            // only settle for it if its data error corrects. Checking the syndromes of a clean
+            // code is cheap, and rejecting here lets the search move on to the next candidate.
+            // With accumulation a code too damaged to correct on its own can still read together
+            // with the frames before it, so it's only passed over if it can't
+            if (validation_enabled_ && !KikCode::correct(scan_data + 4, scan_confidence + 4)) {
+                Point2f center = candidate_center.center + candidate_origin_;
+                double scale = MAX(candidate_center.size.width, candidate_center.size.height) / KIK_CODE_INNER_RING_RATIO;
 
-                // compute the inverse transform for special rendering purposes
-                // (cool transitions?)
-                vector<Point2f> scene_persp_points;
-                vector<Point2f> object_persp_points;
+                if (!accumulation_enabled_ || !readableAccumulated(center, scale, scan_margins)) {
+                    return false;
+                }
+            }
 
-                scene_persp_points.push_back(scene_corners[0]);
-                object_persp_points.push_back(object_finder_points[0]);
+            // compute the inverse transform for special rendering purposes
+            // (cool transitions?)
+            Mat inverse_transform = Mat::eye(3, 3, CV_64F);
 
-                scene_persp_points.push_back(scene_corners[3]);
-                object_persp_points.push_back(object_finder_points[3]);
+            invert(H, inverse_transform);
 
-                scene_persp_points.push_back(scene_corners[7]);
-                object_persp_points.push_back(object_finder_points[7]);
+            memcpy(out_result->data, scan_data + 4, KIK_CODE_TOTAL_BYTE_COUNT);
+            memcpy(out_result->confidence, scan_confidence + 4, KIK_CODE_TOTAL_BYTE_COUNT);
 
-                Mat inverse_transform = Mat::eye(3, 3, CV_64F);
+            if (out_margins) {
+                *out_margins = scan_margins;
+            }
 
-                invert(H, inverse_transform);
+            out_result->x = (unsigned int)candidate_center.center.x;
+            out_result->y = (unsigned int)candidate_center.center.y;
+            out_result->scale = (unsigned int)(MAX(candidate_center.size.width, candidate_center.size.height) / KIK_CODE_INNER_RING_RATIO);
 
-                *out_x = (unsigned int)candidate_center.center.x;
-                *out_y = (unsigned int)candidate_center.center.y;
-                *out_scale = (unsigned int)(MAX(candidate_center.size.width, candidate_center.size.height) / INNER_RING_RATIO);
-                *transform = inverse_transform;
+            for (int row = 0; row < 3; ++row) {
+                for (int col = 0; col < 3; ++col) {
+                    out_result->transform[row * 3 + col] = inverse_transform.at<double>(row, col);
+                }
+            }
 
 #if DEBUGGING
-                if (output_snapshots) {
-                    Mat code_points = Mat::zeros(greyscale.size(), CV_8UC3);
-                    cvtColor(greyscale, code_points, cv::COLOR_GRAY2RGB);
-
-                    for (int j = 0; j < scene_points.size(); ++j) {
-                        int x = (int)floor(scene_points[j].x);
-                        int y = (int)floor(scene_points[j].y);
-
-                        bool bit = false;
-
-                        if (x >= 0 && y >= 0 && x < whitish.cols && y < whitish.rows) {
-                            if (check_high) {
-                                bit = whitish.at<char>(y, x) != 0;
-                            }
-                            else {
-                                bit = blackish.at<char>(y, x) != 0;
-                            }
-                        }
-                        
-                        if (bit) {
-                            circle(code_points, Point2i(x, y), 2, Scalar(0, 0, 255), -1);
+            if (output_snapshots) {
+                Mat code_points = Mat::zeros(greyscale.size(), CV_8UC3);
+                cvtColor(greyscale, code_points, cv::COLOR_GRAY2RGB);
+
+                for (int j = 0; j < scene_points.size(); ++j) {
+                    int x = (int)floor(scene_points[j].x);
+                    int y = (int)floor(scene_points[j].y);
+
+                    bool bit = false;
+
+                    if (x >= 0 && y >= 0 && x < whitish.width() && y < whitish.height()) {
+                        if (check_high) {
+                            bit = whitish.get(x, y);
                         }
                         else {
-                            circle(code_points, Point2i(x, y), 2, Scalar(255, 0, 0), -1);
+                            bit = local_threshold_.isDark(x, y, blackish_radius_, BLACKISH_DELTA);
                         }
                     }
+                    
+                    if (bit) {
+                        circle(code_points, Point2i(x, y), 2, Scalar(0, 0, 255), -1);
+                    }
+                    else {
+                        circle(code_points, Point2i(x, y), 2, Scalar(255, 0, 0), -1);
+                    }
+                }
 
-                    char filename[128];
+                char filename[128];
 
-                    sprintf(filename, "10_%d_code_points.jpg", i);
+                sprintf(filename, "10_%d_code_points.jpg", ellipse_id);
 
-                    imwrite(filename, code_points);
-                }
+                imwrite(filename, code_points);
+            }
 #endif
 
-                // we found one! We're good to go!
-                break;
-            }
-            catch (exception &e) {
-                (void)e;
-            }
+            // we found one! We're good to go!
+            return true;
+        }
+        catch (exception &e) {
+            (void)e;
         }
-    }
-    END_DEBUG_TIMING(timing, ellipse_search);
-
-    // if we found a code, copy over the data we recovered
-    if (found) {
-        memcpy(out_data, scan_data + 4, KIK_CODE_TOTAL_BYTE_COUNT);
-    }
-
-    if (out_progress != nullptr) {
-        *out_progress = progress;
     }
 
-    END_DEBUG_TIMING(timing, total);
-    return found;
+    return false;
 }
 
-string printDebugString(DebugTiming &debug, bool include_header=false)
+bool detectKikCode(Mat &greyscale, Mat *out_progress, uint32_t device_quality, uint8_t *out_data, uint32_t *out_x, uint32_t *out_y, uint32_t *out_scale, Mat *transform, bool output_snapshots)
 {
-    ostringstream oss;
-
-    if (include_header) {
-        oss << "\"total\",\"unsharp_image\",\"threshold\",\"dilate\",\"contours_1\",\"moment_pass_1\",\"ellipse_fitting_1\","
-            << "\"and_ellipses\",\"contours_2\",\"moment_pass_2\",\"ellipse_fitting_2\",\"ellipse_search\","
-            << "\"generate_scene_points\",\"find_homography\",\"transform_finder_points\",\"transform_all_points\","
-            << "\"extract_data\",\"efp\",\"efp_compute_offset\",\"efp_ellipse_region\",\"efp_and\","
-            << "\"efp_contours\",\"efp_moments\",\"efp_extraction\",\"efp_filter_and_sort\",\"efp_check_ratio\","
-            << "\"ellipses_fit\",\"ellipses_fit_matches\",\"ellipses_fit_2\",\"ellipses_fit_2_matches\","
-            << "\"ellipse_candidates\",\"ellipses_searched\"" << endl;
-    }
-
-    oss << debug.total << ", ";
-    oss << debug.unsharp_image << ", ";
-    oss << debug.threshold << ", ";
-    oss << debug.dilate << ", ";
-    oss << debug.contours_1 << ", ";
-    oss << debug.moment_pass_1 << ", ";
-    oss << debug.ellipse_fitting_1 << ", ";
-    oss << debug.and_ellipses << ", ";
-    oss << debug.contours_2 << ", ";
-    oss << debug.moment_pass_2 << ", ";
-    oss << debug.ellipse_fitting_2 << ", ";
-    oss << debug.ellipse_search << ", ";
-    oss << debug.generate_scene_points << ", ";
-    oss << debug.find_homography << ", ";
-    oss << debug.transform_finder_points << ", ";
-    oss << debug.transform_all_points << ", ";
-    oss << debug.extract_data << ", ";
-    oss << debug.efp << ", ";
-    oss << debug.efp_compute_offset << ", ";
-    oss << debug.efp_ellipse_region << ", ";
-    oss << debug.efp_and << ", ";
-    oss << debug.efp_contours << ", ";
-    oss << debug.efp_moments << ", ";
-    oss << debug.efp_extraction << ", ";
-    oss << debug.efp_filter_and_sort << ", ";
-    oss << debug.efp_check_ratio << ", ";
-    oss << debug.ellipses_fit << ", ";
-    oss << debug.ellipses_fit_matches << ", ";
-    oss << debug.ellipses_fit_2 << ", ";
-    oss << debug.ellipses_fit_2_matches << ", ";
-    oss << debug.ellipse_candidates << ", ";
-    oss << debug.ellipses_searched << endl;
-
-    return oss.str();
+    KikCodeScanner scanner;
+
+    return scanner.detect(greyscale, out_progress, device_quality, out_data, out_x, out_y, out_scale, transform, output_snapshots);
 }
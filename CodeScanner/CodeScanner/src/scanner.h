@@ -6,52 +6,505 @@
 #define SCAN_DEVICE_QUALITY_HIGH   8
 #define SCAN_DEVICE_QUALITY_BEST   10
 
+#define FINDER_POINT_COUNT 9
+
+// modules in the five data rings, 32 + 8r in ring r
+#define DATA_MODULE_COUNT  280
+
+// codes whose samples are accumulated at the same time
+#define ACCUMULATOR_COUNT  4
+
+// what the quality gate made of the last frame
+#define SCAN_FRAME_ACCEPTED  0
+#define SCAN_FRAME_BLURRED   1
+#define SCAN_FRAME_UNCHANGED 2
+
+#include <atomic>
 #include <iostream>
+#include <memory>
+#include <vector>
 
 #include <opencv2/core.hpp>
 
+#include "bitplane.h"
+#include "blob_analyzer.h"
+#include "frame_quality.h"
+#include "kikcode_scan.h"
+#include "local_threshold.h"
+#include "sharpen_threshold.h"
+#include "worker_pool.h"
+
 typedef struct {
-    double total;
-    
-    double unsharp_image;
-    double threshold;
-    double dilate;
-    double contours_1;
-    double moment_pass_1;
-    double ellipse_fitting_1;
-    double and_ellipses;
-    double contours_2;
-    double moment_pass_2;
-    double ellipse_fitting_2;
-    double ellipse_search;
-    double generate_scene_points;
-    double find_homography;
-    double transform_finder_points;
-    double transform_all_points;
-    double extract_data;
-
-    // extract finder points
-    double efp;
-    double efp_compute_offset;
-    double efp_ellipse_region;
-    double efp_and;
-    double efp_contours;
-    double efp_moments;
-    double efp_extraction;
-    double efp_filter_and_sort;
-    double efp_check_ratio;
-
-    // counting
-    unsigned int ellipses_fit;
-    unsigned int ellipses_fit_matches;
-    unsigned int ellipses_fit_2;
-    unsigned int ellipses_fit_2_matches;
-    unsigned int ellipse_candidates;
-    unsigned int ellipses_searched;
-} DebugTiming;
-
-std::string printDebugString(DebugTiming &debug, bool include_header);
-
-bool detectKikCode(cv::Mat &rgb_colour, cv::Mat *out_progress, uint32_t device_quality, uint8_t *out_data, uint32_t *out_x, uint32_t *out_y, uint32_t *out_scale, cv::Mat *transform, DebugTiming *timing, bool output_snapshots=false);
+    double dx;
+    double dy;
+
+    double x;
+    double y;
+
+    double angle;
+    double dist;
+
+    int contourIndex;
+    int contourSize;
+} FinderPoint;
+
+/**
+ * A reusable scanning context. Every frame-sized buffer used by the detection pipeline is owned
+ * by the scanner and only (re)allocated when the working resolution changes, so scanning a stream
+ * of camera frames at a fixed capture resolution does not allocate any new image memory per frame.
+ *
+ * A scanner is not thread-safe, use one instance per scanning thread.
+ */
+class KikCodeScanner {
+public:
+    KikCodeScanner();
+
+    /**
+     * Creates a scanner with its buffers already sized for frames of the given capture resolution.
+     */
+    KikCodeScanner(uint32_t width, uint32_t height, uint32_t device_quality);
+
+    /**
+     * Sizes every working buffer for frames of the given capture resolution and device quality.
+     * Calling this is optional, scan() will size the buffers on the first frame, but it moves
+     * the allocation cost out of the capture loop.
+     */
+    void reserve(uint32_t width, uint32_t height, uint32_t device_quality);
+
+    /**
+     * Scans a full-resolution, 8-bit greyscale frame for up to max_results Kik codes. The frame is
+     * downscaled into the scanner's working buffer according to device_quality and is never
+     * modified, so it may be a non-owning view onto the caller's memory.
+     *
+     * Result positions, scales and transforms are in working-resolution coordinates. Candidates
+     * that fall inside a code that has already been found are skipped.
+     *
+     * @returns The number of results written to out_results
+     */
+    size_t scan(const cv::Mat &frame, uint32_t device_quality, KikCodeScanResult *out_results, size_t max_results);
+
+    /**
+     * Runs the detection pipeline directly on a working-resolution greyscale image. The image is
+     * sharpened in place on higher quality devices.
+     */
+    bool detect(cv::Mat &greyscale, cv::Mat *out_progress, uint32_t device_quality, uint8_t *out_data, uint32_t *out_x, uint32_t *out_y, uint32_t *out_scale, cv::Mat *transform, bool output_snapshots=false);
+
+    /**
+     * Enables or disables tracking mode. While tracking, scan() remembers where the last code was
+     * found and first searches a crop around it, expanded on every side by motion_margin times the
+     * size of the code. After max_misses consecutive frames without a detection in the crop the
+     * scanner goes back to searching the full frame.
+     */
+    void setTracking(bool enabled, uint32_t max_misses, double motion_margin);
+
+    /**
+     * Forgets the last detection, the next frame is searched in full.
+     */
+    void resetTracking();
+
+    /**
+     * Evaluates ellipse candidates on a pool of thread_count background threads (plus the
+     * scanning thread) instead of one after another. As soon as a candidate decodes, candidates
+     * after it are skipped. Passing 0 goes back to evaluating candidates serially.
+     */
+    void setWorkerThreads(size_t thread_count);
+
+    /**
+     * Enables or disables local thresholding of light codes. Besides the pixels above the fixed
+     * threshold, pixels that are light relative to their surroundings then also count as light,
+     * which keeps codes in shadow or under a lighting gradient intact.
+     */
+    void setLocalThreshold(bool enabled);
+
+    /**
+     * Enables or disables validation. While validating, a candidate only counts as a code if its
+     * data error corrects, and the corrected data is returned. A candidate that doesn't is
+     * passed over and the search continues with the next one, so a false positive can't hide a
+     * real code further down the list. With accumulation also enabled, a candidate that doesn't
+     * correct on its own is only passed over if it doesn't correct averaged with the samples
+     * accumulated for the code near it either.
+     */
+    void setValidation(bool enabled);
+
+    /**
+     * Enables or disables soft-bit accumulation. While accumulating, the scanner keeps a running
+     * average of how light or dark every module of each code in view was read, over up to
+     * max_frames frames. When a code found in a frame can't be error corrected on its own, it is
+     * corrected from the averaged evidence instead and the corrected data is returned. A code's
+     * evidence is dropped once it hasn't been seen for max_misses consecutive scans.
+     */
+    void setAccumulation(bool enabled, uint32_t max_frames, uint32_t max_misses);
+
+    /**
+     * Drops all accumulated evidence.
+     */
+    void resetAccumulation();
+
+    /**
+     * Enables or disables adaptive resolution. While adapting, the working resolution of each frame
+     * is chosen from the apparent size of the codes found in recent frames and from how many recent
+     * frames found nothing, rather than from device_quality, with its longer edge kept between
+     * min_edge and max_edge. A code that fills the frame is then scanned at a low resolution, and a
+     * distant one, or a code that hasn't been found lately, at a high one.
+     */
+    void setAdaptiveResolution(bool enabled, uint32_t min_edge, uint32_t max_edge);
+
+    /**
+     * Forgets the recent detections, the next frame is scanned at the resolution device_quality
+     * calls for.
+     */
+    void resetAdaptiveResolution();
+
+    /**
+     * Enables or disables the quality gate. While gating, every frame is first measured on a sparse
+     * grid of samples, and scan() returns 0 straight away for frames that are too blurred to read,
+     * with a sharpness below min_sharpness (see FrameQuality), and for frames whose hash is no more
+     * than max_hash_distance bits from that of the last frame that was scanned and nothing was
+     * found in.
+     * lastFrameStatus() tells these apart from frames that were scanned.
+     *
+     * Rejected frames don't count as misses for tracking, accumulation or adaptive resolution.
+     */
+    void setQualityGate(bool enabled, uint32_t min_sharpness, uint32_t max_hash_distance);
+
+    /**
+     * @returns SCAN_FRAME_ACCEPTED if the last frame was scanned, SCAN_FRAME_BLURRED or
+     * SCAN_FRAME_UNCHANGED if the quality gate rejected it
+     */
+    uint32_t lastFrameStatus() const
+    {
+        return frame_status_;
+    }
+
+    /**
+     * @returns The KIK_CODE_SCAN_RESULT_ code for the last frame, which found count codes
+     */
+    int resultCode(size_t count) const;
+
+    /**
+     * Enables or disables pyramid mode. Scans of the full frame then look for candidates in a
+     * copy a quarter of the working resolution in each dimension, and only search for each
+     * candidate's code at the working resolution, in a crop around it.
+     *
+     * This trades recall for time. A code is only searched for if its centre ring is a candidate
+     * in the quarter size copy, where it needs to be about four pixels across to survive the
+     * threshold, so codes under about 50 working pixels across are never found, though a scan at
+     * the working resolution would. Each crop is scanned in full, finding its candidates again
+     * at the working resolution, so a frame costs the quarter size scan plus about one small scan
+     * per candidate, and a frame with many false candidates can cost more than scanning it whole.
+     * Crops are thresholded as the whole frame is, local thresholding included.
+     */
+    void setPyramid(bool enabled);
+
+    /**
+     * Limits the time scan() spends on a frame to budget_us microseconds, 0 for no limit. With a
+     * budget, candidates are evaluated most likely first, ranked by how circular their centre is,
+     * how close its size is to that of the last code found and how close it is to where that code
+     * was, and once the budget is spent the rest of them are skipped. The budget is checked
+     * before each candidate, so a frame can run over it by the time finding the candidates takes
+     * plus one candidate's evaluation.
+     */
+    void setTimeBudget(uint32_t budget_us);
+
+    /**
+     * @returns False if the time budget ran out before every candidate of the last frame was
+     * evaluated, so a code in it may have been missed
+     */
+    bool lastScanExhaustive() const
+    {
+        return search_exhaustive_;
+    }
+
+    /**
+     * @returns The working resolution the last frame was scanned at, empty if the quality gate
+     * turned it away
+     */
+    cv::Size lastWorkingSize() const
+    {
+        return last_working_size_;
+    }
+
+    /**
+     * @returns The working resolution the next frame of the same size will be scanned at, empty
+     * before the first frame was scanned
+     */
+    cv::Size nextWorkingSize() const
+    {
+        return next_working_size_;
+    }
+
+private:
+    // signed distance of each data module from the threshold, positive for a 1
+    typedef struct {
+        int8_t values[DATA_MODULE_COUNT];
+    } ModuleMargins;
+
+    typedef struct {
+        bool valid;
+
+        // in working-resolution coordinates of the full frame
+        cv::Point2f center;
+
+        uint32_t frames;
+        uint32_t misses;
+
+        // running average of the module margins
+        float margins[DATA_MODULE_COUNT];
+    } SoftAccumulator;
+
+    // everything a single candidate evaluation writes to, one per worker
+    typedef struct {
+        cv::Mat finder_point_range_storage;
+        cv::Mat candidate_region_storage;
+
+        std::vector<std::vector<cv::Point2i> > finder_contours;
+        std::vector<cv::Vec4i> finder_hierarchy;
+        std::vector<cv::Point2f> finder_centers;
+        std::vector<FinderPoint> finder_candidates;
+        std::vector<FinderPoint> finder_points;
+        std::vector<double> point_deltas;
+
+        std::vector<cv::Point2f> scene_finder_points;
+        std::vector<cv::Point2f> scene_corners;
+        std::vector<cv::Point2f> scene_points;
+    } CandidateScratch;
+
+    // shared state for one parallel candidate search
+    typedef struct {
+        KikCodeScanner *scanner;
+        cv::Mat *greyscale;
+        bool single_result;
+        bool output_snapshots;
+        std::atomic<size_t> first_found;
+
+        // candidates evaluated, for the tracer
+        std::atomic<size_t> searched;
+
+        // candidates not evaluated because the time budget ran out
+        std::atomic<size_t> skipped;
+    } CandidateSearch;
+
+    typedef struct {
+        bool valid;
+
+        // in working-resolution coordinates of the full frame
+        cv::Matx33d homography;
+
+        cv::Size frame_size;
+        cv::Size working_size;
+        uint32_t device_quality;
+        uint32_t misses;
+    } TrackingState;
+
+    typedef struct {
+        // longer edge of the next frame's working resolution, 0 until the first frame
+        uint32_t edge;
+
+        // size of the smallest code last found, relative to the longer edge of the frame it was
+        // found in, 0 if none has been found yet
+        double code_size;
+
+        // moving average of the frames that found nothing
+        double miss_rate;
+    } ResolutionState;
+
+    typedef struct {
+        bool valid;
+
+        // where the last code was found, relative to the working resolution it was found at, and
+        // its size relative to the longer edge of it
+        cv::Point2f center;
+        double size;
+    } CandidateHint;
+
+    bool tracking_enabled_;
+    uint32_t tracking_max_misses_;
+    double tracking_motion_margin_;
+    TrackingState tracking_;
+
+    bool validation_enabled_;
+
+    bool pyramid_enabled_;
+
+    bool quality_gate_enabled_;
+    uint32_t quality_min_sharpness_;
+    uint32_t quality_max_hash_distance_;
+    uint32_t frame_status_;
+
+    // hash of the last frame that was scanned and nothing was found in
+    bool failed_hash_valid_;
+    uint64_t failed_hash_;
+
+    bool adaptive_enabled_;
+    uint32_t adaptive_min_edge_;
+    uint32_t adaptive_max_edge_;
+    ResolutionState resolution_;
+
+    // what the last frame was scanned at and what adaptResolution picked for the next one
+    cv::Size last_working_size_;
+    cv::Size next_working_size_;
+
+    // time budget of a frame, and the timestamp its search has to stop at, 0 for none
+    uint32_t budget_us_;
+    uint64_t deadline_;
+    bool search_exhaustive_;
+
+    // candidates are ranked by how well they fit the last code found
+    CandidateHint hint_;
+
+    bool accumulation_enabled_;
+    uint32_t accumulation_max_frames_;
+    uint32_t accumulation_max_misses_;
+    SoftAccumulator accumulators_[ACCUMULATOR_COUNT];
+
+    // constants of the Kik code layout, computed once per scanner
+    double finder_deltas_[FINDER_POINT_COUNT - 1];
+    std::vector<cv::Point2f> object_finder_points_;
+    std::vector<cv::Point2f> object_data_points_;
+
+    // frame-sized working buffers, each a view onto the top-left corner of a storage buffer that
+    // only ever grows so that smaller regions (such as tracking crops) reuse the same memory
+    cv::Mat working_storage_;
+    cv::Mat contour_mat_storage_;
+    cv::Mat working_;
+    cv::Mat contour_mat_;
+
+    // only used to sharpen frames too small for the fused kernel, so left to OpenCV to allocate
+    cv::Mat blurred_;
+
+    // the light areas of the frame, and the fitted ellipse boundaries within them, packed a bit
+    // per pixel
+    Bitplane whitish_;
+    Bitplane ellipse_boundaries_;
+
+    // sharpens and thresholds the whitish plane in one pass, with its own row buffers
+    SharpenThreshold sharpen_threshold_;
+
+    // the whitish plane of the last frame was thresholded by sharpen_threshold_ rather than from
+    // the frame's own pixels, so that's what module margins are measured with
+    bool sharpen_thresholded_;
+
+    // labels and measures the blobs of the whitish plane, so that only the ones that could be the
+    // centre of a code have their contours traced
+    BlobAnalyzer blob_analyzer_;
+    cv::Mat blob_region_storage_;
+    cv::Mat blob_region_;
+    std::vector<std::vector<cv::Point2i> > blob_contours_;
+
+    // per-frame scratch space, cleared rather than released between frames
+    std::vector<std::vector<cv::Point2i> > contours_;
+    std::vector<cv::Vec4i> hierarchy_;
+    std::vector<cv::Moments> mu_;
+    std::vector<size_t> ellipse_contour_indices_;
+    std::vector<std::vector<cv::Point2i> > pruned_contours_;
+    std::vector<cv::RotatedRect> potential_ellipses_;
+    std::vector<size_t> potential_contour_indices_;
+    std::vector<cv::RotatedRect> ellipses_;
+    std::vector<size_t> contour_indices_;
+
+    // the image candidates are being found in is a crop at this offset of a working-resolution
+    // frame this size
+    cv::Point2f candidate_origin_;
+    cv::Size candidate_frame_size_;
+
+    // ranking of the candidates when there's a time budget
+    std::vector<double> candidate_scores_;
+    std::vector<size_t> candidate_order_;
+
+    // candidate evaluation
+    std::unique_ptr<WorkerPool> pool_;
+    std::vector<CandidateScratch> scratch_;
+    std::vector<char> candidate_high_;
+    std::vector<char> candidate_found_;
+    std::vector<KikCodeScanResult> candidate_results_;
+    std::vector<ModuleMargins> candidate_margins_;
+    std::vector<ModuleMargins> result_margins_;
+
+    // the coarse candidates of a pyramid scan, and the results found in the crops around them
+    std::vector<cv::RotatedRect> pyramid_candidates_;
+    std::vector<KikCodeScanResult> pyramid_results_;
+    std::vector<ModuleMargins> pyramid_margins_;
+
+    // summed-area table of the frame being searched, built once a frame needs it and then shared
+    // by every candidate
+    LocalThreshold local_threshold_;
+    bool local_threshold_built_;
+    bool local_threshold_enabled_;
+
+    // the window light pixels of the last frame were thresholded with, with local thresholding
+    int whitish_local_radius_;
+
+    // window radius dark codes are thresholded with in the frame being searched
+    int blackish_radius_;
+
+    cv::Size workingSize(uint32_t width, uint32_t height, uint32_t device_quality, double *out_scale) const;
+
+    void allocateBuffers(cv::Size size);
+
+    cv::Mat &workingBuffer(cv::Size size);
+
+    bool trackingRegion(cv::Size frame_size, cv::Size working_size, cv::Rect *out_region) const;
+
+    void adaptResolution(const KikCodeScanResult *results, size_t result_count, cv::Size frame_size, cv::Size working_size, uint32_t device_quality);
+
+    size_t scanFrame(const cv::Mat &frame, uint32_t device_quality, KikCodeScanResult *out_results, size_t max_results);
+
+    size_t scanPyramid(const cv::Mat &frame, cv::Size size, double scaling_rate, uint32_t device_quality, KikCodeScanResult *out_results, size_t max_results);
+
+    size_t detectRegion(cv::Mat &greyscale, double scaling_rate, cv::Mat *out_progress, uint32_t device_quality, KikCodeScanResult *out_results, size_t max_results, bool output_snapshots);
+
+    size_t findCandidates(cv::Mat &greyscale, double scaling_rate, cv::Mat *out_progress, uint32_t device_quality, bool output_snapshots);
+
+    size_t searchCandidates(cv::Mat &greyscale, KikCodeScanResult *out_results, size_t max_results, bool output_snapshots);
+
+    void startBudget();
+    bool pastDeadline() const;
+
+    double candidateScore(const cv::RotatedRect &ellipse, cv::Point2f origin, double factor) const;
+
+    /**
+     * Sorts ellipses, and contour_indices along with them if not null, most likely candidate first.
+     * The ellipses are in a crop at origin of the working-resolution frame, scaled down by factor.
+     */
+    void orderCandidates(std::vector<cv::RotatedRect> &ellipses, std::vector<size_t> *contour_indices, cv::Point2f origin, double factor);
+
+    int moduleMargin(const cv::Mat &greyscale, int x, int y, bool check_high) const;
+
+    size_t accumulate(KikCodeScanResult *results, size_t result_count);
+    int nearestAccumulator(cv::Point2f center, double scale, uint32_t pending_misses) const;
+    void addFrame(SoftAccumulator &accumulator, const ModuleMargins &margins) const;
+    bool correctAccumulated(const SoftAccumulator &accumulator, KikCodeScanResult &result) const;
+    bool readableAccumulated(cv::Point2f center, double scale, const ModuleMargins &margins) const;
+
+    bool isCandidateDark(const cv::RotatedRect &candidate_center, const std::vector<cv::Point2i> &contour) const;
+
+    void ensureLocalThreshold(const cv::Mat &greyscale);
+
+    /**
+     * Traces the contour findContours would give blob, its outer boundary or, for a hole, the
+     * boundary around it, from only the region of the whitish plane around the blob.
+     *
+     * @returns False if the contour couldn't be found
+     */
+    bool traceBlob(const BlobAnalyzer::Blob &blob, std::vector<cv::Point2i> &out_contour);
+
+    size_t searchCandidatesParallel(cv::Mat &greyscale, KikCodeScanResult *out_results, size_t max_results, bool output_snapshots);
+
+    static void evaluateCandidateTask(void *context, size_t task, size_t worker);
+
+    bool evaluateCandidate(CandidateScratch &scratch, int ellipse_id, bool check_high, cv::RotatedRect candidate_center, cv::Mat &greyscale, KikCodeScanResult *out_result, ModuleMargins *out_margins, bool output_snapshots);
+
+    bool overlapsResult(cv::Point2f point, const KikCodeScanResult *results, size_t result_count) const;
+
+    void unsharpMask(cv::Mat &im);
+
+    bool extractFinderPoints(CandidateScratch &scratch, int ellipse_id, bool check_high, cv::RotatedRect inner_ring, bool debug);
+};
+
+/**
+ * Convenience wrapper that runs a single detection with a temporary scanner. Prefer holding on to
+ * a KikCodeScanner when scanning more than one frame.
+ */
+bool detectKikCode(cv::Mat &greyscale, cv::Mat *out_progress, uint32_t device_quality, uint8_t *out_data, uint32_t *out_x, uint32_t *out_y, uint32_t *out_scale, cv::Mat *transform, bool output_snapshots=false);
 
 #endif // __SCANNER_H__
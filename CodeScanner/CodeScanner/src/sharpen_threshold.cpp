@@ -0,0 +1,423 @@
+#include "sharpen_threshold.h"
+
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SHARPEN_NEON 1
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#define SHARPEN_AVX2 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define SHARPEN_SSE2 1
+#endif
+
+using namespace std;
+
+#define SHARPEN_RING_SIZE  SHARPEN_WIDE_TAP_COUNT
+
+// horizontal blurs are halved to fit in int16, vertical ones are then Q15 of the blurred value:
+// 256 * 256 / 2
+#define SHARPEN_BLUR_SHIFT  15
+
+namespace {
+    /**
+     * Reflects an index into [0, n) without repeating the edge, like BORDER_REFLECT_101.
+     * Only valid for indices less than n away from the range.
+     */
+    inline int reflect(int i, int n)
+    {
+        if (i < 0) {
+            return -i;
+        }
+
+        if (i >= n) {
+            return 2 * n - 2 - i;
+        }
+
+        return i;
+    }
+
+    void createKernel(double sigma, int16_t *out_weights, int tap_count)
+    {
+        int radius = tap_count / 2;
+        double sum = 0.0;
+
+        for (int k = 0; k < tap_count; ++k) {
+            sum += exp(-(k - radius) * (k - radius) / (2.0 * sigma * sigma));
+        }
+
+        int total = 0;
+
+        for (int k = 0; k < tap_count; ++k) {
+            out_weights[k] = (int16_t)lround(256.0 * exp(-(k - radius) * (k - radius) / (2.0 * sigma * sigma)) / sum);
+            total += out_weights[k];
+        }
+
+        // rounding can leave the sum a little off, which would shift the overall brightness
+        out_weights[radius] += 256 - total;
+    }
+
+    inline uint8_t combinePixel(int source, int32_t blurred, int32_t wide_blurred, int32_t limit)
+    {
+        // 4 S in Q15: 9 I - 6 G(2) + G(2 sqrt 2)
+        int32_t response = (source << 18) + (source << 15) - 6 * blurred + wide_blurred;
+
+        return response >= limit ? 255 : 0;
+    }
+}
+
+SharpenThreshold::SharpenThreshold()
+: ring_(SHARPEN_RING_SIZE * SHARPEN_TILE_WIDTH)
+, wide_ring_(SHARPEN_RING_SIZE * SHARPEN_TILE_WIDTH)
+{
+    createKernel(2.0, weights_, SHARPEN_TAP_COUNT);
+    createKernel(2.0 * sqrt(2.0), wide_weights_, SHARPEN_WIDE_TAP_COUNT);
+
+    padded_.resize(SHARPEN_TILE_WIDTH + 2 * SHARPEN_WIDE_RADIUS);
+}
+
+bool SharpenThreshold::apply(const uint8_t *src, size_t src_stride, uint8_t *dst, size_t dst_stride, int width, int height, int threshold)
+{
+    if (width < SHARPEN_WIDE_TAP_COUNT || height < SHARPEN_WIDE_TAP_COUNT) {
+        return false;
+    }
+
+    // S > threshold once rounded, in the same scale as the response
+    const int32_t limit = (4 * threshold + 2) << SHARPEN_BLUR_SHIFT;
+
+    const int16_t *rows[SHARPEN_TAP_COUNT];
+    const int16_t *wide_rows[SHARPEN_WIDE_TAP_COUNT];
+
+    for (int x0 = 0; x0 < width; x0 += SHARPEN_TILE_WIDTH) {
+        int tile_width = min(SHARPEN_TILE_WIDTH, width - x0);
+        int blurred_rows = 0;
+
+        for (int y = 0; y < height; ++y) {
+            // blur the rows coming into the vertical window, each one lands in the slot of a row
+            // that has just left it
+            int last_row = min(y + SHARPEN_WIDE_RADIUS, height - 1);
+
+            for (; blurred_rows <= last_row; ++blurred_rows) {
+                size_t slot = (blurred_rows % SHARPEN_RING_SIZE) * SHARPEN_TILE_WIDTH;
+
+                blurRow(src + blurred_rows * src_stride, width, x0, tile_width, &ring_[slot], &wide_ring_[slot]);
+            }
+
+            for (int k = 0; k < SHARPEN_TAP_COUNT; ++k) {
+                int row = reflect(y - SHARPEN_RADIUS + k, height);
+                rows[k] = &ring_[(row % SHARPEN_RING_SIZE) * SHARPEN_TILE_WIDTH];
+            }
+
+            for (int k = 0; k < SHARPEN_WIDE_TAP_COUNT; ++k) {
+                int row = reflect(y - SHARPEN_WIDE_RADIUS + k, height);
+                wide_rows[k] = &wide_ring_[(row % SHARPEN_RING_SIZE) * SHARPEN_TILE_WIDTH];
+            }
+
+            combineRow(src + y * src_stride + x0, rows, wide_rows, dst + y * dst_stride + x0, tile_width, limit);
+        }
+    }
+
+    return true;
+}
+
+int SharpenThreshold::margin(const uint8_t *src, size_t src_stride, int width, int height, int x, int y, int threshold) const
+{
+    int32_t blurred = 0;
+    int32_t wide_blurred = 0;
+
+    // the horizontal blurs of each row are halved, as blurRow() stores them
+    for (int k = 0; k < SHARPEN_TAP_COUNT; ++k) {
+        const uint8_t *row = src + reflect(y - SHARPEN_RADIUS + k, height) * src_stride;
+        int sum = 0;
+
+        for (int j = 0; j < SHARPEN_TAP_COUNT; ++j) {
+            sum += row[reflect(x - SHARPEN_RADIUS + j, width)] * weights_[j];
+        }
+
+        blurred += (sum >> 1) * weights_[k];
+    }
+
+    for (int k = 0; k < SHARPEN_WIDE_TAP_COUNT; ++k) {
+        const uint8_t *row = src + reflect(y - SHARPEN_WIDE_RADIUS + k, height) * src_stride;
+        int sum = 0;
+
+        for (int j = 0; j < SHARPEN_WIDE_TAP_COUNT; ++j) {
+            sum += row[reflect(x - SHARPEN_WIDE_RADIUS + j, width)] * wide_weights_[j];
+        }
+
+        wide_blurred += (sum >> 1) * wide_weights_[k];
+    }
+
+    int source = src[y * src_stride + x];
+    int32_t response = (source << 18) + (source << 15) - 6 * blurred + wide_blurred;
+    int32_t above = response - ((4 * threshold + 2) << SHARPEN_BLUR_SHIFT);
+
+    // rounded down, so that every response below the limit is negative
+    const int32_t level = 4 << SHARPEN_BLUR_SHIFT;
+
+    return above >= 0 ? above / level : -((level - 1 - above) / level);
+}
+
+/**
+ * Blurs the tile of a source row horizontally with both kernels. The results are halved so that
+ * they fit in int16 for the vertical pass.
+ */
+void SharpenThreshold::blurRow(const uint8_t *src_row, int width, int x0, int tile_width, int16_t *out, int16_t *out_wide)
+{
+    uint8_t *padded = &padded_[0];
+
+    // padded[i] is column x0 - SHARPEN_WIDE_RADIUS + i
+    int first = x0 - SHARPEN_WIDE_RADIUS;
+    int padded_width = tile_width + 2 * SHARPEN_WIDE_RADIUS;
+
+    if (first >= 0 && first + padded_width <= width) {
+        memcpy(padded, src_row + first, padded_width);
+    }
+    else {
+        for (int i = 0; i < padded_width; ++i) {
+            padded[i] = src_row[reflect(first + i, width)];
+        }
+    }
+
+    // the narrow kernel is centered on the same pixel as the wide one
+    const uint8_t *narrow = padded + (SHARPEN_WIDE_RADIUS - SHARPEN_RADIUS);
+    int x = 0;
+
+#if SHARPEN_NEON
+    for (; x + 8 <= tile_width; x += 8) {
+        uint16x8_t sum = vmull_u8(vld1_u8(narrow + x), vdup_n_u8((uint8_t)weights_[0]));
+        uint16x8_t wide_sum = vmull_u8(vld1_u8(padded + x), vdup_n_u8((uint8_t)wide_weights_[0]));
+
+        for (int k = 1; k < SHARPEN_TAP_COUNT; ++k) {
+            sum = vmlal_u8(sum, vld1_u8(narrow + x + k), vdup_n_u8((uint8_t)weights_[k]));
+        }
+
+        for (int k = 1; k < SHARPEN_WIDE_TAP_COUNT; ++k) {
+            wide_sum = vmlal_u8(wide_sum, vld1_u8(padded + x + k), vdup_n_u8((uint8_t)wide_weights_[k]));
+        }
+
+        vst1q_s16(out + x, vreinterpretq_s16_u16(vshrq_n_u16(sum, 1)));
+        vst1q_s16(out_wide + x, vreinterpretq_s16_u16(vshrq_n_u16(wide_sum, 1)));
+    }
+#elif SHARPEN_AVX2
+    for (; x + 16 <= tile_width; x += 16) {
+        __m256i sum = _mm256_setzero_si256();
+        __m256i wide_sum = _mm256_setzero_si256();
+
+        // the sums stay below 65536, so 16-bit lanes can't overflow
+        for (int k = 0; k < SHARPEN_TAP_COUNT; ++k) {
+            __m256i pixels = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(narrow + x + k)));
+            sum = _mm256_add_epi16(sum, _mm256_mullo_epi16(pixels, _mm256_set1_epi16(weights_[k])));
+        }
+
+        for (int k = 0; k < SHARPEN_WIDE_TAP_COUNT; ++k) {
+            __m256i pixels = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(padded + x + k)));
+            wide_sum = _mm256_add_epi16(wide_sum, _mm256_mullo_epi16(pixels, _mm256_set1_epi16(wide_weights_[k])));
+        }
+
+        _mm256_storeu_si256((__m256i *)(out + x), _mm256_srli_epi16(sum, 1));
+        _mm256_storeu_si256((__m256i *)(out_wide + x), _mm256_srli_epi16(wide_sum, 1));
+    }
+#elif SHARPEN_SSE2
+    const __m128i zero = _mm_setzero_si128();
+
+    for (; x + 8 <= tile_width; x += 8) {
+        __m128i sum = _mm_setzero_si128();
+        __m128i wide_sum = _mm_setzero_si128();
+
+        // the sums stay below 65536, so 16-bit lanes can't overflow
+        for (int k = 0; k < SHARPEN_TAP_COUNT; ++k) {
+            __m128i pixels = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(narrow + x + k)), zero);
+            sum = _mm_add_epi16(sum, _mm_mullo_epi16(pixels, _mm_set1_epi16(weights_[k])));
+        }
+
+        for (int k = 0; k < SHARPEN_WIDE_TAP_COUNT; ++k) {
+            __m128i pixels = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(padded + x + k)), zero);
+            wide_sum = _mm_add_epi16(wide_sum, _mm_mullo_epi16(pixels, _mm_set1_epi16(wide_weights_[k])));
+        }
+
+        _mm_storeu_si128((__m128i *)(out + x), _mm_srli_epi16(sum, 1));
+        _mm_storeu_si128((__m128i *)(out_wide + x), _mm_srli_epi16(wide_sum, 1));
+    }
+#endif
+
+    for (; x < tile_width; ++x) {
+        int sum = 0;
+        int wide_sum = 0;
+
+        for (int k = 0; k < SHARPEN_TAP_COUNT; ++k) {
+            sum += narrow[x + k] * weights_[k];
+        }
+
+        for (int k = 0; k < SHARPEN_WIDE_TAP_COUNT; ++k) {
+            wide_sum += padded[x + k] * wide_weights_[k];
+        }
+
+        out[x] = (int16_t)(sum >> 1);
+        out_wide[x] = (int16_t)(wide_sum >> 1);
+    }
+}
+
+/**
+ * Blurs the horizontally blurred rows around an output row vertically, combines them with the
+ * source row into the sharpened response and thresholds it.
+ */
+void SharpenThreshold::combineRow(const uint8_t *src_row, const int16_t **rows, const int16_t **wide_rows, uint8_t *dst_row, int tile_width, int32_t limit) const
+{
+    int x = 0;
+
+#if SHARPEN_NEON
+    const int32x4_t limits = vdupq_n_s32(limit);
+
+    for (; x + 8 <= tile_width; x += 8) {
+        int32x4_t low = vdupq_n_s32(0);
+        int32x4_t high = vdupq_n_s32(0);
+        int32x4_t wide_low = vdupq_n_s32(0);
+        int32x4_t wide_high = vdupq_n_s32(0);
+
+        for (int k = 0; k < SHARPEN_TAP_COUNT; ++k) {
+            int16x8_t row = vld1q_s16(rows[k] + x);
+            low = vmlal_n_s16(low, vget_low_s16(row), weights_[k]);
+            high = vmlal_n_s16(high, vget_high_s16(row), weights_[k]);
+        }
+
+        for (int k = 0; k < SHARPEN_WIDE_TAP_COUNT; ++k) {
+            int16x8_t row = vld1q_s16(wide_rows[k] + x);
+            wide_low = vmlal_n_s16(wide_low, vget_low_s16(row), wide_weights_[k]);
+            wide_high = vmlal_n_s16(wide_high, vget_high_s16(row), wide_weights_[k]);
+        }
+
+        uint16x8_t source = vmovl_u8(vld1_u8(src_row + x));
+        int32x4_t source_low = vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(source)));
+        int32x4_t source_high = vreinterpretq_s32_u32(vmovl_u16(vget_high_u16(source)));
+
+        int32x4_t response_low = vaddq_s32(vshlq_n_s32(source_low, 18), vshlq_n_s32(source_low, 15));
+        int32x4_t response_high = vaddq_s32(vshlq_n_s32(source_high, 18), vshlq_n_s32(source_high, 15));
+
+        response_low = vaddq_s32(vmlsq_n_s32(response_low, low, 6), wide_low);
+        response_high = vaddq_s32(vmlsq_n_s32(response_high, high, 6), wide_high);
+
+        uint16x8_t mask = vcombine_u16(vmovn_u32(vcgeq_s32(response_low, limits)), vmovn_u32(vcgeq_s32(response_high, limits)));
+
+        vst1_u8(dst_row + x, vmovn_u16(mask));
+    }
+#elif SHARPEN_AVX2
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i limits = _mm256_set1_epi32(limit - 1);
+
+    // unpacking and packing work within 128-bit lanes, so the low halves hold pixels 0-3 and 8-11
+    // and the high halves 4-7 and 12-15, which packing puts back in order
+    for (; x + 16 <= tile_width; x += 16) {
+        __m256i low = _mm256_setzero_si256();
+        __m256i high = _mm256_setzero_si256();
+        __m256i wide_low = _mm256_setzero_si256();
+        __m256i wide_high = _mm256_setzero_si256();
+
+        // two rows at a time, as pairs of (row k, row k + 1) against (weight k, weight k + 1)
+        for (int k = 0; k < SHARPEN_TAP_COUNT; k += 2) {
+            __m256i a = _mm256_loadu_si256((const __m256i *)(rows[k] + x));
+            __m256i b = k + 1 < SHARPEN_TAP_COUNT ? _mm256_loadu_si256((const __m256i *)(rows[k + 1] + x)) : zero;
+            int16_t weight_b = k + 1 < SHARPEN_TAP_COUNT ? weights_[k + 1] : 0;
+            __m256i pair = _mm256_set1_epi32((uint16_t)weights_[k] | ((int32_t)weight_b << 16));
+
+            low = _mm256_add_epi32(low, _mm256_madd_epi16(_mm256_unpacklo_epi16(a, b), pair));
+            high = _mm256_add_epi32(high, _mm256_madd_epi16(_mm256_unpackhi_epi16(a, b), pair));
+        }
+
+        for (int k = 0; k < SHARPEN_WIDE_TAP_COUNT; k += 2) {
+            __m256i a = _mm256_loadu_si256((const __m256i *)(wide_rows[k] + x));
+            __m256i b = k + 1 < SHARPEN_WIDE_TAP_COUNT ? _mm256_loadu_si256((const __m256i *)(wide_rows[k + 1] + x)) : zero;
+            int16_t weight_b = k + 1 < SHARPEN_WIDE_TAP_COUNT ? wide_weights_[k + 1] : 0;
+            __m256i pair = _mm256_set1_epi32((uint16_t)wide_weights_[k] | ((int32_t)weight_b << 16));
+
+            wide_low = _mm256_add_epi32(wide_low, _mm256_madd_epi16(_mm256_unpacklo_epi16(a, b), pair));
+            wide_high = _mm256_add_epi32(wide_high, _mm256_madd_epi16(_mm256_unpackhi_epi16(a, b), pair));
+        }
+
+        __m256i source = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(src_row + x)));
+        __m256i source_low = _mm256_unpacklo_epi16(source, zero);
+        __m256i source_high = _mm256_unpackhi_epi16(source, zero);
+
+        __m256i response_low = _mm256_add_epi32(_mm256_slli_epi32(source_low, 18), _mm256_slli_epi32(source_low, 15));
+        __m256i response_high = _mm256_add_epi32(_mm256_slli_epi32(source_high, 18), _mm256_slli_epi32(source_high, 15));
+
+        response_low = _mm256_sub_epi32(response_low, _mm256_add_epi32(_mm256_slli_epi32(low, 2), _mm256_slli_epi32(low, 1)));
+        response_high = _mm256_sub_epi32(response_high, _mm256_add_epi32(_mm256_slli_epi32(high, 2), _mm256_slli_epi32(high, 1)));
+        response_low = _mm256_add_epi32(response_low, wide_low);
+        response_high = _mm256_add_epi32(response_high, wide_high);
+
+        __m256i mask = _mm256_packs_epi32(_mm256_cmpgt_epi32(response_low, limits), _mm256_cmpgt_epi32(response_high, limits));
+
+        mask = _mm256_packs_epi16(mask, mask);
+        mask = _mm256_permute4x64_epi64(mask, _MM_SHUFFLE(3, 1, 2, 0));
+
+        _mm_storeu_si128((__m128i *)(dst_row + x), _mm256_castsi256_si128(mask));
+    }
+#elif SHARPEN_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i limits = _mm_set1_epi32(limit - 1);
+
+    for (; x + 8 <= tile_width; x += 8) {
+        __m128i low = _mm_setzero_si128();
+        __m128i high = _mm_setzero_si128();
+        __m128i wide_low = _mm_setzero_si128();
+        __m128i wide_high = _mm_setzero_si128();
+
+        // two rows at a time, as pairs of (row k, row k + 1) against (weight k, weight k + 1)
+        for (int k = 0; k < SHARPEN_TAP_COUNT; k += 2) {
+            __m128i a = _mm_loadu_si128((const __m128i *)(rows[k] + x));
+            __m128i b = k + 1 < SHARPEN_TAP_COUNT ? _mm_loadu_si128((const __m128i *)(rows[k + 1] + x)) : zero;
+            int16_t weight_b = k + 1 < SHARPEN_TAP_COUNT ? weights_[k + 1] : 0;
+            __m128i pair = _mm_set1_epi32((uint16_t)weights_[k] | ((int32_t)weight_b << 16));
+
+            low = _mm_add_epi32(low, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), pair));
+            high = _mm_add_epi32(high, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), pair));
+        }
+
+        for (int k = 0; k < SHARPEN_WIDE_TAP_COUNT; k += 2) {
+            __m128i a = _mm_loadu_si128((const __m128i *)(wide_rows[k] + x));
+            __m128i b = k + 1 < SHARPEN_WIDE_TAP_COUNT ? _mm_loadu_si128((const __m128i *)(wide_rows[k + 1] + x)) : zero;
+            int16_t weight_b = k + 1 < SHARPEN_WIDE_TAP_COUNT ? wide_weights_[k + 1] : 0;
+            __m128i pair = _mm_set1_epi32((uint16_t)wide_weights_[k] | ((int32_t)weight_b << 16));
+
+            wide_low = _mm_add_epi32(wide_low, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), pair));
+            wide_high = _mm_add_epi32(wide_high, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), pair));
+        }
+
+        __m128i source = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(src_row + x)), zero);
+        __m128i source_low = _mm_unpacklo_epi16(source, zero);
+        __m128i source_high = _mm_unpackhi_epi16(source, zero);
+
+        __m128i response_low = _mm_add_epi32(_mm_slli_epi32(source_low, 18), _mm_slli_epi32(source_low, 15));
+        __m128i response_high = _mm_add_epi32(_mm_slli_epi32(source_high, 18), _mm_slli_epi32(source_high, 15));
+
+        response_low = _mm_sub_epi32(response_low, _mm_add_epi32(_mm_slli_epi32(low, 2), _mm_slli_epi32(low, 1)));
+        response_high = _mm_sub_epi32(response_high, _mm_add_epi32(_mm_slli_epi32(high, 2), _mm_slli_epi32(high, 1)));
+        response_low = _mm_add_epi32(response_low, wide_low);
+        response_high = _mm_add_epi32(response_high, wide_high);
+
+        __m128i mask = _mm_packs_epi32(_mm_cmpgt_epi32(response_low, limits), _mm_cmpgt_epi32(response_high, limits));
+
+        _mm_storel_epi64((__m128i *)(dst_row + x), _mm_packs_epi16(mask, mask));
+    }
+#endif
+
+    for (; x < tile_width; ++x) {
+        int32_t blurred = 0;
+        int32_t wide_blurred = 0;
+
+        for (int k = 0; k < SHARPEN_TAP_COUNT; ++k) {
+            blurred += rows[k][x] * weights_[k];
+        }
+
+        for (int k = 0; k < SHARPEN_WIDE_TAP_COUNT; ++k) {
+            wide_blurred += wide_rows[k][x] * wide_weights_[k];
+        }
+
+        dst_row[x] = combinePixel(src_row[x], blurred, wide_blurred, limit);
+    }
+}
@@ -0,0 +1,418 @@
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#define TRACE_EVENT_SPAN    0
+#define TRACE_EVENT_COUNTER 1
+
+std::atomic<bool> trace_enabled(false);
+thread_local TraceTotals *trace_thread_totals = nullptr;
+
+typedef struct {
+    const char *name;
+    uint64_t start;
+
+    // nanoseconds for a span, the bits of a double for a counter
+    uint64_t value;
+
+    uint32_t type;
+    uint32_t thread_id;
+} TraceEvent;
+
+/**
+ * One thread's events. Only the owning thread writes to it and only the collector reads from it,
+ * under the registry's lock. The writer claims a slot before overwriting it and publishes it once
+ * it's written, so the collector can tell the events it copied from ones overwritten meanwhile.
+ */
+typedef struct {
+    // the words of a TraceEvent, atomic so that reading one while it's overwritten isn't a race
+    std::atomic<uint64_t> slots[TRACE_BUFFER_EVENTS][4];
+
+    std::atomic<uint64_t> claimed;
+    std::atomic<uint64_t> written;
+    std::atomic<bool> in_use;
+
+    // events before this have been collected
+    uint64_t read;
+} TraceBuffer;
+
+typedef struct {
+    const char *name;
+    uint64_t durations[TRACE_HISTOGRAM_WINDOW];
+    size_t next;
+    size_t count;
+} TraceWindow;
+
+typedef struct {
+    std::mutex mutex;
+
+    // buffers are handed on to new threads once their thread exits, and never freed
+    std::vector<TraceBuffer *> buffers;
+    uint32_t next_thread_id;
+
+    std::deque<TraceEvent> events;
+    std::map<std::string, TraceWindow> windows;
+    uint64_t dropped;
+} TraceRegistry;
+
+static TraceRegistry &registry()
+{
+    // never destroyed, threads can still be tracing while the process exits
+    static TraceRegistry *registry = new TraceRegistry();
+
+    return *registry;
+}
+
+/**
+ * Gives a thread's buffer back once the thread exits.
+ */
+struct TraceThread {
+    TraceBuffer *buffer;
+    uint32_t id;
+
+    ~TraceThread()
+    {
+        if (buffer) {
+            buffer->in_use.store(false, std::memory_order_release);
+        }
+    }
+};
+
+static thread_local TraceThread trace_thread = { nullptr, 0 };
+
+static TraceBuffer *threadBuffer()
+{
+    if (trace_thread.buffer) {
+        return trace_thread.buffer;
+    }
+
+    TraceRegistry &tracer = registry();
+    lock_guard<mutex> lock(tracer.mutex);
+
+    TraceBuffer *buffer = nullptr;
+
+    for (size_t i = 0; i < tracer.buffers.size() && !buffer; ++i) {
+        bool in_use = false;
+
+        if (tracer.buffers[i]->in_use.compare_exchange_strong(in_use, true)) {
+            buffer = tracer.buffers[i];
+        }
+    }
+
+    if (!buffer) {
+        buffer = new TraceBuffer();
+        buffer->claimed = 0;
+        buffer->written = 0;
+        buffer->in_use = true;
+        buffer->read = 0;
+
+        tracer.buffers.push_back(buffer);
+    }
+
+    trace_thread.buffer = buffer;
+    trace_thread.id = ++tracer.next_thread_id;
+
+    return buffer;
+}
+
+static void record(const char *name, uint64_t start, uint64_t value, uint32_t type)
+{
+    TraceBuffer *buffer = threadBuffer();
+    uint64_t index = buffer->written.load(std::memory_order_relaxed);
+    std::atomic<uint64_t> *slot = buffer->slots[index & (TRACE_BUFFER_EVENTS - 1)];
+
+    buffer->claimed.store(index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot[0].store((uint64_t)(uintptr_t)name, std::memory_order_relaxed);
+    slot[1].store(start, std::memory_order_relaxed);
+    slot[2].store(value, std::memory_order_relaxed);
+    slot[3].store((uint64_t)type << 32 | trace_thread.id, std::memory_order_relaxed);
+
+    buffer->written.store(index + 1, std::memory_order_release);
+}
+
+uint64_t kikCodeTraceNow()
+{
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void kikCodeTraceRecordSpan(const char *name, uint64_t start, uint64_t duration)
+{
+    if (trace_thread_totals) {
+        trace_thread_totals->add(name, duration);
+    }
+
+    if (trace_enabled.load(std::memory_order_relaxed)) {
+        record(name, start, duration, TRACE_EVENT_SPAN);
+    }
+}
+
+void kikCodeTraceRecordCount(const char *name, double value)
+{
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    record(name, kikCodeTraceNow(), bits, TRACE_EVENT_COUNTER);
+}
+
+TraceTotals::TraceTotals()
+: entry_count_(0)
+, previous_(trace_thread_totals)
+{
+    trace_thread_totals = this;
+}
+
+TraceTotals::~TraceTotals()
+{
+    trace_thread_totals = previous_;
+}
+
+void TraceTotals::add(const char *name, uint64_t duration)
+{
+    for (size_t i = 0; i < entry_count_; ++i) {
+        if (entries_[i].name == name) {
+            entries_[i].duration += duration;
+            return;
+        }
+    }
+
+    if (entry_count_ < TRACE_TOTALS_CAPACITY) {
+        entries_[entry_count_].name = name;
+        entries_[entry_count_].duration = duration;
+        ++entry_count_;
+    }
+}
+
+double TraceTotals::milliseconds(const char *name) const
+{
+    // the same literal can end up at different addresses in different translation units
+    uint64_t duration = 0;
+
+    for (size_t i = 0; i < entry_count_; ++i) {
+        if (entries_[i].name == name || strcmp(entries_[i].name, name) == 0) {
+            duration += entries_[i].duration;
+        }
+    }
+
+    return duration / 1e6;
+}
+
+void TraceTotals::fillTiming(KikCodeScanTiming *timing) const
+{
+    timing->quality_gate = milliseconds("quality_gate");
+    timing->sharpen = milliseconds("unsharp_image");
+    timing->threshold = milliseconds("threshold");
+    timing->blobs = milliseconds("contours_1") + milliseconds("moment_pass_1");
+    timing->ellipses = milliseconds("ellipse_fitting_1") + milliseconds("and_ellipses") + milliseconds("ellipse_fitting_2");
+    timing->candidates = milliseconds("ellipse_search");
+}
+
+/**
+ * Moves the events written since the last collection into the registry. Called with its lock held.
+ */
+static void collect(TraceRegistry &tracer)
+{
+    vector<TraceEvent> copied;
+
+    for (size_t i = 0; i < tracer.buffers.size(); ++i) {
+        TraceBuffer *buffer = tracer.buffers[i];
+
+        uint64_t end = buffer->written.load(std::memory_order_acquire);
+        uint64_t begin = buffer->read;
+
+        if (end - begin > TRACE_BUFFER_EVENTS) {
+            tracer.dropped += end - begin - TRACE_BUFFER_EVENTS;
+            begin = end - TRACE_BUFFER_EVENTS;
+        }
+
+        copied.clear();
+
+        for (uint64_t index = begin; index < end; ++index) {
+            std::atomic<uint64_t> *slot = buffer->slots[index & (TRACE_BUFFER_EVENTS - 1)];
+
+            TraceEvent event;
+            event.name = (const char *)(uintptr_t)slot[0].load(std::memory_order_relaxed);
+            event.start = slot[1].load(std::memory_order_relaxed);
+            event.value = slot[2].load(std::memory_order_relaxed);
+
+            uint64_t word = slot[3].load(std::memory_order_relaxed);
+            event.type = (uint32_t)(word >> 32);
+            event.thread_id = (uint32_t)word;
+
+            copied.push_back(event);
+        }
+
+        // the slot of event i is reused by event i + TRACE_BUFFER_EVENTS, so any event that far
+        // behind the last one claimed may have been torn while it was copied
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t claimed = buffer->claimed.load(std::memory_order_relaxed);
+
+        for (uint64_t index = begin; index < end; ++index) {
+            if (index + TRACE_BUFFER_EVENTS < claimed) {
+                ++tracer.dropped;
+                continue;
+            }
+
+            const TraceEvent &event = copied[index - begin];
+
+            if (event.type == TRACE_EVENT_SPAN) {
+                TraceWindow &window = tracer.windows[event.name];
+
+                window.name = event.name;
+                window.durations[window.next] = event.value;
+                window.next = (window.next + 1) % TRACE_HISTOGRAM_WINDOW;
+                window.count = min(window.count + 1, (size_t)TRACE_HISTOGRAM_WINDOW);
+            }
+
+            if (tracer.events.size() == TRACE_EXPORT_EVENTS) {
+                tracer.events.pop_front();
+                ++tracer.dropped;
+            }
+
+            tracer.events.push_back(event);
+        }
+
+        buffer->read = end;
+    }
+}
+
+/**
+ * Writes name as a JSON string. Names are meant to be identifiers, so only the characters that
+ * would break the string are escaped.
+ */
+static void writeName(ostringstream &json, const char *name)
+{
+    json << '"';
+
+    for (const char *c = name; *c; ++c) {
+        if (*c == '"' || *c == '\\') {
+            json << '\\';
+        }
+
+        if ((unsigned char)*c >= 0x20) {
+            json << *c;
+        }
+    }
+
+    json << '"';
+}
+
+void kikCodeTraceSetEnabled(int enabled)
+{
+    trace_enabled.store(enabled != 0, std::memory_order_relaxed);
+}
+
+char *kikCodeTraceExportChrome(void)
+{
+    TraceRegistry &tracer = registry();
+    ostringstream json;
+
+    {
+        lock_guard<mutex> lock(tracer.mutex);
+
+        collect(tracer);
+
+        json.setf(ios::fixed);
+        json.precision(3);
+
+        json << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+        uint64_t last = 0;
+
+        // timestamps and durations are in microseconds
+        for (size_t i = 0; i < tracer.events.size(); ++i) {
+            const TraceEvent &event = tracer.events[i];
+
+            json << (i > 0 ? ",\n" : "\n") << "{\"name\":";
+            writeName(json, event.name);
+            json << ",\"pid\":1,\"tid\":" << event.thread_id << ",\"ts\":" << event.start / 1e3;
+
+            if (event.type == TRACE_EVENT_SPAN) {
+                json << ",\"ph\":\"X\",\"dur\":" << event.value / 1e3 << "}";
+            }
+            else {
+                double value;
+                memcpy(&value, &event.value, sizeof(value));
+
+                json << ",\"ph\":\"C\",\"args\":{\"value\":" << value << "}}";
+            }
+
+            last = max(last, event.start);
+        }
+
+        if (tracer.dropped > 0) {
+            json << (tracer.events.empty() ? "\n" : ",\n")
+                 << "{\"name\":\"dropped_events\",\"pid\":1,\"tid\":0,\"ts\":" << last / 1e3
+                 << ",\"ph\":\"C\",\"args\":{\"value\":" << tracer.dropped << "}}";
+        }
+
+        json << "\n]}\n";
+
+        tracer.events.clear();
+        tracer.dropped = 0;
+    }
+
+    string trace = json.str();
+    char *out = (char *)malloc(trace.size() + 1);
+
+    if (out) {
+        memcpy(out, trace.c_str(), trace.size() + 1);
+    }
+
+    return out;
+}
+
+void kikCodeTraceFree(char *trace)
+{
+    free(trace);
+}
+
+unsigned int kikCodeTraceHistograms(KikCodeTraceHistogram *out_histograms, unsigned int max_histograms)
+{
+    TraceRegistry &tracer = registry();
+    lock_guard<mutex> lock(tracer.mutex);
+
+    collect(tracer);
+
+    unsigned int histogram_count = 0;
+    uint64_t sorted[TRACE_HISTOGRAM_WINDOW];
+
+    for (map<string, TraceWindow>::const_iterator it = tracer.windows.begin(); it != tracer.windows.end() && histogram_count < max_histograms; ++it) {
+        const TraceWindow &window = it->second;
+        KikCodeTraceHistogram &histogram = out_histograms[histogram_count++];
+
+        memset(&histogram, 0, sizeof(histogram));
+        histogram.name = window.name;
+        histogram.count = (unsigned int)window.count;
+
+        copy(window.durations, window.durations + window.count, sorted);
+        sort(sorted, sorted + window.count);
+
+        for (size_t i = 0; i < window.count; ++i) {
+            uint64_t microseconds = sorted[i] / 1000;
+            int bucket = microseconds < 2 ? 0 : 63 - __builtin_clzll(microseconds);
+
+            ++histogram.buckets[min(bucket, KIK_CODE_TRACE_HISTOGRAM_BUCKETS - 1)];
+        }
+
+        histogram.p50 = sorted[window.count * 50 / 100] / 1e6;
+        histogram.p90 = sorted[window.count * 90 / 100] / 1e6;
+        histogram.p99 = sorted[window.count * 99 / 100] / 1e6;
+        histogram.max = sorted[window.count - 1] / 1e6;
+    }
+
+    return histogram_count;
+}
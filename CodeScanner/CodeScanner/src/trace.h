@@ -0,0 +1,139 @@
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "kikcode_scan.h"
+
+// events each thread holds until they're collected, after which the oldest are overwritten. A
+// power of two
+#define TRACE_BUFFER_EVENTS 4096
+
+// collected events kept for the next Chrome trace export, older ones are dropped
+#define TRACE_EXPORT_EVENTS 65536
+
+// the most recent durations of each span that its histogram is made from
+#define TRACE_HISTOGRAM_WINDOW 256
+
+// distinct spans one TraceTotals can add up
+#define TRACE_TOTALS_CAPACITY 64
+
+class TraceTotals;
+
+extern std::atomic<bool> trace_enabled;
+extern thread_local TraceTotals *trace_thread_totals;
+
+/**
+ * @returns Nanoseconds on a monotonic clock
+ */
+uint64_t kikCodeTraceNow();
+
+/**
+ * Records a span that took duration nanoseconds from start. name must outlive the tracer, it's
+ * meant to be a string literal.
+ */
+void kikCodeTraceRecordSpan(const char *name, uint64_t start, uint64_t duration);
+
+/**
+ * Records the value of a counter.
+ */
+void kikCodeTraceRecordCount(const char *name, double value);
+
+/**
+ * @returns True iff spans and counters ended on this thread go anywhere, so that they cost no more
+ * than this check otherwise
+ */
+static inline bool kikCodeTraceActive()
+{
+    return trace_enabled.load(std::memory_order_relaxed) || trace_thread_totals != nullptr;
+}
+
+static inline void kikCodeTraceCount(const char *name, double value)
+{
+    if (trace_enabled.load(std::memory_order_relaxed)) {
+        kikCodeTraceRecordCount(name, value);
+    }
+}
+
+/**
+ * Times the code from its construction until end() is called or it goes out of scope. Spans
+ * started while another is open on the same thread nest inside it.
+ *
+ * Each thread writes its spans to a ring buffer of its own without taking any lock, they're
+ * gathered from there when they're exported (see kikCodeTraceExportChrome).
+ */
+class TraceSpan {
+public:
+    explicit TraceSpan(const char *name)
+    : name_(name)
+    , active_(kikCodeTraceActive())
+    , start_(active_ ? kikCodeTraceNow() : 0)
+    {
+    }
+
+    ~TraceSpan()
+    {
+        end();
+    }
+
+    void end()
+    {
+        if (active_) {
+            active_ = false;
+            kikCodeTraceRecordSpan(name_, start_, kikCodeTraceNow() - start_);
+        }
+    }
+
+private:
+    const char *name_;
+    bool active_;
+    uint64_t start_;
+
+    TraceSpan(const TraceSpan &) = delete;
+    TraceSpan &operator=(const TraceSpan &) = delete;
+};
+
+/**
+ * Adds up the durations of the spans that end on the constructing thread for as long as it
+ * exists, by name, whether or not tracing is enabled. Used to report the stages of a single scan.
+ * Totals nest, only the innermost one sees a span.
+ */
+class TraceTotals {
+public:
+    TraceTotals();
+    ~TraceTotals();
+
+    void add(const char *name, uint64_t duration);
+
+    /**
+     * @returns The total time spent in spans named name, in milliseconds
+     */
+    double milliseconds(const char *name) const;
+
+    /**
+     * Fills in the stages of timing, quality_gate through candidates, from the spans each stage of
+     * a scan is made of. Leaves the rest of timing alone.
+     */
+    void fillTiming(KikCodeScanTiming *timing) const;
+
+private:
+    typedef struct {
+        const char *name;
+        uint64_t duration;
+    } Entry;
+
+    Entry entries_[TRACE_TOTALS_CAPACITY];
+    size_t entry_count_;
+    TraceTotals *previous_;
+
+    TraceTotals(const TraceTotals &) = delete;
+    TraceTotals &operator=(const TraceTotals &) = delete;
+};
+
+#define TRACE_SPAN(name) TraceSpan __trace_##name(#name)
+#define TRACE_SPAN_END(name) __trace_##name.end()
+#define TRACE_COUNT(name, value) kikCodeTraceCount(#name, (double)(value))
+
+#endif // __TRACE_H__
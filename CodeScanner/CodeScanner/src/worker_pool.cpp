@@ -0,0 +1,162 @@
+#include "worker_pool.h"
+
+using namespace std;
+
+WorkerPool::WorkerPool(size_t thread_count)
+: queues_(thread_count + 1)
+, task_(nullptr)
+, context_(nullptr)
+, generation_(0)
+, active_workers_(0)
+, stopping_(false)
+, remaining_(0)
+{
+    for (size_t i = 0; i < queues_.size(); ++i) {
+        queues_[i].head = 0;
+        queues_[i].tail = 0;
+    }
+
+    for (size_t i = 0; i < thread_count; ++i) {
+        threads_.push_back(thread(&WorkerPool::workerLoop, this, i + 1));
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        lock_guard<mutex> lock(mutex_);
+        stopping_ = true;
+    }
+
+    work_available_.notify_all();
+
+    for (size_t i = 0; i < threads_.size(); ++i) {
+        threads_[i].join();
+    }
+}
+
+size_t WorkerPool::workerCount() const
+{
+    return queues_.size();
+}
+
+void WorkerPool::run(size_t task_count, Task task, void *context)
+{
+    if (task_count == 0) {
+        return;
+    }
+
+    uint64_t generation;
+
+    {
+        lock_guard<mutex> lock(mutex_);
+
+        // a worker that woke late for the previous batch may still be draining, and can pop a task
+        // of this one as soon as it's dealt. The batch is set up first so that releasing a queue's
+        // lock publishes it along with the task
+        task_ = task;
+        context_ = context;
+        remaining_ = task_count;
+
+        // deal the tasks out round-robin, stealing evens out whatever imbalance is left
+        for (size_t i = 0; i < queues_.size(); ++i) {
+            lock_guard<mutex> queue_lock(queues_[i].mutex);
+
+            queues_[i].tasks.clear();
+            queues_[i].head = 0;
+
+            for (size_t t = i; t < task_count; t += queues_.size()) {
+                queues_[i].tasks.push_back(t);
+            }
+
+            queues_[i].tail = queues_[i].tasks.size();
+        }
+
+        generation = ++generation_;
+    }
+
+    work_available_.notify_all();
+
+    drain(0, generation);
+
+    // wait for the other workers to leave the batch as well, including any that joined it late, so
+    // that the task and context outlive every call made with them
+    unique_lock<mutex> lock(mutex_);
+    work_finished_.wait(lock, [this] { return remaining_ == 0 && active_workers_ == 0; });
+
+    task_ = nullptr;
+    context_ = nullptr;
+}
+
+void WorkerPool::workerLoop(size_t worker)
+{
+    uint64_t seen_generation = 0;
+
+    while (true) {
+        {
+            unique_lock<mutex> lock(mutex_);
+            work_available_.wait(lock, [&] { return stopping_ || generation_ != seen_generation; });
+
+            if (stopping_) {
+                return;
+            }
+
+            seen_generation = generation_;
+            ++active_workers_;
+        }
+
+        drain(worker, seen_generation);
+
+        {
+            lock_guard<mutex> lock(mutex_);
+            --active_workers_;
+        }
+
+        work_finished_.notify_all();
+    }
+}
+
+void WorkerPool::drain(size_t worker, uint64_t generation)
+{
+    size_t task = 0;
+
+    // a worker that joined its batch too late to find any of its tasks leaves the next one alone
+    while (generation_.load(memory_order_acquire) == generation && (popOwn(worker, &task) || steal(worker, &task))) {
+        task_(context_, task, worker);
+
+        if (--remaining_ == 0) {
+            lock_guard<mutex> lock(mutex_);
+            work_finished_.notify_all();
+        }
+    }
+}
+
+bool WorkerPool::popOwn(size_t worker, size_t *out_task)
+{
+    Queue &queue = queues_[worker];
+    lock_guard<mutex> lock(queue.mutex);
+
+    if (queue.head == queue.tail) {
+        return false;
+    }
+
+    *out_task = queue.tasks[queue.head++];
+
+    return true;
+}
+
+bool WorkerPool::steal(size_t thief, size_t *out_task)
+{
+    for (size_t i = 1; i < queues_.size(); ++i) {
+        Queue &queue = queues_[(thief + i) % queues_.size()];
+        lock_guard<mutex> lock(queue.mutex);
+
+        if (queue.head != queue.tail) {
+            *out_task = queue.tasks[--queue.tail];
+
+            return true;
+        }
+    }
+
+    return false;
+}
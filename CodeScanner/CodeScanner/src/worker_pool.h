@@ -0,0 +1,76 @@
+#ifndef __WORKER_POOL_H__
+#define __WORKER_POOL_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * A small work-stealing thread pool for running a batch of independent, indexed tasks.
+ *
+ * run() hands each worker its own queue of task indices. A worker drains its own queue from the
+ * front and, once it is empty, steals from the back of the other queues, so a few slow tasks don't
+ * leave the rest of the pool idle. The calling thread takes part as worker 0 and run() returns
+ * once every task in the batch has finished.
+ *
+ * A pool runs one batch at a time and is not meant to be shared between scanners.
+ */
+class WorkerPool {
+public:
+    typedef void (*Task)(void *context, size_t task, size_t worker);
+
+    /**
+     * Creates a pool with thread_count background threads, plus the calling thread.
+     */
+    explicit WorkerPool(size_t thread_count);
+
+    ~WorkerPool();
+
+    /**
+     * @returns The number of workers taking part in a batch, including the calling thread
+     */
+    size_t workerCount() const;
+
+    /**
+     * Runs task(context, i, worker) for every i in [0, task_count) and waits for all of them to
+     * finish. worker identifies the thread running the task and is in [0, workerCount()).
+     */
+    void run(size_t task_count, Task task, void *context);
+
+private:
+    typedef struct {
+        std::mutex mutex;
+        std::vector<size_t> tasks;
+        size_t head;
+        size_t tail;
+    } Queue;
+
+    std::vector<std::thread> threads_;
+    std::vector<Queue> queues_;
+
+    std::mutex mutex_;
+    std::condition_variable work_available_;
+    std::condition_variable work_finished_;
+
+    Task task_;
+    void *context_;
+    // only changed under mutex_, read without it by workers checking that they're still in their batch
+    std::atomic<uint64_t> generation_;
+
+    size_t active_workers_;
+    bool stopping_;
+
+    std::atomic<size_t> remaining_;
+
+    void workerLoop(size_t worker);
+
+    void drain(size_t worker, uint64_t generation);
+
+    bool popOwn(size_t worker, size_t *out_task);
+
+    bool steal(size_t thief, size_t *out_task);
+};
+
+#endif // __WORKER_POOL_H__
@@ -1,36 +0,0 @@
-#ifndef __ILLEGAL_ARGUMENT_EXCEPTION_H__
-#define __ILLEGAL_ARGUMENT_EXCEPTION_H__
-
-/*
- *  IllegalArgumentException.h
- *  zxing
- *
- *  Copyright 2010 ZXing authors All rights reserved.
- *
- * Licensed under the Apache License, Version 2.0 (the "License");
- * you may not use this file except in compliance with the License.
- * You may obtain a copy of the License at
- *
- *      http://www.apache.org/licenses/LICENSE-2.0
- *
- * Unless required by applicable law or agreed to in writing, software
- * distributed under the License is distributed on an "AS IS" BASIS,
- * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
- * See the License for the specific language governing permissions and
- * limitations under the License.
- */
-
-#include "Exception.h"
-
-namespace zxing {
-
-class IllegalArgumentException : public Exception {
-public:
-  IllegalArgumentException();
-  IllegalArgumentException(const char *msg);
-  ~IllegalArgumentException() throw();
-};
-
-}
-
-#endif // __ILLEGAL_ARGUMENT_EXCEPTION_H__
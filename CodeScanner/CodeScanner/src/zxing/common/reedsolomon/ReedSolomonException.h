@@ -1,33 +0,0 @@
-#ifndef __REED_SOLOMON_EXCEPTION_H__
-#define __REED_SOLOMON_EXCEPTION_H__
-
-/*
- *  ReedSolomonException.h
- *  zxing
- *
- *  Copyright 2010 ZXing authors All rights reserved.
- *
- * Licensed under the Apache License, Version 2.0 (the "License");
- * you may not use this file except in compliance with the License.
- * You may obtain a copy of the License at
- *
- *      http://www.apache.org/licenses/LICENSE-2.0
- *
- * Unless required by applicable law or agreed to in writing, software
- * distributed under the License is distributed on an "AS IS" BASIS,
- * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
- * See the License for the specific language governing permissions and
- * limitations under the License.
- */
-
-#include "Exception.h"
-
-namespace zxing {
-class ReedSolomonException : public Exception {
-public:
-  ReedSolomonException(const char *msg) throw();
-  ~ReedSolomonException() throw();
-};
-}
-
-#endif // __REED_SOLOMON_EXCEPTION_H__
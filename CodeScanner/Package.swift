@@ -26,20 +26,22 @@ let package = Package(
                 "src/kikcodes.cpp",
                 "src/kikcode_scan.cpp",
                 "src/kikcode_encoding.cpp",
-                "src/zxing/Exception.cpp",
-                "src/zxing/common/IllegalArgumentException.cpp",
-                "src/zxing/common/reedsolomon/GenericGF.cpp",
-                "src/zxing/common/reedsolomon/GenericGFPoly.cpp",
-                "src/zxing/common/reedsolomon/ReedSolomonDecoder.cpp",
-                "src/zxing/common/reedsolomon/ReedSolomonEncoder.cpp",
-                "src/zxing/common/reedsolomon/ReedSolomonException.cpp"
+                "src/kikcode_reed_solomon.cpp",
+                "src/kikcode_render.cpp",
+                "src/bitplane.cpp",
+                "src/async_scanner.cpp",
+                "src/blob_analyzer.cpp",
+                "src/frame_archive.cpp",
+                "src/frame_quality.cpp",
+                "src/frame_recorder.cpp",
+                "src/local_threshold.cpp",
+                "src/sharpen_threshold.cpp",
+                "src/trace.cpp",
+                "src/worker_pool.cpp"
             ],
             publicHeadersPath: "include",
             cxxSettings: [
                 .headerSearchPath("src"),
-                .headerSearchPath("src/zxing"),
-                .headerSearchPath("src/zxing/common"),
-                .headerSearchPath("src/zxing/common/reedsolomon"),
                 .unsafeFlags(["-w"])
             ],
             linkerSettings: [
@@ -0,0 +1,164 @@
+/**
+ * Round-trips byte masks through Bitplane at widths around its 64-bit words, and checks the
+ * combining and counting against the same operations done byte by byte.
+ */
+
+#include "bitplane.h"
+#include "check.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <vector>
+
+using namespace std;
+
+#define BITPLANE_TEST_HEIGHT 19
+
+// extra bytes at the end of each row of a mask, which pack() mustn't read as pixels
+#define BITPLANE_TEST_PADDING 13
+
+static vector<uint8_t> randomMask(int width, int height, size_t stride, int density)
+{
+    vector<uint8_t> mask(stride * height, 0xA5);
+
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            mask[y * stride + x] = rand() % 100 < density ? (uint8_t)(1 + rand() % 255) : 0;
+        }
+    }
+
+    return mask;
+}
+
+static void checkWidth(Bitplane &plane, Bitplane &other, int width)
+{
+    const int height = BITPLANE_TEST_HEIGHT;
+    const size_t stride = width + BITPLANE_TEST_PADDING;
+
+    vector<uint8_t> mask = randomMask(width, height, stride, 40);
+    vector<uint8_t> other_mask = randomMask(width, height, stride, 60);
+
+    plane.create(width, height);
+    plane.pack(mask.data(), stride);
+    other.create(width, height);
+    other.pack(other_mask.data(), stride);
+
+    CHECK(plane.width() == width && plane.height() == height);
+
+    size_t expected_count = 0;
+    int get_errors = 0;
+
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            bool set = mask[y * stride + x] != 0;
+
+            expected_count += set;
+            get_errors += plane.get(x, y) != set;
+        }
+    }
+
+    CHECK(get_errors == 0);
+    CHECK(plane.count() == expected_count);
+
+    // the bits past the end of each row stay 0, count() and the combining rely on it
+    int padding_errors = 0;
+
+    for (int y = 0; y < height; ++y) {
+        const uint64_t *row = plane.row(y);
+
+        if (width % 64 != 0 && (row[width / 64] >> (width % 64)) != 0) {
+            ++padding_errors;
+        }
+    }
+
+    CHECK(padding_errors == 0);
+
+    // a region off the top-left, unpacked through a stride of its own
+    int x0 = width / 3;
+    int y0 = 2;
+    int region_width = width - x0;
+    int region_height = height - y0 - 1;
+    size_t region_stride = region_width + 5;
+
+    vector<uint8_t> unpacked(region_stride * region_height, 7);
+    plane.unpack(x0, y0, region_width, region_height, unpacked.data(), region_stride);
+
+    vector<uint8_t> masked(other_mask.begin(), other_mask.end());
+    plane.unpackMasked(x0, y0, region_width, region_height, &other_mask[y0 * stride + x0], stride, &masked[y0 * stride + x0], stride);
+
+    int unpack_errors = 0;
+    int masked_errors = 0;
+
+    for (int y = 0; y < region_height; ++y) {
+        for (int x = 0; x < region_width; ++x) {
+            bool set = mask[(y0 + y) * stride + x0 + x] != 0;
+            bool other_set = other_mask[(y0 + y) * stride + x0 + x] != 0;
+
+            unpack_errors += unpacked[y * region_stride + x] != (set ? 255 : 0);
+            masked_errors += masked[(y0 + y) * stride + x0 + x] != (set && other_set ? other_mask[(y0 + y) * stride + x0 + x] : 0);
+        }
+
+        for (size_t x = region_width; x < region_stride; ++x) {
+            unpack_errors += unpacked[y * region_stride + x] != 7;
+        }
+    }
+
+    CHECK(unpack_errors == 0);
+    CHECK(masked_errors == 0);
+
+    // and, or and count against the bytes
+    Bitplane combined;
+    combined.create(width, height);
+    combined.pack(mask.data(), stride);
+    combined.andWith(other);
+
+    Bitplane either;
+    either.create(width, height);
+    either.pack(mask.data(), stride);
+    either.orWith(other);
+
+    size_t and_count = 0;
+    size_t or_count = 0;
+    int combine_errors = 0;
+
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            bool a = mask[y * stride + x] != 0;
+            bool b = other_mask[y * stride + x] != 0;
+
+            and_count += a && b;
+            or_count += a || b;
+            combine_errors += combined.get(x, y) != (a && b);
+            combine_errors += either.get(x, y) != (a || b);
+        }
+    }
+
+    CHECK(combine_errors == 0);
+    CHECK(combined.count() == and_count);
+    CHECK(either.count() == or_count);
+
+    plane.clear();
+    CHECK(plane.count() == 0);
+}
+
+int main()
+{
+    const int widths[] = { 1, 7, 63, 64, 65, 127, 130, 255, 256, 257, 403 };
+
+    srand(13);
+
+    // the planes are reused from width to width, as the scanner reuses them from frame to frame,
+    // and shrinking one mustn't leave bits of the larger size behind
+    Bitplane plane;
+    Bitplane other;
+
+    for (int width : widths) {
+        checkWidth(plane, other, width);
+    }
+
+    for (int i = (int)(sizeof(widths) / sizeof(widths[0])) - 1; i >= 0; --i) {
+        checkWidth(plane, other, widths[i]);
+    }
+
+    return checkResult();
+}
@@ -0,0 +1,315 @@
+/**
+ * Checks BlobAnalyzer against components found by flood fill, with set pixels 8-connected and unset
+ * ones 4-connected, on random planes as well as on nested rings whose hierarchy is known.
+ */
+
+#include "bitplane.h"
+#include "blob_analyzer.h"
+#include "check.h"
+
+#include <algorithm>
+#include <stdint.h>
+#include <stdlib.h>
+#include <vector>
+
+using namespace std;
+
+typedef struct {
+    bool light;
+    bool touches_border;
+    int parent;
+    int left;
+    int top;
+    int right;
+    int bottom;
+    int64_t area;
+    int64_t perimeter;
+    int64_t filled_area;
+    int64_t sum_x;
+    int64_t sum_y;
+    int64_t sum_xx;
+    int64_t sum_xy;
+    int64_t sum_yy;
+} ExpectedBlob;
+
+static const int offsets[8][2] = { { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 }, { 1, 1 }, { 1, -1 }, { -1, 1 }, { -1, -1 } };
+
+/**
+ * Labels the pixels of (value != 0) in raster order of their first pixel, the order BlobAnalyzer
+ * reports blobs in.
+ */
+static vector<int> labelComponents(const vector<uint8_t> &pixels, int width, int height, int *out_count)
+{
+    vector<int> labels(pixels.size(), -1);
+    vector<int> stack;
+    int count = 0;
+
+    for (int start = 0; start < width * height; ++start) {
+        if (labels[start] >= 0) {
+            continue;
+        }
+
+        bool light = pixels[start] != 0;
+        int neighbours = light ? 8 : 4;
+
+        labels[start] = count;
+        stack.push_back(start);
+
+        while (!stack.empty()) {
+            int i = stack.back();
+            stack.pop_back();
+
+            for (int n = 0; n < neighbours; ++n) {
+                int x = i % width + offsets[n][0];
+                int y = i / width + offsets[n][1];
+                int j = y * width + x;
+
+                if (x >= 0 && x < width && y >= 0 && y < height && labels[j] < 0 && (pixels[j] != 0) == light) {
+                    labels[j] = count;
+                    stack.push_back(j);
+                }
+            }
+        }
+
+        ++count;
+    }
+
+    *out_count = count;
+
+    return labels;
+}
+
+/**
+ * @returns For each pixel, whether it's inside the outer boundary of blob: not reachable from
+ * outside the frame without crossing the blob, with the connectivity of the other polarity
+ */
+static vector<bool> fillBlob(const vector<int> &labels, int width, int height, int blob, bool light)
+{
+    // a frame of one pixel all round, which is outside everything
+    int padded_width = width + 2;
+    int padded_height = height + 2;
+    int neighbours = light ? 4 : 8;
+
+    vector<bool> outside(padded_width * padded_height, false);
+    vector<int> stack;
+
+    outside[0] = true;
+    stack.push_back(0);
+
+    while (!stack.empty()) {
+        int i = stack.back();
+        stack.pop_back();
+
+        for (int n = 0; n < neighbours; ++n) {
+            int x = i % padded_width + offsets[n][0];
+            int y = i / padded_width + offsets[n][1];
+
+            if (x < 0 || x >= padded_width || y < 0 || y >= padded_height) {
+                continue;
+            }
+
+            int j = y * padded_width + x;
+            bool in_frame = x >= 1 && x <= width && y >= 1 && y <= height;
+
+            if (!outside[j] && (!in_frame || labels[(y - 1) * width + x - 1] != blob)) {
+                outside[j] = true;
+                stack.push_back(j);
+            }
+        }
+    }
+
+    vector<bool> filled(width * height);
+
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            filled[y * width + x] = !outside[(y + 1) * padded_width + x + 1];
+        }
+    }
+
+    return filled;
+}
+
+static vector<ExpectedBlob> expectedBlobs(const vector<uint8_t> &pixels, int width, int height)
+{
+    int count;
+    vector<int> labels = labelComponents(pixels, width, height, &count);
+    vector<ExpectedBlob> blobs(count);
+
+    for (int b = 0; b < count; ++b) {
+        ExpectedBlob &blob = blobs[b];
+        blob = {};
+        blob.parent = -1;
+        blob.left = width;
+        blob.top = height;
+        blob.right = -1;
+        blob.bottom = -1;
+    }
+
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            int label = labels[y * width + x];
+            ExpectedBlob &blob = blobs[label];
+
+            if (blob.area == 0) {
+                blob.light = pixels[y * width + x] != 0;
+
+                // whatever is directly above a blob's first pixel is of the other polarity and
+                // surrounds it
+                blob.parent = y > 0 ? labels[(y - 1) * width + x] : -1;
+            }
+
+            blob.area += 1;
+            blob.left = min(blob.left, x);
+            blob.top = min(blob.top, y);
+            blob.right = max(blob.right, x);
+            blob.bottom = max(blob.bottom, y);
+            blob.touches_border = blob.touches_border || x == 0 || y == 0 || x == width - 1 || y == height - 1;
+
+            // edges to a 4-neighbour of another blob or to the outside of the frame
+            for (int n = 0; n < 4; ++n) {
+                int u = x + offsets[n][0];
+                int v = y + offsets[n][1];
+
+                if (u < 0 || u >= width || v < 0 || v >= height || labels[v * width + u] != label) {
+                    blob.perimeter += 1;
+                }
+            }
+        }
+    }
+
+    for (int b = 0; b < count; ++b) {
+        ExpectedBlob &blob = blobs[b];
+
+        // the filled moments only mean something for blobs within the frame
+        if (!blob.light || blob.touches_border) {
+            continue;
+        }
+
+        vector<bool> filled = fillBlob(labels, width, height, b, blob.light);
+
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                if (filled[y * width + x]) {
+                    blob.filled_area += 1;
+                    blob.sum_x += x;
+                    blob.sum_y += y;
+                    blob.sum_xx += (int64_t)x * x;
+                    blob.sum_xy += (int64_t)x * y;
+                    blob.sum_yy += (int64_t)y * y;
+                }
+            }
+        }
+    }
+
+    return blobs;
+}
+
+static const vector<BlobAnalyzer::Blob> &analyze(BlobAnalyzer &analyzer, const vector<uint8_t> &pixels, int width, int height)
+{
+    Bitplane plane;
+    plane.create(width, height);
+    plane.pack(pixels.data(), width);
+
+    analyzer.analyze(plane);
+
+    return analyzer.blobs();
+}
+
+static void checkAgainstFloodFill(BlobAnalyzer &analyzer, const vector<uint8_t> &pixels, int width, int height)
+{
+    const vector<BlobAnalyzer::Blob> &blobs = analyze(analyzer, pixels, width, height);
+    vector<ExpectedBlob> expected = expectedBlobs(pixels, width, height);
+
+    CHECK(blobs.size() == expected.size());
+
+    if (blobs.size() != expected.size()) {
+        return;
+    }
+
+    int shape_errors = 0;
+    int hierarchy_errors = 0;
+    int moment_errors = 0;
+
+    for (size_t i = 0; i < blobs.size(); ++i) {
+        const BlobAnalyzer::Blob &blob = blobs[i];
+        const ExpectedBlob &want = expected[i];
+
+        shape_errors += blob.light != want.light || blob.area != want.area || blob.perimeter != want.perimeter ||
+                        blob.left != want.left || blob.top != want.top || blob.right != want.right || blob.bottom != want.bottom;
+        hierarchy_errors += blob.touches_border != want.touches_border || blob.parent != want.parent;
+
+        if (want.light && !want.touches_border) {
+            moment_errors += blob.filled_area != want.filled_area || blob.sum_x != want.sum_x || blob.sum_y != want.sum_y ||
+                             blob.sum_xx != want.sum_xx || blob.sum_xy != want.sum_xy || blob.sum_yy != want.sum_yy;
+        }
+    }
+
+    CHECK(shape_errors == 0);
+    CHECK(hierarchy_errors == 0);
+    CHECK(moment_errors == 0);
+}
+
+/**
+ * A square ring with a dot in its hole, on an unset background: background, ring, hole, dot.
+ */
+static void checkNestedRings(BlobAnalyzer &analyzer)
+{
+    const int width = 70;
+    const int height = 20;
+    vector<uint8_t> pixels(width * height, 0);
+
+    for (int y = 3; y <= 15; ++y) {
+        for (int x = 60; x <= 66; ++x) {
+            bool ring = y == 3 || y == 15 || x == 60 || x == 66;
+            bool dot = y == 9 && x == 63;
+
+            pixels[y * width + x] = ring || dot ? 255 : 0;
+        }
+    }
+
+    const vector<BlobAnalyzer::Blob> &blobs = analyze(analyzer, pixels, width, height);
+
+    CHECK(blobs.size() == 4);
+
+    if (blobs.size() != 4) {
+        return;
+    }
+
+    CHECK(!blobs[0].light && blobs[0].touches_border && blobs[0].parent == -1);
+    CHECK(blobs[1].light && !blobs[1].touches_border && blobs[1].parent == 0);
+    CHECK(!blobs[2].light && blobs[2].parent == 1 && blobs[2].area == 5 * 11 - 1);
+    CHECK(blobs[3].light && blobs[3].parent == 2 && blobs[3].area == 1);
+
+    // the ring filled in is the whole square, dot and all
+    CHECK(blobs[1].area == 2 * 7 + 2 * 11);
+    CHECK(blobs[1].filled_area == 7 * 13);
+    CHECK(blobs[1].left == 60 && blobs[1].top == 3 && blobs[1].right == 66 && blobs[1].bottom == 15);
+}
+
+int main()
+{
+    BlobAnalyzer analyzer;
+
+    checkNestedRings(analyzer);
+
+    // random planes at several densities and widths around the bitplane's words, with the analyzer
+    // reused between them
+    const int sizes[][2] = { { 1, 1 }, { 5, 3 }, { 63, 17 }, { 64, 9 }, { 65, 21 }, { 130, 40 } };
+    const int densities[] = { 20, 45, 55, 80 };
+
+    srand(14);
+
+    for (const int *size : sizes) {
+        for (int density : densities) {
+            vector<uint8_t> pixels(size[0] * size[1]);
+
+            for (size_t i = 0; i < pixels.size(); ++i) {
+                pixels[i] = rand() % 100 < density ? 255 : 0;
+            }
+
+            checkAgainstFloodFill(analyzer, pixels, size[0], size[1]);
+        }
+    }
+
+    return checkResult();
+}
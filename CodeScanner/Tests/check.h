@@ -0,0 +1,31 @@
+#ifndef __CHECK_H__
+#define __CHECK_H__
+
+#include <stdio.h>
+
+// checks that failed so far, main returns checkResult() so that ctest sees any of them
+static int check_failures = 0;
+
+/**
+ * Reports condition on stderr if it doesn't hold, and carries on so that one run shows every
+ * failure.
+ */
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            ++check_failures; \
+        } \
+    } while (0)
+
+static inline int checkResult()
+{
+    if (check_failures > 0) {
+        fprintf(stderr, "%d checks failed\n", check_failures);
+        return 1;
+    }
+
+    return 0;
+}
+
+#endif // __CHECK_H__
@@ -0,0 +1,192 @@
+/**
+ * Writes a frame archive, maps it back and checks every frame and plane, then cuts the file short
+ * at every length within its last frame and checks that only complete frames are read.
+ */
+
+#include "check.h"
+#include "frame_archive.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+typedef struct {
+    unsigned int width;
+    unsigned int height;
+    unsigned int row_stride;
+    unsigned int device_quality;
+    uint64_t timestamp;
+    bool payload;
+} TestFrame;
+
+static const TestFrame test_frames[] = {
+    { 30, 37, 100, 8, 1000, false },
+    { 100, 37, 100, 3, 2000, true },
+    { 17, 5, 20, 0, 3500, false },
+    { 1, 1, 1, 10, 4000, true },
+    { 64, 3, 64, 3, 5000, false }
+};
+
+#define FRAME_ARCHIVE_TEST_FRAMES (sizeof(test_frames) / sizeof(test_frames[0]))
+
+static uint8_t pixelAt(size_t frame, unsigned int x, unsigned int y)
+{
+    return (uint8_t)(frame * 31 + x * 7 + y * 13);
+}
+
+int main()
+{
+    char path[] = "/tmp/frame_archive_testXXXXXX";
+    int fd = mkstemp(path);
+
+    CHECK(fd >= 0);
+
+    if (fd < 0) {
+        return checkResult();
+    }
+
+    close(fd);
+
+    FrameArchiveWriter *writer = frameArchiveCreate(path);
+    CHECK(writer != nullptr);
+
+    if (!writer) {
+        return checkResult();
+    }
+
+    unsigned char payload[KIK_CODE_TOTAL_BYTE_COUNT];
+    unsigned char late_payload[KIK_CODE_TOTAL_BYTE_COUNT];
+
+    for (int i = 0; i < KIK_CODE_TOTAL_BYTE_COUNT; ++i) {
+        payload[i] = (unsigned char)(i + 1);
+        late_payload[i] = (unsigned char)(200 - i);
+    }
+
+    uint64_t offsets[FRAME_ARCHIVE_TEST_FRAMES];
+
+    for (size_t f = 0; f < FRAME_ARCHIVE_TEST_FRAMES; ++f) {
+        const TestFrame &frame = test_frames[f];
+
+        // only the last row's width is passed in, as with a camera plane that isn't padded after
+        // its last row
+        vector<uint8_t> plane((size_t)(frame.height - 1) * frame.row_stride + frame.width);
+
+        for (unsigned int y = 0; y < frame.height; ++y) {
+            for (unsigned int x = 0; x < frame.width; ++x) {
+                plane[(size_t)y * frame.row_stride + x] = pixelAt(f, x, y);
+            }
+        }
+
+        int status = frameArchiveAppend(writer, plane.data(), frame.width, frame.height, frame.row_stride, frame.device_quality,
+                                        frame.timestamp, frame.payload ? payload : nullptr, &offsets[f]);
+
+        CHECK(status == FRAME_ARCHIVE_RESULT_SUCCESS);
+    }
+
+    // a payload found after the frame was written, as the recorder adds them
+    CHECK(frameArchiveSetPayload(writer, offsets[2], late_payload) == FRAME_ARCHIVE_RESULT_SUCCESS);
+
+    // a stride narrower than the frame is refused
+    CHECK(frameArchiveAppend(writer, payload, 10, 2, 9, 0, 0, nullptr, nullptr) == FRAME_ARCHIVE_RESULT_ERROR);
+
+    frameArchiveClose(writer);
+
+    FrameArchive *archive = frameArchiveMap(path);
+    CHECK(archive != nullptr);
+
+    if (!archive) {
+        unlink(path);
+        return checkResult();
+    }
+
+    CHECK(frameArchiveFrameCount(archive) == FRAME_ARCHIVE_TEST_FRAMES);
+    CHECK(frameArchiveFrameAt(archive, FRAME_ARCHIVE_TEST_FRAMES) == nullptr);
+
+    int pixel_errors = 0;
+
+    for (size_t f = 0; f < FRAME_ARCHIVE_TEST_FRAMES && f < frameArchiveFrameCount(archive); ++f) {
+        const TestFrame &expected = test_frames[f];
+        const FrameArchiveFrame *frame = frameArchiveFrameAt(archive, f);
+        const unsigned char *plane = frameArchivePlane(frame);
+
+        CHECK(frame->width == expected.width);
+        CHECK(frame->height == expected.height);
+        CHECK(frame->row_stride == expected.row_stride);
+        CHECK(frame->device_quality == expected.device_quality);
+        CHECK(frame->timestamp == expected.timestamp);
+
+        // planes are read in place, so they have to be as aligned as the scanner's own buffers
+        CHECK((uintptr_t)plane % FRAME_ARCHIVE_ALIGNMENT == 0);
+
+        if (f == 2) {
+            CHECK(frame->flags == FRAME_ARCHIVE_FLAG_PAYLOAD);
+            CHECK(memcmp(frame->payload, late_payload, sizeof(late_payload)) == 0);
+        }
+        else if (expected.payload) {
+            CHECK(frame->flags == FRAME_ARCHIVE_FLAG_PAYLOAD);
+            CHECK(memcmp(frame->payload, payload, sizeof(payload)) == 0);
+        }
+        else {
+            CHECK(frame->flags == 0);
+        }
+
+        for (unsigned int y = 0; y < frame->height; ++y) {
+            for (unsigned int x = 0; x < frame->width; ++x) {
+                pixel_errors += plane[(size_t)y * frame->row_stride + x] != pixelAt(f, x, y);
+            }
+        }
+    }
+
+    CHECK(pixel_errors == 0);
+
+    // where the last frame starts and ends
+    const FrameArchiveFrame *last = frameArchiveFrameAt(archive, FRAME_ARCHIVE_TEST_FRAMES - 1);
+    uint64_t last_start = offsets[FRAME_ARCHIVE_TEST_FRAMES - 1];
+    uint64_t complete_size = last_start + sizeof(FrameArchiveFrame) + last->plane_size;
+
+    frameArchiveUnmap(archive);
+
+    // a writer killed partway through its last frame leaves it incomplete, which is ignored
+    int truncation_errors = 0;
+
+    for (uint64_t size = complete_size; size >= last_start; --size) {
+        CHECK(truncate(path, (off_t)size) == 0);
+
+        archive = frameArchiveMap(path);
+
+        if (!archive) {
+            ++truncation_errors;
+            continue;
+        }
+
+        size_t expected_count = size == complete_size ? FRAME_ARCHIVE_TEST_FRAMES : FRAME_ARCHIVE_TEST_FRAMES - 1;
+        truncation_errors += frameArchiveFrameCount(archive) != expected_count;
+
+        frameArchiveUnmap(archive);
+    }
+
+    CHECK(truncation_errors == 0);
+
+    // anything shorter than the header, or with another magic, isn't an archive
+    CHECK(truncate(path, sizeof(FrameArchiveHeader) - 1) == 0);
+    CHECK(frameArchiveMap(path) == nullptr);
+
+    FILE *file = fopen(path, "wb");
+
+    if (file) {
+        vector<uint8_t> junk(4096, 'K');
+        fwrite(junk.data(), 1, junk.size(), file);
+        fclose(file);
+    }
+
+    CHECK(frameArchiveMap(path) == nullptr);
+
+    unlink(path);
+
+    return checkResult();
+}
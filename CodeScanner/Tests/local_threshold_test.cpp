@@ -0,0 +1,138 @@
+/**
+ * Checks LocalThreshold's summed-area lookups against means worked out pixel by pixel, including
+ * windows clipped by the border and a source with padded rows.
+ */
+
+#include "check.h"
+#include "local_threshold.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <vector>
+
+using namespace std;
+
+#define LOCAL_THRESHOLD_TEST_WIDTH  97
+#define LOCAL_THRESHOLD_TEST_HEIGHT 53
+#define LOCAL_THRESHOLD_TEST_STRIDE 112
+
+typedef struct {
+    int64_t sum;
+    int64_t area;
+} Window;
+
+static Window bruteWindow(const uint8_t *src, size_t stride, int width, int height, int x, int y, int radius)
+{
+    Window window = { 0, 0 };
+
+    for (int v = y - radius; v <= y + radius; ++v) {
+        for (int u = x - radius; u <= x + radius; ++u) {
+            if (u >= 0 && u < width && v >= 0 && v < height) {
+                window.sum += src[v * stride + u];
+                ++window.area;
+            }
+        }
+    }
+
+    return window;
+}
+
+int main()
+{
+    const int width = LOCAL_THRESHOLD_TEST_WIDTH;
+    const int height = LOCAL_THRESHOLD_TEST_HEIGHT;
+    const size_t stride = LOCAL_THRESHOLD_TEST_STRIDE;
+
+    // noise over a gradient, with the row padding set to values that would show up in any mean
+    // that read it
+    vector<uint8_t> frame(stride * height, 255);
+    srand(12);
+
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            frame[y * stride + x] = (uint8_t)((x * 2 + y + rand() % 64) & 0xFF);
+        }
+    }
+
+    LocalThreshold threshold;
+    threshold.build(frame.data(), stride, width, height);
+
+    const int radii[] = { 0, 1, 3, 8, 60 };
+    const int delta = 10;
+    const int percent = 15;
+    const int floor = 40;
+
+    for (int radius : radii) {
+        vector<uint8_t> dark(width * height, 7);
+        vector<uint8_t> light(width * height, 7);
+
+        threshold.dark(0, 0, width, height, radius, delta, dark.data(), width);
+        threshold.light(0, 0, width, height, radius, percent, floor, light.data(), width);
+
+        int mean_errors = 0;
+        int dark_errors = 0;
+        int light_errors = 0;
+
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                Window window = bruteWindow(frame.data(), stride, width, height, x, y, radius);
+                int value = frame[y * stride + x];
+
+                if (threshold.mean(x, y, radius) != (int)((window.sum + window.area / 2) / window.area)) {
+                    ++mean_errors;
+                }
+
+                bool is_dark = (value + delta) * window.area <= window.sum;
+
+                if (dark[y * width + x] != (is_dark ? 255 : 0) || threshold.isDark(x, y, radius, delta) != is_dark) {
+                    ++dark_errors;
+                }
+
+                // light() only ever sets pixels, the others keep what was there
+                bool is_light = value > floor && value * window.area * 100 > window.sum * (100 - percent);
+
+                if (light[y * width + x] != (is_light ? 255 : 7) || (threshold.lightMargin(x, y, radius, percent, floor) >= 0) != is_light) {
+                    ++light_errors;
+                }
+            }
+        }
+
+        CHECK(mean_errors == 0);
+        CHECK(dark_errors == 0);
+        CHECK(light_errors == 0);
+    }
+
+    // a region written through its own stride matches the same pixels of the whole frame
+    const int x0 = 30;
+    const int y0 = 11;
+    const int region_width = 41;
+    const int region_height = 23;
+    const size_t region_stride = 50;
+
+    vector<uint8_t> whole(width * height);
+    vector<uint8_t> region(region_stride * region_height, 7);
+
+    threshold.dark(0, 0, width, height, 5, delta, whole.data(), width);
+    threshold.dark(x0, y0, region_width, region_height, 5, delta, region.data(), region_stride);
+
+    int region_errors = 0;
+
+    for (int y = 0; y < region_height; ++y) {
+        for (int x = 0; x < region_width; ++x) {
+            if (region[y * region_stride + x] != whole[(y0 + y) * width + x0 + x]) {
+                ++region_errors;
+            }
+        }
+
+        // nor is anything past the region's width touched
+        for (size_t x = region_width; x < region_stride; ++x) {
+            if (region[y * region_stride + x] != 7) {
+                ++region_errors;
+            }
+        }
+    }
+
+    CHECK(region_errors == 0);
+
+    return checkResult();
+}
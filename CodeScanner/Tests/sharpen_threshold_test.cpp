@@ -0,0 +1,235 @@
+/**
+ * Checks SharpenThreshold's fused kernel against the sharpened response worked out pixel by pixel
+ * in the same fixed point, and against the two unsharp mask passes it replaced, worked out in
+ * floating point. Widths straddle the vector widths and the tile width, heights go down to the
+ * smallest frame the kernel takes, and rows are padded.
+ */
+
+#include "check.h"
+#include "sharpen_threshold.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <vector>
+
+using namespace std;
+
+#define SHARPEN_TEST_THRESHOLD 170
+#define SHARPEN_TEST_PADDING   13
+
+// the two passes round each blur differently from the kernel's Q8 weights, so pixels this close to
+// the threshold in floating point can go either way
+#define SHARPEN_TEST_TOLERANCE 1.5
+
+static int reflect(int i, int n)
+{
+    return i < 0 ? -i : i >= n ? 2 * n - 2 - i : i;
+}
+
+/**
+ * The weights the kernel documents: a Gaussian of sigma in Q8, summing to exactly 256.
+ */
+static vector<int> fixedKernel(double sigma, int radius)
+{
+    vector<int> weights(2 * radius + 1);
+    double sum = 0.0;
+    int total = 0;
+
+    for (int k = -radius; k <= radius; ++k) {
+        sum += exp(-k * k / (2.0 * sigma * sigma));
+    }
+
+    for (int k = -radius; k <= radius; ++k) {
+        weights[k + radius] = (int)lround(256.0 * exp(-k * k / (2.0 * sigma * sigma)) / sum);
+        total += weights[k + radius];
+    }
+
+    weights[radius] += 256 - total;
+
+    return weights;
+}
+
+static vector<double> floatKernel(double sigma, int radius)
+{
+    vector<double> weights(2 * radius + 1);
+    double sum = 0.0;
+
+    for (int k = -radius; k <= radius; ++k) {
+        weights[k + radius] = exp(-k * k / (2.0 * sigma * sigma));
+        sum += weights[k + radius];
+    }
+
+    for (size_t k = 0; k < weights.size(); ++k) {
+        weights[k] /= sum;
+    }
+
+    return weights;
+}
+
+/**
+ * @returns The blur of src at (x, y) in Q15 of the Q8 weights, each horizontal blur halved
+ */
+static int64_t fixedBlur(const uint8_t *src, size_t stride, int width, int height, int x, int y, const vector<int> &weights)
+{
+    int radius = (int)weights.size() / 2;
+    int64_t blurred = 0;
+
+    for (int v = -radius; v <= radius; ++v) {
+        const uint8_t *row = src + reflect(y + v, height) * stride;
+        int sum = 0;
+
+        for (int u = -radius; u <= radius; ++u) {
+            sum += row[reflect(x + u, width)] * weights[u + radius];
+        }
+
+        blurred += (int64_t)(sum >> 1) * weights[v + radius];
+    }
+
+    return blurred;
+}
+
+/**
+ * One unsharp mask pass with sigma 2 and amount 0.5, without clipping its output.
+ */
+static vector<double> unsharpPass(const vector<double> &image, int width, int height, const vector<double> &weights)
+{
+    int radius = (int)weights.size() / 2;
+    vector<double> rows(image.size());
+    vector<double> out(image.size());
+
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            double sum = 0.0;
+
+            for (int u = -radius; u <= radius; ++u) {
+                sum += image[y * width + reflect(x + u, width)] * weights[u + radius];
+            }
+
+            rows[y * width + x] = sum;
+        }
+    }
+
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            double sum = 0.0;
+
+            for (int v = -radius; v <= radius; ++v) {
+                sum += rows[reflect(y + v, height) * width + x] * weights[v + radius];
+            }
+
+            out[y * width + x] = 1.5 * image[y * width + x] - 0.5 * sum;
+        }
+    }
+
+    return out;
+}
+
+static void checkFrame(SharpenThreshold &sharpen, int width, int height, unsigned int seed)
+{
+    const size_t stride = width + SHARPEN_TEST_PADDING;
+    const int threshold = SHARPEN_TEST_THRESHOLD;
+
+    // noisy stripes that cross the threshold often, with padding that would show up in any blur
+    // that read it
+    vector<uint8_t> frame(stride * height, 255);
+    srand(seed);
+
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            int value = ((x / 5 + y / 3) % 2 ? 210 : 90) + rand() % 81 - 40;
+            frame[y * stride + x] = (uint8_t)max(0, min(255, value));
+        }
+    }
+
+    // the output keeps its padding, the kernel mustn't write past width
+    vector<uint8_t> out(stride * height, 7);
+
+    CHECK(sharpen.apply(frame.data(), stride, out.data(), stride, width, height, threshold));
+
+    vector<int> narrow = fixedKernel(2.0, SHARPEN_RADIUS);
+    vector<int> wide = fixedKernel(2.0 * sqrt(2.0), SHARPEN_WIDE_RADIUS);
+
+    vector<double> image(width * height);
+
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            image[y * width + x] = frame[y * stride + x];
+        }
+    }
+
+    vector<double> weights = floatKernel(2.0, SHARPEN_RADIUS);
+    vector<double> sharpened = unsharpPass(unsharpPass(image, width, height, weights), width, height, weights);
+
+    int fixed_mismatches = 0;
+    int margin_mismatches = 0;
+    int pass_mismatches = 0;
+    int padding_writes = 0;
+
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            int source = frame[y * stride + x];
+            int64_t response = ((int64_t)source << 18) + ((int64_t)source << 15)
+                             - 6 * fixedBlur(frame.data(), stride, width, height, x, y, narrow)
+                             + fixedBlur(frame.data(), stride, width, height, x, y, wide);
+            bool light = response >= (int64_t)(4 * threshold + 2) << 15;
+            uint8_t pixel = out[y * stride + x];
+
+            if (pixel != (light ? 255 : 0)) {
+                ++fixed_mismatches;
+            }
+
+            if ((sharpen.margin(frame.data(), stride, width, height, x, y, threshold) >= 0) != light) {
+                ++margin_mismatches;
+            }
+
+            double level = sharpened[y * width + x] - (threshold + 0.5);
+
+            if (fabs(level) > SHARPEN_TEST_TOLERANCE && (level > 0) != light) {
+                ++pass_mismatches;
+            }
+        }
+
+        for (size_t x = width; x < stride; ++x) {
+            if (out[y * stride + x] != 7) {
+                ++padding_writes;
+            }
+        }
+    }
+
+    if (fixed_mismatches + margin_mismatches + pass_mismatches + padding_writes > 0) {
+        fprintf(stderr, "%dx%d: %d fixed point, %d margin, %d two pass mismatches, %d padding writes\n",
+                width, height, fixed_mismatches, margin_mismatches, pass_mismatches, padding_writes);
+    }
+
+    CHECK(fixed_mismatches == 0);
+    CHECK(margin_mismatches == 0);
+    CHECK(pass_mismatches == 0);
+    CHECK(padding_writes == 0);
+}
+
+int main()
+{
+    SharpenThreshold sharpen;
+
+    // around 8 and 16 pixel vectors, and the 256 pixel tiles
+    const int widths[] = { 19, 20, 23, 24, 25, 31, 32, 33, 47, 255, 256, 257, 271, 403, 513 };
+    const int heights[] = { 19, 20, 21, 38, 57 };
+
+    unsigned int seed = 1;
+
+    for (size_t i = 0; i < sizeof(widths) / sizeof(widths[0]); ++i) {
+        for (size_t j = 0; j < sizeof(heights) / sizeof(heights[0]); ++j) {
+            checkFrame(sharpen, widths[i], heights[j], seed++);
+        }
+    }
+
+    // frames the kernel can't reflect a whole window into are left to the caller
+    vector<uint8_t> small(32 * 32, 128);
+    vector<uint8_t> small_out(32 * 32);
+
+    CHECK(!sharpen.apply(small.data(), 32, small_out.data(), 32, SHARPEN_WIDE_TAP_COUNT - 1, 32, SHARPEN_TEST_THRESHOLD));
+    CHECK(!sharpen.apply(small.data(), 32, small_out.data(), 32, 32, SHARPEN_WIDE_TAP_COUNT - 1, SHARPEN_TEST_THRESHOLD));
+
+    return checkResult();
+}
@@ -0,0 +1,252 @@
+/**
+ * Checks the tracer's per-thread rings: nothing is recorded while it's disabled, events that
+ * overflow a ring are counted as dropped, every event written from several threads at once is either
+ * exported or counted as dropped, and per-scan totals and histograms add up.
+ */
+
+#include "check.h"
+#include "trace.h"
+
+#include <atomic>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+#define TRACE_TEST_THREADS           4
+#define TRACE_TEST_EVENTS_PER_THREAD 20000
+
+static size_t countOccurrences(const string &text, const char *needle)
+{
+    size_t count = 0;
+
+    for (size_t at = text.find(needle); at != string::npos; at = text.find(needle, at + 1)) {
+        ++count;
+    }
+
+    return count;
+}
+
+/**
+ * @returns The value of the dropped_events counter in trace, 0 if there is none
+ */
+static uint64_t droppedEvents(const string &trace)
+{
+    size_t at = trace.find("\"name\":\"dropped_events\"");
+
+    if (at == string::npos) {
+        return 0;
+    }
+
+    at = trace.find("\"value\":", at);
+
+    return strtoull(trace.c_str() + at + strlen("\"value\":"), nullptr, 10);
+}
+
+static string exportTrace()
+{
+    char *trace = kikCodeTraceExportChrome();
+    string copy(trace ? trace : "");
+    kikCodeTraceFree(trace);
+
+    return copy;
+}
+
+static void checkDisabled()
+{
+    kikCodeTraceSetEnabled(0);
+    exportTrace();
+
+    {
+        TRACE_SPAN(disabled_span);
+        TRACE_COUNT(disabled_count, 1);
+    }
+
+    string trace = exportTrace();
+
+    CHECK(countOccurrences(trace, "disabled_") == 0);
+}
+
+static void checkTotals()
+{
+    kikCodeTraceSetEnabled(0);
+
+    TraceTotals outer;
+
+    kikCodeTraceRecordSpan("stage", 0, 1000000);
+
+    {
+        // only the innermost totals see a span
+        TraceTotals inner;
+
+        kikCodeTraceRecordSpan("stage", 0, 2000000);
+        kikCodeTraceRecordSpan("stage", 0, 3000000);
+
+        // the same name from another literal, as another translation unit would have it
+        string other_name("other");
+        kikCodeTraceRecordSpan("other", 0, 500000);
+
+        CHECK(inner.milliseconds("stage") == 5.0);
+        CHECK(inner.milliseconds(other_name.c_str()) == 0.5);
+        CHECK(inner.milliseconds("missing") == 0.0);
+    }
+
+    kikCodeTraceRecordSpan("stage", 0, 4000000);
+
+    CHECK(outer.milliseconds("stage") == 5.0);
+}
+
+static void checkTiming()
+{
+    kikCodeTraceSetEnabled(0);
+
+    TraceTotals stages;
+
+    // the blob and ellipse stages are each made of several spans
+    kikCodeTraceRecordSpan("threshold", 0, 1000000);
+    kikCodeTraceRecordSpan("contours_1", 0, 2000000);
+    kikCodeTraceRecordSpan("moment_pass_1", 0, 500000);
+    kikCodeTraceRecordSpan("ellipse_fitting_1", 0, 1000000);
+    kikCodeTraceRecordSpan("and_ellipses", 0, 1000000);
+    kikCodeTraceRecordSpan("ellipse_fitting_2", 0, 1000000);
+
+    KikCodeScanTiming timing = {};
+    timing.total = 10.0;
+
+    stages.fillTiming(&timing);
+
+    CHECK(timing.quality_gate == 0.0);
+    CHECK(timing.threshold == 1.0);
+    CHECK(timing.blobs == 2.5);
+    CHECK(timing.ellipses == 3.0);
+    CHECK(timing.candidates == 0.0);
+    CHECK(timing.total == 10.0);
+}
+
+static void checkOverflow()
+{
+    kikCodeTraceSetEnabled(1);
+    exportTrace();
+
+    // more than a ring holds, on a thread of its own so that its ring starts empty
+    thread writer([] {
+        for (int i = 0; i < TRACE_BUFFER_EVENTS + 100; ++i) {
+            kikCodeTraceRecordCount("overflow_count", i);
+        }
+    });
+    writer.join();
+
+    string trace = exportTrace();
+
+    CHECK(countOccurrences(trace, "\"name\":\"overflow_count\"") == TRACE_BUFFER_EVENTS);
+    CHECK(droppedEvents(trace) == 100);
+
+    // the oldest events were the ones overwritten
+    CHECK(trace.find("\"value\":99.000}") == string::npos);
+    CHECK(trace.find("\"value\":100.000}") != string::npos);
+
+    kikCodeTraceSetEnabled(0);
+}
+
+static void checkConcurrentWriters()
+{
+    kikCodeTraceSetEnabled(1);
+    exportTrace();
+
+    atomic<int> running(TRACE_TEST_THREADS);
+    vector<thread> writers;
+
+    for (int t = 0; t < TRACE_TEST_THREADS; ++t) {
+        writers.push_back(thread([&running] {
+            for (int i = 0; i < TRACE_TEST_EVENTS_PER_THREAD; ++i) {
+                kikCodeTraceRecordSpan("concurrent_span", kikCodeTraceNow(), 1000);
+            }
+
+            --running;
+        }));
+    }
+
+    // collecting while the rings are written to, every event must end up exported or counted as
+    // dropped, and none twice
+    uint64_t exported = 0;
+    uint64_t dropped = 0;
+
+    while (running.load() > 0) {
+        string trace = exportTrace();
+
+        exported += countOccurrences(trace, "\"name\":\"concurrent_span\"");
+        dropped += droppedEvents(trace);
+    }
+
+    for (size_t t = 0; t < writers.size(); ++t) {
+        writers[t].join();
+    }
+
+    string trace = exportTrace();
+
+    exported += countOccurrences(trace, "\"name\":\"concurrent_span\"");
+    dropped += droppedEvents(trace);
+
+    CHECK(exported + dropped == (uint64_t)TRACE_TEST_THREADS * TRACE_TEST_EVENTS_PER_THREAD);
+
+    kikCodeTraceSetEnabled(0);
+}
+
+static void checkHistograms()
+{
+    kikCodeTraceSetEnabled(1);
+
+    // durations of 1 to 100 milliseconds, in no particular order
+    for (int i = 0; i < 100; ++i) {
+        kikCodeTraceRecordSpan("histogram_span", 0, (uint64_t)(1 + (i * 37) % 100) * 1000000);
+    }
+
+    kikCodeTraceSetEnabled(0);
+
+    KikCodeTraceHistogram histograms[64];
+    unsigned int count = kikCodeTraceHistograms(histograms, 64);
+    const KikCodeTraceHistogram *histogram = nullptr;
+
+    for (unsigned int i = 0; i < count; ++i) {
+        if (strcmp(histograms[i].name, "histogram_span") == 0) {
+            histogram = &histograms[i];
+        }
+    }
+
+    CHECK(histogram != nullptr);
+
+    if (!histogram) {
+        return;
+    }
+
+    unsigned int bucketed = 0;
+
+    for (int i = 0; i < KIK_CODE_TRACE_HISTOGRAM_BUCKETS; ++i) {
+        bucketed += histogram->buckets[i];
+    }
+
+    CHECK(histogram->count == 100);
+    CHECK(bucketed == 100);
+    CHECK(histogram->p50 == 51.0);
+    CHECK(histogram->p90 == 91.0);
+    CHECK(histogram->max == 100.0);
+
+    // 1 ms is 1000 us, in the bucket from 512 to 1024 us
+    CHECK(histogram->buckets[9] == 1);
+}
+
+int main()
+{
+    checkDisabled();
+    checkTotals();
+    checkTiming();
+    checkOverflow();
+    checkConcurrentWriters();
+    checkHistograms();
+
+    return checkResult();
+}
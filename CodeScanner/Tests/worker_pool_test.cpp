@@ -0,0 +1,103 @@
+/**
+ * Runs WorkerPool through many small batches back to back, as the pyramid scan does with one batch
+ * per crop, so that workers waking late for one batch meet the next being dealt out.
+ */
+
+#include "check.h"
+#include "worker_pool.h"
+
+#include <atomic>
+#include <stdint.h>
+#include <vector>
+
+using namespace std;
+
+#define WORKER_POOL_TEST_BATCHES   20000
+#define WORKER_POOL_TEST_MAX_TASKS 7
+
+typedef struct {
+    // how many times each task ran
+    atomic<uint32_t> runs[WORKER_POOL_TEST_MAX_TASKS];
+
+    // tasks run with a worker index out of range
+    atomic<uint32_t> bad_workers;
+    size_t worker_count;
+} Batch;
+
+static void countTask(void *context, size_t task, size_t worker)
+{
+    Batch *batch = (Batch *)context;
+
+    batch->runs[task].fetch_add(1);
+
+    if (worker >= batch->worker_count) {
+        batch->bad_workers.fetch_add(1);
+    }
+}
+
+/**
+ * Checks that every task of every batch runs exactly once, with the batch's own context.
+ */
+static void runBatches(size_t thread_count)
+{
+    WorkerPool pool(thread_count);
+
+    CHECK(pool.workerCount() == thread_count + 1);
+
+    // each batch gets a context of its own, so a task run with a stale one is caught
+    vector<Batch> batches(2);
+    uint32_t failures = 0;
+
+    for (uint32_t i = 0; i < WORKER_POOL_TEST_BATCHES; ++i) {
+        Batch &batch = batches[i % 2];
+        size_t task_count = 1 + i % WORKER_POOL_TEST_MAX_TASKS;
+
+        batch.worker_count = pool.workerCount();
+        batch.bad_workers = 0;
+
+        for (size_t t = 0; t < WORKER_POOL_TEST_MAX_TASKS; ++t) {
+            batch.runs[t] = 0;
+        }
+
+        pool.run(task_count, countTask, &batch);
+
+        for (size_t t = 0; t < WORKER_POOL_TEST_MAX_TASKS; ++t) {
+            if (batch.runs[t].load() != (t < task_count ? 1u : 0u)) {
+                ++failures;
+            }
+        }
+
+        if (batch.bad_workers.load() != 0) {
+            ++failures;
+        }
+
+        // a task from this batch run late would land in the other context
+        Batch &other = batches[(i + 1) % 2];
+
+        for (size_t t = 0; t < WORKER_POOL_TEST_MAX_TASKS; ++t) {
+            if (i > 0 && other.runs[t].load() != (t < 1 + (i - 1) % WORKER_POOL_TEST_MAX_TASKS ? 1u : 0u)) {
+                ++failures;
+            }
+        }
+    }
+
+    CHECK(failures == 0);
+}
+
+int main()
+{
+    // no background threads, the calling thread does everything
+    runBatches(0);
+
+    runBatches(1);
+    runBatches(3);
+
+    // more workers than tasks in every batch
+    runBatches(WORKER_POOL_TEST_MAX_TASKS + 2);
+
+    // nothing to run returns straight away
+    WorkerPool pool(2);
+    pool.run(0, nullptr, nullptr);
+
+    return checkResult();
+}
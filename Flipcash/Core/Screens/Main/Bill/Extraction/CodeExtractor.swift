@@ -13,6 +13,10 @@ import FlipcashCore
 class CodeExtractor: CameraSessionExtractor {
     
     private var container = RedundancyContainer<Data>(threshold: 1)
+
+    // Averages each code over this camera's last few frames, so a code too damaged to read in any
+    // single frame can still be decoded. Owned by the extractor so no other scan shares its evidence.
+    private let scanner = KikCodesFrameScanner()
     
     required init() {}
 
@@ -20,7 +24,7 @@ class CodeExtractor: CameraSessionExtractor {
         // The scan runs inside withLuminanceSample so the sample's zero-copy view of the plane
         // stays valid -- the base address is only guaranteed while the pixel buffer is locked.
         withLuminanceSample(from: sampleBuffer) { sample in
-            Self.processSample(
+            processSample(
                 sample: sample,
                 quality: .best,
                 container: &container
@@ -28,12 +32,14 @@ class CodeExtractor: CameraSessionExtractor {
         }
     }
     
-    private static func processSample(sample: Sample, quality: KikCodesScanQuality) -> (Data, ScannedCode)? {
-        guard let data = KikCodes.scan(sample.data, width: sample.width, height: sample.height, quality: quality) else {
+    private func processSample(sample: Sample, quality: KikCodesScanQuality) -> (Data, ScannedCode)? {
+        var confidence: NSData?
+        guard let data = scanner.scan(sample.data, width: sample.width, height: sample.height, rowStride: sample.rowStride, quality: quality, confidence: &confidence) else {
             return nil
         }
 
-        let result = KikCodes.decode(data)
+        // The confidence lets a damaged frame decode by erasing the bytes the scanner was least sure of.
+        let result = KikCodes.decode(data, confidence: confidence as Data?)
 
         guard let payload = ScannedCode(data: result) else {
             return nil
@@ -42,7 +48,7 @@ class CodeExtractor: CameraSessionExtractor {
         return (result, payload)
     }
 
-    private static func processSample(sample: Sample, quality: KikCodesScanQuality, container: inout RedundancyContainer<Data>) -> ScannedCode? {
+    private func processSample(sample: Sample, quality: KikCodesScanQuality, container: inout RedundancyContainer<Data>) -> ScannedCode? {
         if let (data, payload) = processSample(sample: sample, quality: quality) {
             container.insert(data)
             
@@ -57,14 +63,14 @@ class CodeExtractor: CameraSessionExtractor {
         return nil
     }
     
-    /// Vends the frame's luminance (Y) plane as a `Sample`, tightly packed the way `kikCodeScan`
-    /// expects, and calls `body` with it.
+    /// Vends the frame's luminance (Y) plane as a `Sample`, together with its row stride, and
+    /// calls `body` with it.
     ///
     /// Internal rather than private so `CodeScanSweepTests` can drive it with synthesized frames.
     ///
-    /// The sample is only valid for the duration of `body`: when the plane is already tightly
-    /// packed its `data` is a no-copy view of the locked pixel buffer, which CoreVideo only
-    /// guarantees between lock and unlock.
+    /// The sample is only valid for the duration of `body`: its `data` is always a no-copy view of
+    /// the locked pixel buffer, which CoreVideo only guarantees between lock and unlock. Padded
+    /// planes are handed to the stride-aware scan as they are rather than being unpadded first.
     func withLuminanceSample<T>(
         from sampleBuffer: CMSampleBuffer,
         _ body: (Sample) -> T?
@@ -93,13 +99,22 @@ class CodeExtractor: CameraSessionExtractor {
         let sample = Sample(
             width: width,
             height: height,
-            data: Self.luminanceData(base: base, width: width, height: height, rowStride: rowStride)
+            rowStride: rowStride,
+            data: Data(
+                bytesNoCopy: base,
+                count: rowStride * (height - 1) + width,
+                deallocator: .none
+            )
         )
 
         return body(sample)
     }
 
-    /// Produces the tightly packed `width * height` buffer `kikCodeScan` reads.
+    /// Produces a tightly packed `width * height` copy of a luminance plane.
+    ///
+    /// The capture path no longer needs this -- `KikCodes.scan(_:width:height:rowStride:quality:)`
+    /// reads padded planes in place -- but it remains the reference packing rule shared with
+    /// Android for callers that still hand the scanner a packed buffer.
     ///
     /// CoreVideo aligns plane rows to 64 bytes, so a capture width that is not a multiple of 64
     /// arrives padded -- 1440 wide comes back with a 1472-byte stride. Handing that straight to the
@@ -146,6 +161,7 @@ extension CodeExtractor {
     struct Sample {
         let width: Int
         let height: Int
+        let rowStride: Int
         let data: Data
     }
 }
@@ -173,17 +173,20 @@ struct CodeScanSweepTests {
     private static func scan(_ buffer: CVPixelBuffer) -> Data? {
         let extractor = CodeExtractor()
         return extractor.withLuminanceSample(from: makeSampleBuffer(buffer)) { sample in
+            var confidence: NSData?
             guard
-                let scanned = KikCodes.scan(
+                let scanned = KikCodesFrameScanner().scan(
                     sample.data,
                     width: sample.width,
                     height: sample.height,
-                    quality: .best
+                    rowStride: sample.rowStride,
+                    quality: .best,
+                    confidence: &confidence
                 )
             else {
                 return nil
             }
-            return KikCodes.decode(scanned)
+            return KikCodes.decode(scanned, confidence: confidence as Data?)
         }
     }
 
@@ -0,0 +1,69 @@
+//
+//  KikCodesErrorCorrectionTests.swift
+//  FlipcashTests
+//
+
+import Foundation
+import Testing
+import CodeScanner
+
+@Suite("Kik Code Error Correction Tests")
+struct KikCodesErrorCorrectionTests {
+
+    private static let payload = Data((1...20).map { UInt8($0) })
+
+    /// Printed codes have to keep scanning, so the parity bytes are pinned to
+    /// what the original encoder produced for this payload.
+    private static let encoded = Data([
+        0x27, 0x8C, 0xC2, 0xEE, 0xC5, 0xCB, 0xE7, 0x7C, 0xE6, 0xC2, 0xB1, 0x01, 0x90,
+        0x02, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B,
+        0x0C, 0x0D, 0x0E, 0x0F, 0x10, 0x11, 0x12, 0x13, 0x14,
+    ])
+
+    /// Byte positions to corrupt, spread over the parity and the data sections.
+    private static let corruptions: [[Int]] = [
+        [],
+        [0],
+        [34],
+        [12, 13],
+        [0, 7, 14, 21, 28],
+        [1, 5, 13, 20, 27, 34],
+        [0, 1, 2, 3, 4, 5],
+        [29, 30, 31, 32, 33, 34],
+    ]
+
+    @Test func encodedBytes_matchOriginalEncoder() {
+        #expect(KikCodes.encode(Self.payload) == Self.encoded)
+    }
+
+    @Test("Up to six corrupted bytes are corrected", arguments: KikCodesErrorCorrectionTests.corruptions)
+    func correctsCorruptedBytes(positions: [Int]) {
+        var damaged = Self.encoded
+
+        for (i, position) in positions.enumerated() {
+            damaged[position] ^= UInt8(truncatingIfNeeded: 0x5A + i * 37)
+        }
+
+        #expect(KikCodes.decode(damaged) == Self.payload)
+    }
+
+    /// Nine damaged bytes are beyond what errors alone can fix, but six of
+    /// them read with low confidence can be erased, which leaves room for the
+    /// other three.
+    @Test func correctsLowConfidenceBytesAsErasures() {
+        let erased = [0, 3, 12, 13, 22, 31]
+        let unflagged = [17, 28, 34]
+
+        var damaged = Self.encoded
+        var confidence = Data(repeating: 200, count: Self.encoded.count)
+
+        for (i, position) in (erased + unflagged).enumerated() {
+            damaged[position] ^= UInt8(truncatingIfNeeded: 0x3C + i * 53)
+        }
+        for position in erased {
+            confidence[position] = 4
+        }
+
+        #expect(KikCodes.decode(damaged, confidence: confidence) == Self.payload)
+    }
+}